@@ -5,6 +5,18 @@
 
 /* Warning, this file is autogenerated by cbindgen. Don't modify this manually. */
 
+#ifdef __cplusplus
+#include <atomic>
+typedef std::atomic<bool> CzkawkaStopFlag;
+#else
+#include <stdatomic.h>
+typedef atomic_bool CzkawkaStopFlag;
+#endif
+
+#define CZKAWKA_HASH_MAX_LEN 64
+
+#define CZKAWKA_PREHASH_SIZE (16 * 1024)
+
 typedef enum CCheckingMethod {
   Hash = 0,
   Name = 1,
@@ -18,15 +30,82 @@ typedef enum CHashType {
   Xxh3 = 2,
 } CHashType;
 
+typedef enum CScanStage {
+  CollectingFiles = 0,
+  ScanningName = 1,
+  ScanningSizeName = 2,
+  ScanningSize = 3,
+  PreHashCacheLoading = 4,
+  PreHashing = 5,
+  PreHashCacheSaving = 6,
+  FullHashCacheLoading = 7,
+  FullHashing = 8,
+  FullHashCacheSaving = 9,
+  Other = 10,
+} CScanStage;
+
 typedef struct CzkawkaDuplicateFinder CzkawkaDuplicateFinder;
 
+typedef struct CScanProgress {
+  enum CScanStage stage;
+  uint8_t current_stage_idx;
+  uint8_t max_stage_idx;
+  uint64_t entries_checked;
+  uint64_t entries_to_check;
+  uint64_t bytes_checked;
+  uint64_t bytes_to_check;
+} CScanProgress;
+
+typedef struct CCacheStats {
+  uint64_t candidates;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t bytes_hashed;
+  uint64_t bytes_saved;
+} CCacheStats;
+
+typedef struct CStageStats {
+  enum CScanStage stage;
+  uint64_t wall_time_us;
+  uint64_t entries;
+  uint64_t bytes;
+} CStageStats;
+
+typedef void (*ProgressCallback)(const struct CScanProgress *progress, void *user_data);
+
+typedef void (*TraceCallback)(const char *name, bool begin, void *user_data);
+
 typedef struct CDuplicateEntry {
-  const char *path;
+  uintptr_t path_offset;
+  uintptr_t path_len;
   uint64_t size;
   uint64_t modified_date;
-  const char *hash;
+  uintptr_t hash_offset;
+  uintptr_t hash_len;
 } CDuplicateEntry;
 
+typedef struct CDuplicateGroup {
+  uintptr_t first_entry;
+  uintptr_t count;
+} CDuplicateGroup;
+
+typedef struct CDuplicateResults {
+  const struct CDuplicateGroup *groups;
+  uintptr_t group_count;
+  const struct CDuplicateEntry *entries;
+  uintptr_t total_files;
+  const uint8_t *strings;
+  uintptr_t strings_len;
+  uint64_t wasted_space;
+} CDuplicateResults;
+
+typedef struct CHashJob {
+  const char *path;
+  uint64_t size;
+  bool done;
+  char hash[CZKAWKA_HASH_MAX_LEN + 1];
+} CHashJob;
+
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
@@ -34,7 +113,9 @@ extern "C" {
 struct CzkawkaDuplicateFinder *czkawka_duplicate_finder_new(enum CCheckingMethod check_method,
                                                             enum CHashType hash_type,
                                                             bool ignore_hard_links,
-                                                            bool use_cache);
+                                                            bool use_cache,
+                                                            uint64_t minimal_cache_file_size,
+                                                            uint64_t minimal_prehash_cache_file_size);
 
 void czkawka_duplicate_finder_free(struct CzkawkaDuplicateFinder *finder);
 
@@ -50,6 +131,20 @@ void czkawka_duplicate_finder_set_min_size(struct CzkawkaDuplicateFinder *finder
 
 void czkawka_duplicate_finder_set_max_size(struct CzkawkaDuplicateFinder *finder, uint64_t size);
 
+void czkawka_duplicate_finder_set_thread_limits(struct CzkawkaDuplicateFinder *finder,
+                                                uint32_t cpu_threads,
+                                                uint32_t io_threads,
+                                                bool background);
+
+bool czkawka_set_cache_path(const char *path);
+
+bool czkawka_cache_path_resolved(void);
+
+void czkawka_duplicate_finder_set_progress_callback(struct CzkawkaDuplicateFinder *finder,
+                                                    ProgressCallback callback,
+                                                    void *user_data,
+                                                    uint32_t min_interval_ms);
+
 bool czkawka_duplicate_finder_search(struct CzkawkaDuplicateFinder *finder);
 
 void czkawka_duplicate_finder_stop(struct CzkawkaDuplicateFinder *finder);
@@ -58,12 +153,31 @@ uintptr_t czkawka_duplicate_finder_get_group_count(const struct CzkawkaDuplicate
 
 uint64_t czkawka_duplicate_finder_get_wasted_space(const struct CzkawkaDuplicateFinder *finder);
 
-bool czkawka_duplicate_finder_get_group(const struct CzkawkaDuplicateFinder *finder,
-                                        uintptr_t group_index,
-                                        const struct CDuplicateEntry **out_entries,
-                                        uintptr_t *out_count);
+struct CCacheStats czkawka_duplicate_finder_get_cache_stats(const struct CzkawkaDuplicateFinder *finder);
+
+uintptr_t czkawka_duplicate_finder_get_stage_stats(const struct CzkawkaDuplicateFinder *finder,
+                                                   struct CStageStats *out,
+                                                   uintptr_t capacity);
+
+struct CDuplicateResults *czkawka_duplicate_finder_export_results(const struct CzkawkaDuplicateFinder *finder);
+
+void czkawka_duplicate_results_free(struct CDuplicateResults *results);
+
+uintptr_t czkawka_hash_file(const char *path,
+                            enum CHashType hash_type,
+                            const CzkawkaStopFlag *stop_flag,
+                            char *out,
+                            uintptr_t out_len);
+
+uintptr_t czkawka_duplicate_finder_hash_files(struct CzkawkaDuplicateFinder *finder,
+                                              struct CHashJob *jobs,
+                                              uintptr_t count,
+                                              bool prehash,
+                                              struct CScanProgress progress);
+
+void czkawka_set_trace_callback(TraceCallback callback, void *user_data);
 
-void czkawka_duplicate_entries_free(struct CDuplicateEntry *entries, uintptr_t count);
+void czkawka_set_background_priority(void);
 
 #ifdef __cplusplus
 }  // extern "C"
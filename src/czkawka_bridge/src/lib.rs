@@ -1,12 +1,19 @@
+use crossbeam_channel::{unbounded, Receiver, RecvTimeoutError};
 use czkawka_core::common::model::{CheckingMethod, HashType};
+use czkawka_core::common::progress_data::{CurrentStage, ProgressData};
 use czkawka_core::common::tool_data::CommonData;
 use czkawka_core::common::traits::Search;
-use czkawka_core::tools::duplicate::{DuplicateFinder, DuplicateFinderParameters};
-use std::ffi::{CStr, CString};
-use std::os::raw::c_char;
+use czkawka_core::tools::duplicate::{DuplicateEntry, DuplicateFinder, DuplicateFinderParameters};
+use rayon::prelude::*;
+use std::ffi::CStr;
+use std::fs::File;
+use std::io::{ErrorKind, Read};
+use std::os::raw::{c_char, c_void};
 use std::path::PathBuf;
-use std::sync::atomic::{AtomicBool, Ordering};
-use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, AtomicPtr, AtomicU64, AtomicUsize, Ordering};
+use std::sync::{Arc, Condvar, Mutex};
+use std::thread;
+use std::time::{Duration, Instant};
 
 // C-compatible enums
 #[repr(C)]
@@ -49,17 +56,20 @@ impl From<CHashType> for HashType {
 }
 
 // C-compatible structures
+// Strings are UTF-8 byte ranges (not NUL-terminated) inside CDuplicateResults::strings
 #[repr(C)]
 pub struct CDuplicateEntry {
-    pub path: *const c_char,
+    pub path_offset: usize,
+    pub path_len: usize,
     pub size: u64,
     pub modified_date: u64,
-    pub hash: *const c_char,
+    pub hash_offset: usize,
+    pub hash_len: usize,
 }
 
 #[repr(C)]
 pub struct CDuplicateGroup {
-    pub entries: *const CDuplicateEntry,
+    pub first_entry: usize,
     pub count: usize,
 }
 
@@ -67,12 +77,276 @@ pub struct CDuplicateGroup {
 pub struct CDuplicateResults {
     pub groups: *const CDuplicateGroup,
     pub group_count: usize,
+    pub entries: *const CDuplicateEntry,
     pub total_files: usize,
+    pub strings: *const u8,
+    pub strings_len: usize,
     pub wasted_space: u64,
 }
 
-// Progress callback
-pub type ProgressCallback = extern "C" fn(current: u64, total: u64, user_data: *mut std::ffi::c_void);
+// Scan stages reported through the progress callback
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum CScanStage {
+    CollectingFiles = 0,
+    ScanningName = 1,
+    ScanningSizeName = 2,
+    ScanningSize = 3,
+    PreHashCacheLoading = 4,
+    PreHashing = 5,
+    PreHashCacheSaving = 6,
+    FullHashCacheLoading = 7,
+    FullHashing = 8,
+    FullHashCacheSaving = 9,
+    Other = 10,
+}
+
+impl From<CurrentStage> for CScanStage {
+    fn from(stage: CurrentStage) -> Self {
+        match stage {
+            CurrentStage::DuplicateCollectingFiles => CScanStage::CollectingFiles,
+            CurrentStage::DuplicateScanningName => CScanStage::ScanningName,
+            CurrentStage::DuplicateScanningSizeName => CScanStage::ScanningSizeName,
+            CurrentStage::DuplicateScanningSize => CScanStage::ScanningSize,
+            CurrentStage::DuplicatePreHashCacheLoading => CScanStage::PreHashCacheLoading,
+            CurrentStage::DuplicatePreHashing => CScanStage::PreHashing,
+            CurrentStage::DuplicatePreHashCacheSaving => CScanStage::PreHashCacheSaving,
+            CurrentStage::DuplicateFullHashCacheLoading => CScanStage::FullHashCacheLoading,
+            CurrentStage::DuplicateFullHashing => CScanStage::FullHashing,
+            CurrentStage::DuplicateFullHashCacheSaving => CScanStage::FullHashCacheSaving,
+            _ => CScanStage::Other,
+        }
+    }
+}
+
+impl CScanStage {
+    // Span name of the stage in traces
+    fn trace_name(self) -> &'static CStr {
+        match self {
+            CScanStage::CollectingFiles => c"czkawka: collecting files",
+            CScanStage::ScanningName => c"czkawka: grouping by name",
+            CScanStage::ScanningSizeName => c"czkawka: grouping by size and name",
+            CScanStage::ScanningSize => c"czkawka: grouping by size",
+            CScanStage::PreHashCacheLoading => c"czkawka: loading prehash cache",
+            CScanStage::PreHashing => c"czkawka: prehashing",
+            CScanStage::PreHashCacheSaving => c"czkawka: saving prehash cache",
+            CScanStage::FullHashCacheLoading => c"czkawka: loading hash cache",
+            CScanStage::FullHashing => c"czkawka: hashing",
+            CScanStage::FullHashCacheSaving => c"czkawka: saving hash cache",
+            CScanStage::Other => c"czkawka: other",
+        }
+    }
+}
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct CScanProgress {
+    pub stage: CScanStage,
+    pub current_stage_idx: u8,
+    pub max_stage_idx: u8,
+    pub entries_checked: u64,
+    pub entries_to_check: u64,
+    pub bytes_checked: u64,
+    pub bytes_to_check: u64,
+}
+
+impl From<&ProgressData> for CScanProgress {
+    fn from(data: &ProgressData) -> Self {
+        CScanProgress {
+            stage: data.sstage.into(),
+            current_stage_idx: data.current_stage_idx,
+            max_stage_idx: data.max_stage_idx,
+            entries_checked: data.entries_checked as u64,
+            entries_to_check: data.entries_to_check as u64,
+            bytes_checked: data.bytes_checked,
+            bytes_to_check: data.bytes_to_check,
+        }
+    }
+}
+
+// Cache effectiveness of the full hashing stage of the last search.
+// Misses and bytes_hashed are what czkawka actually hashed; hits and
+// bytes_saved are derived from the candidate counts and are approximate.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct CCacheStats {
+    pub candidates: u64,
+    pub hits: u64,
+    pub misses: u64,
+    pub bytes_hashed: u64,
+    pub bytes_saved: u64,
+}
+
+// Time and work of one stage of the last search. A stage lasts from its
+// first progress report to the first report of the next stage, or to the
+// end of the search; entries and bytes are the most it reported as checked.
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct CStageStats {
+    pub stage: CScanStage,
+    pub wall_time_us: u64,
+    pub entries: u64,
+    pub bytes: u64,
+}
+
+// Progress callback, invoked from a bridge-owned thread
+pub type ProgressCallback = extern "C" fn(progress: *const CScanProgress, user_data: *mut c_void);
+
+// Trace callback: the span `name` begins (begin = true) or ends on the
+// calling thread. Invoked from any bridge thread; `name` is static.
+pub type TraceCallback = extern "C" fn(name: *const c_char, begin: bool, user_data: *mut c_void);
+
+// Zero unless tracing is enabled, so a disabled span costs one load and branch
+static TRACE_CALLBACK: AtomicUsize = AtomicUsize::new(0);
+static TRACE_USER_DATA: AtomicPtr<c_void> = AtomicPtr::new(std::ptr::null_mut());
+
+// Reports its end when dropped
+#[derive(Debug)]
+struct TraceSpan {
+    callback: TraceCallback,
+    name: &'static CStr,
+}
+
+impl TraceSpan {
+    fn begin(name: &'static CStr) -> Option<TraceSpan> {
+        let callback = TRACE_CALLBACK.load(Ordering::Acquire);
+        if callback == 0 {
+            return None;
+        }
+        // Only ever stored from a TraceCallback
+        let callback = unsafe { std::mem::transmute::<usize, TraceCallback>(callback) };
+        callback(name.as_ptr(), true, TRACE_USER_DATA.load(Ordering::Relaxed));
+        Some(TraceSpan { callback, name })
+    }
+}
+
+impl Drop for TraceSpan {
+    fn drop(&mut self) {
+        (self.callback)(self.name.as_ptr(), false, TRACE_USER_DATA.load(Ordering::Relaxed));
+    }
+}
+
+// Files czkawka had to hash itself; cached files are never counted by its progress
+#[derive(Debug, Clone, Copy, Default)]
+struct HashingWork {
+    full_hash_files: u64,
+    full_hash_bytes: u64,
+}
+
+impl HashingWork {
+    fn record(&mut self, progress: &CScanProgress) {
+        if progress.stage == CScanStage::FullHashing {
+            self.full_hash_files = self.full_hash_files.max(progress.entries_to_check);
+            self.full_hash_bytes = self.full_hash_bytes.max(progress.bytes_to_check);
+        }
+    }
+}
+
+// Stage boundaries as seen by the forwarder, which receives every report
+#[derive(Debug, Default)]
+struct StageRecorder {
+    stages: Vec<CStageStats>,
+    current_start: Option<Instant>,
+    // czkawka's workers cannot be traced; the stage span shows what they work on
+    current_span: Option<TraceSpan>,
+}
+
+impl StageRecorder {
+    fn record(&mut self, progress: &CScanProgress) {
+        let now = Instant::now();
+        if self.stages.last().map(|last| last.stage) != Some(progress.stage) {
+            self.finish(now);
+            self.stages.push(CStageStats {
+                stage: progress.stage,
+                wall_time_us: 0,
+                entries: 0,
+                bytes: 0,
+            });
+            self.current_start = Some(now);
+            self.current_span = TraceSpan::begin(progress.stage.trace_name());
+        }
+
+        if let Some(current) = self.stages.last_mut() {
+            current.entries = current.entries.max(progress.entries_checked);
+            current.bytes = current.bytes.max(progress.bytes_checked);
+        }
+    }
+
+    fn finish(&mut self, now: Instant) {
+        self.current_span = None;
+        if let (Some(start), Some(current)) = (self.current_start.take(), self.stages.last_mut()) {
+            current.wall_time_us = now.duration_since(start).as_micros() as u64;
+        }
+    }
+}
+
+// Forwards czkawka progress to the C callback, if any, at a bounded rate
+struct ProgressForwarder {
+    callback: Option<ProgressCallback>,
+    user_data: *mut c_void,
+    min_interval: Duration,
+}
+
+// The caller guarantees user_data may be used from the forwarding thread
+unsafe impl Send for ProgressForwarder {}
+
+impl ProgressForwarder {
+    fn emit(&self, progress: &CScanProgress) {
+        if let Some(callback) = self.callback {
+            callback(progress, self.user_data);
+        }
+    }
+
+    fn run(self, receiver: Receiver<ProgressData>) -> (HashingWork, Vec<CStageStats>) {
+        let mut last_emit: Option<Instant> = None;
+        let mut last_stage: Option<CScanStage> = None;
+        let mut pending: Option<CScanProgress> = None;
+        let mut work = HashingWork::default();
+        let mut stages = StageRecorder::default();
+
+        loop {
+            match receiver.recv_timeout(self.min_interval) {
+                Ok(data) => {
+                    let progress = CScanProgress::from(&data);
+                    work.record(&progress);
+                    stages.record(&progress);
+
+                    // Stage changes are forwarded immediately, updates within a stage are throttled
+                    if last_stage == Some(progress.stage)
+                        && last_emit.is_some_and(|emitted| emitted.elapsed() < self.min_interval)
+                    {
+                        pending = Some(progress);
+                        continue;
+                    }
+
+                    if let Some(previous) = pending.take() {
+                        if previous.stage != progress.stage {
+                            self.emit(&previous);
+                        }
+                    }
+
+                    self.emit(&progress);
+                    last_emit = Some(Instant::now());
+                    last_stage = Some(progress.stage);
+                }
+                Err(RecvTimeoutError::Timeout) => {
+                    if let Some(progress) = pending.take() {
+                        self.emit(&progress);
+                        last_emit = Some(Instant::now());
+                    }
+                }
+                Err(RecvTimeoutError::Disconnected) => break,
+            }
+        }
+
+        // Senders are dropped when the search returns, which ends the last stage
+        stages.finish(Instant::now());
+        if let Some(progress) = pending {
+            self.emit(&progress);
+        }
+        (work, stages.stages)
+    }
+}
 
 // Opaque pointer to DuplicateFinder
 pub struct CzkawkaDuplicateFinder {
@@ -80,34 +354,59 @@ pub struct CzkawkaDuplicateFinder {
     stop_flag: Arc<AtomicBool>,
     included_paths: Vec<PathBuf>,
     excluded_paths: Vec<PathBuf>,
+    progress_callback: Option<ProgressCallback>,
+    progress_user_data: *mut c_void,
+    progress_interval: Duration,
+    hashing_work: HashingWork,
+    stage_stats: Vec<CStageStats>,
+    cpu_threads: usize,
+    io_threads: usize,
+    background: bool,
+    loads_cache: bool,
+    hash_type: CHashType,
 }
 
-// Initialize a new duplicate finder
+// Initialize a new duplicate finder.
+// Files smaller than minimal_cache_file_size (full hashes) or
+// minimal_prehash_cache_file_size (prehashes) are never written to the cache.
 #[no_mangle]
 pub extern "C" fn czkawka_duplicate_finder_new(
     check_method: CCheckingMethod,
     hash_type: CHashType,
     ignore_hard_links: bool,
     use_cache: bool,
+    minimal_cache_file_size: u64,
+    minimal_prehash_cache_file_size: u64,
 ) -> *mut CzkawkaDuplicateFinder {
     let params = DuplicateFinderParameters::new(
         check_method.into(),
         hash_type.into(),
         ignore_hard_links,
         use_cache,
-        1024 * 1024,      // minimal_cache_file_size: 1 MB
-        1024 * 1024,      // minimal_prehash_cache_file_size: 1 MB
+        minimal_cache_file_size,
+        minimal_prehash_cache_file_size,
         true,             // case_sensitive_name_comparison
     );
 
     let finder = DuplicateFinder::new(params);
     let stop_flag = Arc::new(AtomicBool::new(false));
+    let loads_cache = use_cache && matches!(check_method, CCheckingMethod::Hash);
 
     Box::into_raw(Box::new(CzkawkaDuplicateFinder {
         finder,
         stop_flag,
         included_paths: Vec::new(),
         excluded_paths: Vec::new(),
+        progress_callback: None,
+        progress_user_data: std::ptr::null_mut(),
+        progress_interval: Duration::from_millis(100),
+        hashing_work: HashingWork::default(),
+        stage_stats: Vec::new(),
+        cpu_threads: 0,
+        io_threads: 0,
+        background: false,
+        loads_cache,
+        hash_type,
     }))
 }
 
@@ -204,16 +503,107 @@ pub extern "C" fn czkawka_duplicate_finder_set_max_size(
     }
 }
 
+// Limit the workers and concurrent reads of the next search or
+// czkawka_duplicate_finder_hash_files(); 0 leaves a limit unset. Hashing runs
+// cpu_threads workers, of which at most io_threads read at once. czkawka's
+// search reads files on every worker and offers no hook around its reads, so
+// there the pool gets the smaller of both limits. With background set, the
+// workers run at the lowest CPU and I/O priority.
+#[no_mangle]
+pub extern "C" fn czkawka_duplicate_finder_set_thread_limits(
+    finder: *mut CzkawkaDuplicateFinder,
+    cpu_threads: u32,
+    io_threads: u32,
+    background: bool,
+) {
+    if !finder.is_null() {
+        unsafe {
+            (*finder).cpu_threads = cpu_threads as usize;
+            (*finder).io_threads = io_threads as usize;
+            (*finder).background = background;
+        }
+    }
+}
+
+// czkawka resolves its cache directory once per process, from
+// CZKAWKA_CACHE_PATH, when the first search loads a cache. The bridge is the
+// only writer of that variable and leaves it alone from then on.
+struct CachePath {
+    path: Option<PathBuf>,
+    resolved: bool,
+}
+
+static CACHE_PATH: Mutex<CachePath> = Mutex::new(CachePath { path: None, resolved: false });
+
+// Keep the hash cache in path, or czkawka's default location when path is
+// null or empty. Returns false, changing nothing, once a search has loaded
+// the cache from another directory.
+#[no_mangle]
+pub extern "C" fn czkawka_set_cache_path(path: *const c_char) -> bool {
+    let requested = if path.is_null() {
+        None
+    } else {
+        match unsafe { CStr::from_ptr(path) }.to_str() {
+            Ok("") => None,
+            Ok(s) => Some(PathBuf::from(s)),
+            Err(_) => return false,
+        }
+    };
+
+    let mut cache = CACHE_PATH.lock().unwrap_or_else(|poisoned| poisoned.into_inner());
+    if cache.resolved {
+        return cache.path == requested;
+    }
+    match &requested {
+        Some(path) => std::env::set_var("CZKAWKA_CACHE_PATH", path),
+        // Only undoes the bridge's own setting, never the user's environment
+        None if cache.path.is_some() => std::env::remove_var("CZKAWKA_CACHE_PATH"),
+        None => {}
+    }
+    cache.path = requested;
+    true
+}
+
+// Whether a search has loaded the cache, so czkawka_set_cache_path() can no
+// longer move it
+#[no_mangle]
+pub extern "C" fn czkawka_cache_path_resolved() -> bool {
+    CACHE_PATH.lock().unwrap_or_else(|poisoned| poisoned.into_inner()).resolved
+}
+
+// Set the progress callback used by the next search.
+// Updates within a stage are delivered at most once per min_interval_ms.
+#[no_mangle]
+pub extern "C" fn czkawka_duplicate_finder_set_progress_callback(
+    finder: *mut CzkawkaDuplicateFinder,
+    callback: Option<ProgressCallback>,
+    user_data: *mut c_void,
+    min_interval_ms: u32,
+) {
+    if !finder.is_null() {
+        unsafe {
+            let finder = &mut *finder;
+            finder.progress_callback = callback;
+            finder.progress_user_data = user_data;
+            finder.progress_interval = Duration::from_millis(u64::from(min_interval_ms.max(1)));
+        }
+    }
+}
+
 // Start the search
 #[no_mangle]
 pub extern "C" fn czkawka_duplicate_finder_search(finder: *mut CzkawkaDuplicateFinder) -> bool {
     if finder.is_null() {
         return false;
     }
+    let _span = TraceSpan::begin(c"czkawka_duplicate_finder_search");
 
     unsafe {
         let finder_ptr = &mut *finder;
         finder_ptr.stop_flag.store(false, Ordering::Relaxed);
+        if finder_ptr.loads_cache {
+            CACHE_PATH.lock().unwrap_or_else(|poisoned| poisoned.into_inner()).resolved = true;
+        }
 
         // Set included and excluded paths using CommonData trait methods
         let included = std::mem::take(&mut finder_ptr.included_paths);
@@ -222,13 +612,63 @@ pub extern "C" fn czkawka_duplicate_finder_search(finder: *mut CzkawkaDuplicateF
         finder_ptr.finder.set_included_paths(included);
         finder_ptr.finder.set_excluded_paths(excluded);
 
-        // Call search from the Search trait
-        finder_ptr.finder.search(&finder_ptr.stop_flag, None);
+        // Progress is always consumed, it also measures the hashing work for the cache stats
+        let forwarder = ProgressForwarder {
+            callback: finder_ptr.progress_callback,
+            user_data: finder_ptr.progress_user_data,
+            min_interval: finder_ptr.progress_interval,
+        };
+        let (sender, receiver) = unbounded::<ProgressData>();
+
+        // czkawka's parallel iterators run on the pool they are called from,
+        // so a pool of its own keeps each search within its limits
+        let threads = [finder_ptr.cpu_threads, finder_ptr.io_threads]
+            .into_iter()
+            .filter(|&limit| limit > 0)
+            .min()
+            .unwrap_or(0);
+        let pool = finder_pool(finder_ptr, threads);
+
+        // The forwarder exits once czkawka has dropped every sender
+        let (work, stages) = thread::scope(|scope| {
+            let forwarding = scope.spawn(move || forwarder.run(receiver));
+            match &pool {
+                Some(pool) => pool.install(|| finder_ptr.finder.search(&finder_ptr.stop_flag, Some(&sender))),
+                None => finder_ptr.finder.search(&finder_ptr.stop_flag, Some(&sender)),
+            }
+            drop(sender);
+            forwarding.join().unwrap_or_default()
+        });
+        finder_ptr.hashing_work = work;
+        finder_ptr.stage_stats = stages;
         true
     }
 }
 
-// Stop the search
+// A pool of threads workers, 0 for one per core, at the finder's priority.
+// None when the threads cannot be started: the global pool is better than no
+// scan, but it ignores the limits.
+fn finder_pool(finder: &CzkawkaDuplicateFinder, threads: usize) -> Option<rayon::ThreadPool> {
+    let background = finder.background;
+    let pool = rayon::ThreadPoolBuilder::new()
+        .num_threads(threads)
+        .thread_name(|index| format!("czkawka-{index}"))
+        .start_handler(move |_| {
+            if background {
+                czkawka_set_background_priority();
+            }
+        })
+        .build();
+    match pool {
+        Ok(pool) => Some(pool),
+        Err(error) => {
+            eprintln!("czkawka_bridge: cannot start a worker pool ({error}), running without thread limits");
+            None
+        }
+    }
+}
+
+// Stop the search, or czkawka_duplicate_finder_hash_files()
 #[no_mangle]
 pub extern "C" fn czkawka_duplicate_finder_stop(finder: *mut CzkawkaDuplicateFinder) {
     if !finder.is_null() {
@@ -250,7 +690,7 @@ pub extern "C" fn czkawka_duplicate_finder_get_group_count(
     unsafe {
         let finder = &*finder;
         match finder.finder.get_params().check_method {
-            CheckingMethod::Hash => finder.finder.get_files_sorted_by_hash().len(),
+            CheckingMethod::Hash => finder.finder.get_files_sorted_by_hash().values().map(Vec::len).sum(),
             CheckingMethod::Name => finder.finder.get_files_sorted_by_names().len(),
             CheckingMethod::Size => finder.finder.get_files_sorted_by_size().len(),
             CheckingMethod::SizeName => finder.finder.get_files_sorted_by_size_name().len(),
@@ -281,132 +721,486 @@ pub extern "C" fn czkawka_duplicate_finder_get_wasted_space(
     }
 }
 
-// Get duplicate group by index
+// Cache statistics of the last search; all zero unless it compared hashes
 #[no_mangle]
-pub extern "C" fn czkawka_duplicate_finder_get_group(
+pub extern "C" fn czkawka_duplicate_finder_get_cache_stats(
     finder: *const CzkawkaDuplicateFinder,
-    group_index: usize,
-    out_entries: *mut *const CDuplicateEntry,
-    out_count: *mut usize,
-) -> bool {
-    if finder.is_null() || out_entries.is_null() || out_count.is_null() {
-        return false;
+) -> CCacheStats {
+    if finder.is_null() {
+        return CCacheStats::default();
+    }
+
+    unsafe {
+        let finder = &*finder;
+        if !matches!(finder.finder.get_params().check_method, CheckingMethod::Hash) {
+            return CCacheStats::default();
+        }
+
+        // Full hashing candidates are the size groups that survived prehashing
+        let info = finder.finder.get_information();
+        let duplicated = info.number_of_duplicated_files_after_pre_hash as u64;
+        let candidates = duplicated + info.number_of_groups_after_pre_hash as u64;
+        let work = finder.hashing_work;
+        let misses = work.full_hash_files.min(candidates);
+
+        // Only sum(size * (n - 1)) over the groups is known; extrapolate the
+        // candidates' total size as if every group had the average length
+        let candidate_bytes = if duplicated > 0 {
+            (u128::from(info.lost_space_after_pre_hash) * u128::from(candidates) / u128::from(duplicated)) as u64
+        } else {
+            0
+        };
+
+        CCacheStats {
+            candidates,
+            hits: candidates - misses,
+            misses,
+            bytes_hashed: work.full_hash_bytes,
+            bytes_saved: candidate_bytes.saturating_sub(work.full_hash_bytes),
+        }
+    }
+}
+
+// Copies up to capacity stages of the last search into out, in the order
+// they ran, and returns how many stages there are
+#[no_mangle]
+pub extern "C" fn czkawka_duplicate_finder_get_stage_stats(
+    finder: *const CzkawkaDuplicateFinder,
+    out: *mut CStageStats,
+    capacity: usize,
+) -> usize {
+    if finder.is_null() {
+        return 0;
     }
 
+    unsafe {
+        let stages = &(*finder).stage_stats;
+        if !out.is_null() {
+            let count = stages.len().min(capacity);
+            std::ptr::copy_nonoverlapping(stages.as_ptr(), out, count);
+        }
+        stages.len()
+    }
+}
+
+// Tables under construction for czkawka_duplicate_finder_export_results
+#[derive(Default)]
+struct ResultsExport {
+    groups: Vec<CDuplicateGroup>,
+    entries: Vec<CDuplicateEntry>,
+    strings: Vec<u8>,
+}
+
+impl ResultsExport {
+    // Copy bytes into the string arena, returning (offset, len)
+    fn push_str(&mut self, bytes: &[u8]) -> (usize, usize) {
+        let offset = self.strings.len();
+        self.strings.extend_from_slice(bytes);
+        (offset, bytes.len())
+    }
+
+    // Append one group of entries to the export tables
+    fn push_group(&mut self, entries: &[DuplicateEntry], with_hash: bool) {
+        self.groups.push(CDuplicateGroup {
+            first_entry: self.entries.len(),
+            count: entries.len(),
+        });
+
+        // Entries of a hash group share one hash; store it once
+        let mut last_hash: Option<(&str, (usize, usize))> = None;
+
+        for entry in entries {
+            let (path_offset, path_len) = self.push_str(entry.path.to_string_lossy().as_bytes());
+
+            let (hash_offset, hash_len) = if !with_hash {
+                (0, 0)
+            } else {
+                match last_hash {
+                    Some((hash, range)) if hash == entry.hash => range,
+                    _ => {
+                        let range = self.push_str(entry.hash.as_bytes());
+                        last_hash = Some((entry.hash.as_str(), range));
+                        range
+                    }
+                }
+            };
+
+            self.entries.push(CDuplicateEntry {
+                path_offset,
+                path_len,
+                size: entry.size,
+                modified_date: entry.modified_date,
+                hash_offset,
+                hash_len,
+            });
+        }
+    }
+}
+
+// Export all duplicate groups in a single pass.
+// Groups reference contiguous ranges of the entry table and entries reference
+// ranges of one shared string arena; free everything with czkawka_duplicate_results_free.
+#[no_mangle]
+pub extern "C" fn czkawka_duplicate_finder_export_results(
+    finder: *const CzkawkaDuplicateFinder,
+) -> *mut CDuplicateResults {
+    if finder.is_null() {
+        return std::ptr::null_mut();
+    }
+    let _span = TraceSpan::begin(c"czkawka_duplicate_finder_export_results");
+
     unsafe {
         let finder = &*finder;
+        let mut export = ResultsExport::default();
 
         match finder.finder.get_params().check_method {
             CheckingMethod::Hash => {
-                let groups = finder.finder.get_files_sorted_by_hash();
-                if let Some((_, group_vecs)) = groups.iter().nth(group_index) {
-                    // Flatten all vectors in this group
-                    let mut all_entries = Vec::new();
+                // Each size bucket holds one or more groups of identical hashes
+                for group_vecs in finder.finder.get_files_sorted_by_hash().values() {
                     for vec in group_vecs {
-                        all_entries.extend_from_slice(vec);
+                        export.push_group(vec, true);
                     }
-
-                    let c_entries: Vec<CDuplicateEntry> = all_entries
-                        .iter()
-                        .map(|entry| CDuplicateEntry {
-                            path: CString::new(entry.path.to_string_lossy().to_string())
-                                .unwrap()
-                                .into_raw(),
-                            size: entry.size,
-                            modified_date: entry.modified_date,
-                            hash: CString::new(entry.hash.clone()).unwrap().into_raw(),
-                        })
-                        .collect();
-
-                    *out_count = c_entries.len();
-                    *out_entries = Box::into_raw(c_entries.into_boxed_slice()) as *const CDuplicateEntry;
-                    return true;
                 }
             }
             CheckingMethod::Name => {
-                let groups = finder.finder.get_files_sorted_by_names();
-                if let Some((_, entries)) = groups.iter().nth(group_index) {
-                    let c_entries: Vec<CDuplicateEntry> = entries
-                        .iter()
-                        .map(|entry| CDuplicateEntry {
-                            path: CString::new(entry.path.to_string_lossy().to_string())
-                                .unwrap()
-                                .into_raw(),
-                            size: entry.size,
-                            modified_date: entry.modified_date,
-                            hash: CString::new("").unwrap().into_raw(),
-                        })
-                        .collect();
-
-                    *out_count = c_entries.len();
-                    *out_entries = Box::into_raw(c_entries.into_boxed_slice()) as *const CDuplicateEntry;
-                    return true;
+                for vec in finder.finder.get_files_sorted_by_names().values() {
+                    export.push_group(vec, false);
                 }
             }
             CheckingMethod::Size => {
-                let groups = finder.finder.get_files_sorted_by_size();
-                if let Some((_, entries)) = groups.iter().nth(group_index) {
-                    let c_entries: Vec<CDuplicateEntry> = entries
-                        .iter()
-                        .map(|entry| CDuplicateEntry {
-                            path: CString::new(entry.path.to_string_lossy().to_string())
-                                .unwrap()
-                                .into_raw(),
-                            size: entry.size,
-                            modified_date: entry.modified_date,
-                            hash: CString::new("").unwrap().into_raw(),
-                        })
-                        .collect();
-
-                    *out_count = c_entries.len();
-                    *out_entries = Box::into_raw(c_entries.into_boxed_slice()) as *const CDuplicateEntry;
-                    return true;
+                for vec in finder.finder.get_files_sorted_by_size().values() {
+                    export.push_group(vec, false);
                 }
             }
             CheckingMethod::SizeName => {
-                let groups = finder.finder.get_files_sorted_by_size_name();
-                if let Some((_, entries)) = groups.iter().nth(group_index) {
-                    let c_entries: Vec<CDuplicateEntry> = entries
-                        .iter()
-                        .map(|entry| CDuplicateEntry {
-                            path: CString::new(entry.path.to_string_lossy().to_string())
-                                .unwrap()
-                                .into_raw(),
-                            size: entry.size,
-                            modified_date: entry.modified_date,
-                            hash: CString::new("").unwrap().into_raw(),
-                        })
-                        .collect();
-
-                    *out_count = c_entries.len();
-                    *out_entries = Box::into_raw(c_entries.into_boxed_slice()) as *const CDuplicateEntry;
-                    return true;
+                for vec in finder.finder.get_files_sorted_by_size_name().values() {
+                    export.push_group(vec, false);
                 }
             }
             _ => {}
         }
 
-        false
+        let group_count = export.groups.len();
+        let total_files = export.entries.len();
+        let strings_len = export.strings.len();
+
+        Box::into_raw(Box::new(CDuplicateResults {
+            groups: Box::into_raw(export.groups.into_boxed_slice()) as *const CDuplicateGroup,
+            group_count,
+            entries: Box::into_raw(export.entries.into_boxed_slice()) as *const CDuplicateEntry,
+            total_files,
+            strings: Box::into_raw(export.strings.into_boxed_slice()) as *const u8,
+            strings_len,
+            wasted_space: czkawka_duplicate_finder_get_wasted_space(finder),
+        }))
     }
 }
 
-// Free duplicate entry array
+// Free results returned by czkawka_duplicate_finder_export_results
 #[no_mangle]
-pub extern "C" fn czkawka_duplicate_entries_free(entries: *mut CDuplicateEntry, count: usize) {
-    if entries.is_null() {
+pub extern "C" fn czkawka_duplicate_results_free(results: *mut CDuplicateResults) {
+    if results.is_null() {
         return;
     }
 
     unsafe {
-        let entries_slice = std::slice::from_raw_parts_mut(entries, count);
-        for entry in entries_slice {
-            if !entry.path.is_null() {
-                let _ = CString::from_raw(entry.path as *mut c_char);
+        let results = Box::from_raw(results);
+
+        let _ = Box::from_raw(std::slice::from_raw_parts_mut(
+            results.groups as *mut CDuplicateGroup,
+            results.group_count,
+        ));
+        let _ = Box::from_raw(std::slice::from_raw_parts_mut(
+            results.entries as *mut CDuplicateEntry,
+            results.total_files,
+        ));
+        let _ = Box::from_raw(std::slice::from_raw_parts_mut(
+            results.strings as *mut u8,
+            results.strings_len,
+        ));
+    }
+}
+
+// Longest hash czkawka_hash_file writes, without the terminating NUL
+pub const CZKAWKA_HASH_MAX_LEN: usize = 64;
+
+// The hashers czkawka uses, with its string formats
+enum FileHasher {
+    Blake3(blake3::Hasher),
+    Crc32(crc32fast::Hasher),
+    Xxh3(xxhash_rust::xxh3::Xxh3),
+}
+
+impl FileHasher {
+    fn new(hash_type: CHashType) -> Self {
+        match hash_type {
+            CHashType::Blake3 => FileHasher::Blake3(blake3::Hasher::new()),
+            CHashType::Crc32 => FileHasher::Crc32(crc32fast::Hasher::new()),
+            CHashType::Xxh3 => FileHasher::Xxh3(xxhash_rust::xxh3::Xxh3::new()),
+        }
+    }
+
+    fn update(&mut self, bytes: &[u8]) {
+        match self {
+            FileHasher::Blake3(hasher) => {
+                hasher.update(bytes);
             }
-            if !entry.hash.is_null() {
-                let _ = CString::from_raw(entry.hash as *mut c_char);
+            FileHasher::Crc32(hasher) => hasher.update(bytes),
+            FileHasher::Xxh3(hasher) => hasher.update(bytes),
+        }
+    }
+
+    fn finalize(self) -> String {
+        match self {
+            FileHasher::Blake3(hasher) => hasher.finalize().to_hex().to_string(),
+            FileHasher::Crc32(hasher) => hasher.finalize().to_string(),
+            FileHasher::Xxh3(hasher) => hasher.digest().to_string(),
+        }
+    }
+}
+
+// Counts the files being read at once against a limit
+struct ReadSlots {
+    free: Mutex<usize>,
+    released: Condvar,
+}
+
+// Held while a file is read; returns its slot when dropped
+struct ReadSlot<'a>(&'a ReadSlots);
+
+impl ReadSlots {
+    fn new(count: usize) -> Self {
+        ReadSlots {
+            free: Mutex::new(count),
+            released: Condvar::new(),
+        }
+    }
+
+    fn acquire(&self) -> ReadSlot<'_> {
+        let mut free = self.free.lock().unwrap_or_else(|poisoned| poisoned.into_inner());
+        while *free == 0 {
+            free = self.released.wait(free).unwrap_or_else(|poisoned| poisoned.into_inner());
+        }
+        *free -= 1;
+        ReadSlot(self)
+    }
+}
+
+impl Drop for ReadSlot<'_> {
+    fn drop(&mut self) {
+        *self.0.free.lock().unwrap_or_else(|poisoned| poisoned.into_inner()) += 1;
+        self.0.released.notify_one();
+    }
+}
+
+// Hash at most limit bytes from the start of a file, in a read slot if
+// slots is set; None when it cannot be read or stop_flag was set
+fn hash_path(
+    path: &str,
+    hash_type: CHashType,
+    limit: u64,
+    slots: Option<&ReadSlots>,
+    stop_flag: Option<&AtomicBool>,
+) -> Option<String> {
+    let _slot = slots.map(ReadSlots::acquire);
+    let mut file = File::open(path).ok()?.take(limit);
+    let mut hasher = FileHasher::new(hash_type);
+    let mut buffer = vec![0u8; 256 * 1024];
+    loop {
+        // Set by another thread; polled once per chunk
+        if stop_flag.is_some_and(|flag| flag.load(Ordering::Relaxed)) {
+            return None;
+        }
+        match file.read(&mut buffer) {
+            Ok(0) => break,
+            Ok(count) => hasher.update(&buffer[..count]),
+            Err(error) if error.kind() == ErrorKind::Interrupted => continue,
+            Err(_) => return None,
+        }
+    }
+    Some(hasher.finalize())
+}
+
+// Copy hash into out, which holds CZKAWKA_HASH_MAX_LEN + 1 bytes, with a NUL
+fn write_hash(hash: &str, out: *mut c_char) -> usize {
+    let len = hash.len().min(CZKAWKA_HASH_MAX_LEN);
+    unsafe {
+        std::ptr::copy_nonoverlapping(hash.as_ptr(), out as *mut u8, len);
+        *out.add(len) = 0;
+    }
+    len
+}
+
+// Hash the whole content of one file, as czkawka's full hashing stage would.
+// Writes a NUL-terminated hash into out, which must hold CZKAWKA_HASH_MAX_LEN + 1
+// bytes, and returns its length. Returns 0 when the file cannot be read or
+// stop_flag, which may be null, was set.
+#[no_mangle]
+pub extern "C" fn czkawka_hash_file(
+    path: *const c_char,
+    hash_type: CHashType,
+    stop_flag: *const AtomicBool,
+    out: *mut c_char,
+    out_len: usize,
+) -> usize {
+    if path.is_null() || out.is_null() || out_len <= CZKAWKA_HASH_MAX_LEN {
+        return 0;
+    }
+    let _span = TraceSpan::begin(c"czkawka_hash_file");
+
+    let path = match unsafe { CStr::from_ptr(path) }.to_str() {
+        Ok(path) => path,
+        Err(_) => return 0,
+    };
+    match hash_path(path, hash_type, u64::MAX, None, unsafe { stop_flag.as_ref() }) {
+        Some(hash) => write_hash(&hash, out),
+        None => 0,
+    }
+}
+
+// Bytes a prehash reads; a file up to this size is read whole, so its
+// prehash is its full hash
+pub const CZKAWKA_PREHASH_SIZE: u64 = 16 * 1024;
+
+// One file of czkawka_duplicate_finder_hash_files()
+#[repr(C)]
+pub struct CHashJob {
+    pub path: *const c_char,
+    pub size: u64,
+    // Set once the file was read, or failed to be
+    pub done: bool,
+    // NUL-terminated, empty when the file could not be read
+    pub hash: [c_char; CZKAWKA_HASH_MAX_LEN + 1],
+}
+
+// Each job, and the path it points to, is only used by the worker it is handed to
+unsafe impl Send for CHashJob {}
+
+// Reports the work of czkawka_duplicate_finder_hash_files() from its workers
+// at a bounded rate
+struct HashProgress {
+    callback: Option<ProgressCallback>,
+    user_data: *mut c_void,
+    min_interval: Duration,
+    progress: CScanProgress,
+    files: AtomicU64,
+    bytes: AtomicU64,
+    last_emit: Mutex<Instant>,
+}
+
+// The caller guarantees user_data may be used from the workers
+unsafe impl Sync for HashProgress {}
+
+impl HashProgress {
+    fn add(&self, bytes: u64) {
+        self.files.fetch_add(1, Ordering::Relaxed);
+        self.bytes.fetch_add(bytes, Ordering::Relaxed);
+        // A worker that finds another one reporting leaves the report to it
+        if let Ok(mut last_emit) = self.last_emit.try_lock() {
+            if last_emit.elapsed() >= self.min_interval {
+                self.emit();
+                *last_emit = Instant::now();
             }
         }
-        let _ = Box::from_raw(std::slice::from_raw_parts_mut(entries, count));
+    }
+
+    fn emit(&self) {
+        if let Some(callback) = self.callback {
+            let mut progress = self.progress;
+            progress.entries_checked = self.files.load(Ordering::Relaxed);
+            progress.bytes_checked = self.bytes.load(Ordering::Relaxed);
+            callback(&progress, self.user_data);
+        }
+    }
+}
+
+// Hash the files of jobs[0..count) in parallel, on a pool with the finder's
+// thread and read limits and priority, with the finder's hash type. With prehash,
+// only the first CZKAWKA_PREHASH_SIZE bytes of each file are read. progress
+// gives the stage and its totals for the finder's progress callback, which
+// workers call with the files and bytes done. czkawka_duplicate_finder_stop()
+// leaves the remaining jobs not done. Returns the number of jobs done.
+#[no_mangle]
+pub extern "C" fn czkawka_duplicate_finder_hash_files(
+    finder: *mut CzkawkaDuplicateFinder,
+    jobs: *mut CHashJob,
+    count: usize,
+    prehash: bool,
+    progress: CScanProgress,
+) -> usize {
+    if finder.is_null() || jobs.is_null() {
+        return 0;
+    }
+    let _span = TraceSpan::begin(c"czkawka_duplicate_finder_hash_files");
+
+    let finder = unsafe { &*finder };
+    let jobs = unsafe { std::slice::from_raw_parts_mut(jobs, count) };
+    let limit = if prehash { CZKAWKA_PREHASH_SIZE } else { u64::MAX };
+    let stop_flag = &*finder.stop_flag;
+    let hash_type = finder.hash_type;
+    let slots = (finder.io_threads > 0).then(|| ReadSlots::new(finder.io_threads));
+    let reporter = HashProgress {
+        callback: finder.progress_callback,
+        user_data: finder.progress_user_data,
+        min_interval: finder.progress_interval,
+        progress,
+        files: AtomicU64::new(0),
+        bytes: AtomicU64::new(0),
+        last_emit: Mutex::new(Instant::now()),
+    };
+
+    let mut hash_all = || {
+        jobs.par_iter_mut().for_each(|job| {
+            if stop_flag.load(Ordering::Relaxed) {
+                return;
+            }
+            let path = (!job.path.is_null()).then(|| unsafe { CStr::from_ptr(job.path) });
+            let hash = path
+                .and_then(|path| path.to_str().ok())
+                .and_then(|path| hash_path(path, hash_type, limit, slots.as_ref(), Some(stop_flag)));
+            // A read cut short by stop is not done
+            if stop_flag.load(Ordering::Relaxed) {
+                return;
+            }
+            match hash {
+                Some(hash) => {
+                    write_hash(&hash, job.hash.as_mut_ptr());
+                }
+                None => job.hash[0] = 0,
+            }
+            job.done = true;
+            reporter.add(job.size.min(limit));
+        })
+    };
+    match finder_pool(finder, finder.cpu_threads) {
+        Some(pool) => pool.install(hash_all),
+        None => hash_all(),
+    }
+    reporter.emit();
+
+    jobs.iter().filter(|job| job.done).count()
+}
+
+// Report spans of the bridge and czkawka's stages to callback, or stop
+// reporting them with a null callback. Applies to every finder.
+#[no_mangle]
+pub extern "C" fn czkawka_set_trace_callback(callback: Option<TraceCallback>, user_data: *mut c_void) {
+    TRACE_USER_DATA.store(user_data, Ordering::Relaxed);
+    TRACE_CALLBACK.store(callback.map_or(0, |callback| callback as usize), Ordering::Release);
+}
+
+// Give the calling thread the lowest CPU priority (nice 19) and the idle I/O
+// class, so it only uses what other processes leave. Linux applies both per
+// thread; a thread cannot raise them again without privileges.
+#[no_mangle]
+pub extern "C" fn czkawka_set_background_priority() {
+    const IOPRIO_WHO_PROCESS: libc::c_int = 1;
+    const IOPRIO_CLASS_IDLE: libc::c_int = 3;
+    const IOPRIO_CLASS_SHIFT: libc::c_int = 13;
+
+    unsafe {
+        let thread = libc::gettid();
+        libc::setpriority(libc::PRIO_PROCESS, thread as libc::id_t, 19);
+        libc::syscall(libc::SYS_ioprio_set, IOPRIO_WHO_PROCESS, thread, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
     }
 }
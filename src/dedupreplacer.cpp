@@ -0,0 +1,151 @@
+#include "dedupreplacer.h"
+#include <QByteArray>
+#include <QFile>
+#include <QRandomGenerator>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef Q_OS_LINUX
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace {
+// Temporary names only collide with leftovers or concurrent runs
+constexpr int MaxTempNameAttempts = 16;
+
+// Closes a file descriptor when leaving scope
+struct FileDescriptor {
+    int fd;
+    explicit FileDescriptor(int fd) : fd(fd) {}
+    ~FileDescriptor() { if (fd >= 0) ::close(fd); }
+    FileDescriptor(const FileDescriptor &) = delete;
+    FileDescriptor &operator=(const FileDescriptor &) = delete;
+};
+
+QByteArray tempNameFor(const QByteArray &name)
+{
+    return '.' + name + ".dedup-" + QByteArray::number(QRandomGenerator::global()->generate(), 16);
+}
+
+// Creates tempName in dirFd as a clone of original carrying the duplicate's
+// metadata. Returns 0 or an errno value; on failure nothing is left behind.
+int cloneInto(int dirFd, const QByteArray &tempName, const QByteArray &original, const struct stat &duplicateStat)
+{
+#ifdef Q_OS_LINUX
+    FileDescriptor source(::open(original.constData(), O_RDONLY | O_CLOEXEC));
+    if (source.fd < 0) {
+        return errno;
+    }
+
+    FileDescriptor target(::openat(dirFd, tempName.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                                   duplicateStat.st_mode & 07777));
+    if (target.fd < 0) {
+        return errno;
+    }
+
+    auto fail = [&](int error) {
+        ::unlinkat(dirFd, tempName.constData(), 0);
+        return error;
+    };
+
+    // Without shared extents the result would be a plain copy that frees
+    // nothing, so every clone error fails the file instead
+    if (::ioctl(target.fd, FICLONE, source.fd) != 0) {
+        return fail(errno);
+    }
+
+    // Only the storage changes; ownership, mode and times stay the duplicate's.
+    // Ownership can only be kept when we are allowed to set it.
+    if (::fchown(target.fd, duplicateStat.st_uid, duplicateStat.st_gid) != 0 && errno != EPERM) {
+        return fail(errno);
+    }
+    const struct timespec times[2] = {duplicateStat.st_atim, duplicateStat.st_mtim};
+    if (::fchmod(target.fd, duplicateStat.st_mode & 07777) != 0
+        || ::futimens(target.fd, times) != 0
+        || ::fsync(target.fd) != 0) {
+        return fail(errno);
+    }
+    return 0;
+#else
+    Q_UNUSED(dirFd);
+    Q_UNUSED(tempName);
+    Q_UNUSED(original);
+    Q_UNUSED(duplicateStat);
+    return ENOTSUP;
+#endif
+}
+}
+
+DedupReplacer::Result DedupReplacer::replace(Mode mode, const QString &duplicate, const QString &original, QString *error)
+{
+    auto failWith = [error](int errorCode, Result result = Result::Failed) {
+        if (error) {
+            *error = qt_error_string(errorCode);
+        }
+        return result;
+    };
+
+    const QByteArray duplicatePath = QFile::encodeName(duplicate);
+    const QByteArray originalPath = QFile::encodeName(original);
+
+    struct stat duplicateStat;
+    if (::lstat(duplicatePath.constData(), &duplicateStat) != 0) {
+        return failWith(errno, errno == ENOENT ? Result::Missing : Result::Failed);
+    }
+
+    // Never replace a duplicate whose kept copy has gone missing
+    struct stat originalStat;
+    if (::stat(originalPath.constData(), &originalStat) != 0) {
+        return failWith(errno);
+    }
+
+    if (mode != Mode::Symlink && duplicateStat.st_dev != originalStat.st_dev) {
+        return failWith(EXDEV);
+    }
+    if (duplicateStat.st_dev == originalStat.st_dev && duplicateStat.st_ino == originalStat.st_ino) {
+        // Replacing a file with a link to itself would only lose it
+        return mode == Mode::Hardlink ? Result::AlreadyLinked : failWith(EINVAL);
+    }
+
+    const int slash = duplicatePath.lastIndexOf('/');
+    const QByteArray directory = slash > 0 ? duplicatePath.left(slash) : QByteArray(slash == 0 ? "/" : ".");
+    const QByteArray name = duplicatePath.mid(slash + 1);
+
+    FileDescriptor dirFd(::open(directory.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (dirFd.fd < 0) {
+        return failWith(errno);
+    }
+
+    // Build the replacement next to the duplicate under a fresh name
+    QByteArray tempName;
+    int rc = EEXIST;
+    for (int attempt = 0; attempt < MaxTempNameAttempts && rc == EEXIST; ++attempt) {
+        tempName = tempNameFor(name);
+        switch (mode) {
+        case Mode::Hardlink:
+            rc = ::linkat(AT_FDCWD, originalPath.constData(), dirFd.fd, tempName.constData(), 0) == 0 ? 0 : errno;
+            break;
+        case Mode::Symlink:
+            rc = ::symlinkat(originalPath.constData(), dirFd.fd, tempName.constData()) == 0 ? 0 : errno;
+            break;
+        case Mode::Reflink:
+            rc = cloneInto(dirFd.fd, tempName, originalPath, duplicateStat);
+            break;
+        }
+    }
+    if (rc != 0) {
+        return failWith(rc);
+    }
+
+    // The only step that touches the duplicate, and it is atomic
+    if (::renameat(dirFd.fd, tempName.constData(), dirFd.fd, name.constData()) != 0) {
+        const int renameError = errno;
+        ::unlinkat(dirFd.fd, tempName.constData(), 0);
+        return failWith(renameError);
+    }
+
+    return Result::Replaced;
+}
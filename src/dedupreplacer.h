@@ -0,0 +1,32 @@
+#ifndef DEDUPREPLACER_H
+#define DEDUPREPLACER_H
+
+#include <QString>
+
+// Replaces a duplicate file with a link to, or clone of, its original.
+//
+// The replacement is first created under a temporary name in the duplicate's
+// directory and then renamed over the duplicate, so at every point in time the
+// duplicate's path holds either the old file or the complete replacement.
+// Safe to call from several threads at once.
+class DedupReplacer
+{
+public:
+    enum class Mode {
+        Hardlink, // linkat(): the duplicate becomes another name of the original's inode
+        Symlink,  // symlinkat(): the duplicate points at the original's path
+        Reflink,  // FICLONE: a separate inode sharing the original's extents, never a plain copy
+    };
+
+    enum class Result {
+        Replaced,
+        AlreadyLinked, // Hardlink mode only: both paths already share an inode
+        Missing,       // The duplicate no longer exists
+        Failed,
+    };
+
+    // error receives a description when the result is Missing or Failed
+    static Result replace(Mode mode, const QString &duplicate, const QString &original, QString *error = nullptr);
+};
+
+#endif // DEDUPREPLACER_H
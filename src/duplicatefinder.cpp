@@ -1,12 +1,113 @@
 #include "duplicatefinder.h"
+#include "duplicateresults.h"
+#include "fileindex.h"
+#include "trace.h"
 #include "czkawka_bridge/czkawka_bridge.h"
 #include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+
+#include <algorithm>
+#include <cerrno>
+#include <fts.h>
+#include <iterator>
+#include <numeric>
+#include <sys/stat.h>
+#include <tuple>
+#include <vector>
+
+namespace {
+// Bounds on one streamed batch, so appending a batch never stalls the UI thread
+constexpr int MaxBatchGroups = 1000;
+constexpr int MaxBatchEntries = 20000;
+constexpr qint64 MaxBatchIntervalMs = 100;
+constexpr qint64 ProgressIntervalMs = 100;
+
+bool batchIsDue(const DuplicateResults::Builder &batch, const QElapsedTimer &timer)
+{
+    return batch.groupCount() >= MaxBatchGroups || batch.entryCount() >= MaxBatchEntries
+        || timer.hasExpired(MaxBatchIntervalMs);
+}
+
+// Stage names as static strings, which is what trace spans are named with
+const char *stageKey(DuplicateFinder::ScanStage stage)
+{
+    switch (stage) {
+    case DuplicateFinder::ScanStage::CollectingFiles:
+        return "collecting_files";
+    case DuplicateFinder::ScanStage::ScanningName:
+        return "scanning_name";
+    case DuplicateFinder::ScanStage::ScanningSizeName:
+        return "scanning_size_name";
+    case DuplicateFinder::ScanStage::ScanningSize:
+        return "scanning_size";
+    case DuplicateFinder::ScanStage::PreHashCacheLoading:
+        return "prehash_cache_loading";
+    case DuplicateFinder::ScanStage::PreHashing:
+        return "prehashing";
+    case DuplicateFinder::ScanStage::PreHashCacheSaving:
+        return "prehash_cache_saving";
+    case DuplicateFinder::ScanStage::FullHashCacheLoading:
+        return "hash_cache_loading";
+    case DuplicateFinder::ScanStage::FullHashing:
+        return "hashing";
+    case DuplicateFinder::ScanStage::FullHashCacheSaving:
+        return "hash_cache_saving";
+    case DuplicateFinder::ScanStage::FetchingResults:
+        return "fetching_results";
+    case DuplicateFinder::ScanStage::Other:
+        break;
+    }
+    return "other";
+}
+
+bool isInside(const QString &path, const QString &directory)
+{
+    if (!path.startsWith(directory)) {
+        return false;
+    }
+    return path.size() == directory.size() || directory.endsWith(QLatin1Char('/'))
+        || path.at(directory.size()) == QLatin1Char('/');
+}
+
+// Roots inside another root would be walked twice
+QStringList outermostRoots(const QStringList &paths)
+{
+    QStringList roots;
+    for (const QString &path : paths) {
+        roots.append(QDir::cleanPath(path));
+    }
+    roots.removeDuplicates();
+
+    QStringList outermost;
+    for (const QString &root : std::as_const(roots)) {
+        const bool nested = std::any_of(roots.cbegin(), roots.cend(), [&root](const QString &other) {
+            return other != root && isInside(root, other);
+        });
+        if (!nested) {
+            outermost.append(root);
+        }
+    }
+    return outermost;
+}
+
+struct ScannedFile {
+    QString path;
+    FileIndex::Entry entry;   // hash is empty until known
+    quint64 device;
+    int root;                 // Index of the root it was found under
+};
+}
 
 DuplicateFinder::DuplicateFinder(QObject *parent)
     : QObject(parent)
     , m_scanThread(nullptr)
     , m_groupCount(0)
     , m_wastedSpace(0)
+    , m_receiverTimeUs(0)
+    , m_keepResults(true)
 {
 }
 
@@ -30,22 +131,58 @@ void DuplicateFinder::startScan(const ScanParameters &params)
         delete m_scanThread;
     }
 
+    if (params.useCache) {
+        if (!params.cacheDirectory.isEmpty()) {
+            QDir().mkpath(params.cacheDirectory);
+        }
+        if (!czkawka_set_cache_path(QFile::encodeName(params.cacheDirectory).constData())) {
+            qWarning() << "Hash cache directory is fixed until restart, ignoring" << params.cacheDirectory;
+        }
+    }
+
     m_scanThread = new ScanThread(params, this);
+    m_results.clear();
+    m_groupCount = 0;
+    m_wastedSpace = 0;
+    m_cacheStats = CacheStats();
+    m_statistics = ScanStatistics();
+    m_receiverTimeUs = 0;
 
     connect(m_scanThread, &ScanThread::progress, this, &DuplicateFinder::scanProgress);
+    connect(m_scanThread, &ScanThread::groupsFetched, this, [this](const DuplicateResultsPtr &groups) {
+        if (m_keepResults) {
+            m_results.append(groups);
+        }
+        QElapsedTimer receiverTimer;
+        receiverTimer.start();
+        Q_EMIT groupsAvailable(groups);
+        m_receiverTimeUs += receiverTimer.nsecsElapsed() / 1000;
+    });
     connect(m_scanThread, &ScanThread::finished, this, [this]() {
-        m_results = m_scanThread->getResults();
         m_groupCount = m_scanThread->getGroupCount();
         m_wastedSpace = m_scanThread->getWastedSpace();
-
-        Q_EMIT resultsReady(m_groupCount, m_wastedSpace);
-        Q_EMIT scanFinished(true);
+        m_cacheStats = m_scanThread->getCacheStats();
+        m_statistics = m_scanThread->getStatistics();
+        m_statistics.totalTimeUs = m_scanTimer.nsecsElapsed() / 1000;
+        m_statistics.receiverTimeUs = m_receiverTimeUs;
+        m_statistics.groupCount = m_groupCount;
+        m_statistics.wastedSpace = m_wastedSpace;
+        m_statistics.cache = m_cacheStats;
+
+        Q_EMIT resultsReady(m_groupCount, m_wastedSpace, m_statistics);
+        Q_EMIT scanFinished(m_scanThread->succeeded());
     });
 
     Q_EMIT scanStarted();
+    m_scanTimer.start();
     m_scanThread->start();
 }
 
+bool DuplicateFinder::isCacheDirectoryFixed()
+{
+    return czkawka_cache_path_resolved();
+}
+
 void DuplicateFinder::stopScan()
 {
     if (m_scanThread && m_scanThread->isRunning()) {
@@ -53,7 +190,12 @@ void DuplicateFinder::stopScan()
     }
 }
 
-QList<DuplicateFinder::DuplicateGroup> DuplicateFinder::getResults() const
+void DuplicateFinder::setKeepResults(bool keep)
+{
+    m_keepResults = keep;
+}
+
+const QList<DuplicateResultsPtr> &DuplicateFinder::getResults() const
 {
     return m_results;
 }
@@ -68,6 +210,31 @@ quint64 DuplicateFinder::getWastedSpace() const
     return m_wastedSpace;
 }
 
+DuplicateFinder::CacheStats DuplicateFinder::getCacheStats() const
+{
+    return m_cacheStats;
+}
+
+DuplicateFinder::ScanStatistics DuplicateFinder::getScanStatistics() const
+{
+    return m_statistics;
+}
+
+QString DuplicateFinder::stageName(ScanStage stage)
+{
+    return QString::fromLatin1(stageKey(stage));
+}
+
+double DuplicateFinder::StageStatistics::filesPerSecond() const
+{
+    return wallTimeUs > 0 ? double(files) * 1e6 / double(wallTimeUs) : 0.0;
+}
+
+double DuplicateFinder::StageStatistics::bytesPerSecond() const
+{
+    return wallTimeUs > 0 ? double(bytes) * 1e6 / double(wallTimeUs) : 0.0;
+}
+
 // ScanThread implementation
 
 DuplicateFinder::ScanThread::ScanThread(const DuplicateFinder::ScanParameters &params, QObject *parent)
@@ -76,6 +243,7 @@ DuplicateFinder::ScanThread::ScanThread(const DuplicateFinder::ScanParameters &p
     , m_finder(nullptr)
     , m_groupCount(0)
     , m_wastedSpace(0)
+    , m_succeeded(false)
     , m_shouldStop(false)
 {
 }
@@ -95,9 +263,9 @@ void DuplicateFinder::ScanThread::stop()
     }
 }
 
-QList<DuplicateFinder::DuplicateGroup> DuplicateFinder::ScanThread::getResults() const
+bool DuplicateFinder::ScanThread::succeeded() const
 {
-    return m_results;
+    return m_succeeded;
 }
 
 int DuplicateFinder::ScanThread::getGroupCount() const
@@ -110,14 +278,76 @@ quint64 DuplicateFinder::ScanThread::getWastedSpace() const
     return m_wastedSpace;
 }
 
+DuplicateFinder::CacheStats DuplicateFinder::ScanThread::getCacheStats() const
+{
+    return m_cacheStats;
+}
+
+DuplicateFinder::ScanStatistics DuplicateFinder::ScanThread::getStatistics() const
+{
+    return m_statistics;
+}
+
+void DuplicateFinder::ScanThread::beginStage(ScanStage stage)
+{
+    StageStatistics statistics;
+    statistics.stage = stage;
+    m_statistics.stages.append(statistics);
+    m_stageTimer.start();
+}
+
+void DuplicateFinder::ScanThread::endStage(quint64 files, quint64 bytes)
+{
+    StageStatistics &statistics = m_statistics.stages.last();
+    const qint64 elapsedNs = m_stageTimer.nsecsElapsed();
+    if (Trace::isEnabled()) {
+        Trace::complete(stageKey(statistics.stage), Trace::now() - elapsedNs);
+    }
+    statistics.wallTimeUs = elapsedNs / 1000;
+    statistics.files = files;
+    statistics.bytes = bytes;
+}
+
+void DuplicateFinder::ScanThread::bridgeProgress(const CScanProgress *progress, void *userData)
+{
+    // Called on the bridge's forwarding thread; the signal is queued to the receiver
+    auto *thread = static_cast<ScanThread *>(userData);
+
+    ScanProgress scanProgress;
+    scanProgress.stage = static_cast<ScanStage>(progress->stage);
+    scanProgress.stageIndex = progress->current_stage_idx;
+    scanProgress.stageCount = progress->max_stage_idx + 1;
+    scanProgress.entriesChecked = progress->entries_checked;
+    scanProgress.entriesToCheck = progress->entries_to_check;
+    scanProgress.bytesChecked = progress->bytes_checked;
+    scanProgress.bytesToCheck = progress->bytes_to_check;
+
+    Q_EMIT thread->progress(scanProgress);
+}
+
 void DuplicateFinder::ScanThread::run()
 {
+    Trace::Span span("ScanThread::run");
+
+    // Also covers the walk and the hashing of incremental scans, done here
+    if (m_params.background) {
+        czkawka_set_background_priority();
+    }
+
+    // Only content hashes are worth remembering; other methods never read files
+    if (m_params.incremental && m_params.checkMethod == 0) {
+        runIncremental();
+        return;
+    }
+
     // Create finder
     m_finder = czkawka_duplicate_finder_new(
         static_cast<CCheckingMethod>(m_params.checkMethod),
         static_cast<CHashType>(m_params.hashType),
         m_params.ignoreHardLinks,
-        m_params.useCache
+        m_params.useCache,
+        m_params.minimalCacheFileSize,
+        m_params.minimalPrehashCacheFileSize
     );
 
     if (!m_finder) {
@@ -126,11 +356,14 @@ void DuplicateFinder::ScanThread::run()
     }
 
     // Configure finder
+    czkawka_duplicate_finder_set_progress_callback(m_finder, &ScanThread::bridgeProgress, this, 100);
     czkawka_duplicate_finder_set_recursive(m_finder, m_params.recursive);
     czkawka_duplicate_finder_set_min_size(m_finder, m_params.minSize);
     if (m_params.maxSize > 0) {
         czkawka_duplicate_finder_set_max_size(m_finder, m_params.maxSize);
     }
+    czkawka_duplicate_finder_set_thread_limits(m_finder, quint32(qMax(m_params.cpuThreads, 0)),
+                                               quint32(qMax(m_params.ioThreads, 0)), m_params.background);
 
     // Add directories
     for (const QString &path : m_params.includePaths) {
@@ -152,41 +385,433 @@ void DuplicateFinder::ScanThread::run()
         return;
     }
 
-    // Get results
-    m_groupCount = czkawka_duplicate_finder_get_group_count(m_finder);
-    m_wastedSpace = czkawka_duplicate_finder_get_wasted_space(m_finder);
+    const CCacheStats cacheStats = czkawka_duplicate_finder_get_cache_stats(m_finder);
+    m_cacheStats.candidates = cacheStats.candidates;
+    m_cacheStats.hits = cacheStats.hits;
+    m_cacheStats.misses = cacheStats.misses;
+    m_cacheStats.bytesHashed = cacheStats.bytes_hashed;
+    m_cacheStats.bytesSaved = cacheStats.bytes_saved;
+
+    std::vector<CStageStats> stages(czkawka_duplicate_finder_get_stage_stats(m_finder, nullptr, 0));
+    stages.resize(czkawka_duplicate_finder_get_stage_stats(m_finder, stages.data(), stages.size()));
+    for (const CStageStats &stage : stages) {
+        StageStatistics statistics;
+        statistics.stage = static_cast<ScanStage>(stage.stage);
+        statistics.wallTimeUs = qint64(stage.wall_time_us);
+        statistics.files = stage.entries;
+        statistics.bytes = stage.bytes;
+        m_statistics.stages.append(statistics);
+    }
+
+    // Export all groups in one pass over the bridge results
+    beginStage(ScanStage::FetchingResults);
+    CDuplicateResults *results = czkawka_duplicate_finder_export_results(m_finder);
+    if (!results) {
+        qWarning() << "Failed to export scan results";
+        return;
+    }
+
+    m_groupCount = static_cast<int>(results->group_count);
+    m_wastedSpace = results->wasted_space;
 
     qDebug() << "Found" << m_groupCount << "duplicate groups";
     qDebug() << "Wasted space:" << m_wastedSpace << "bytes";
 
-    // Fetch all groups
+    const char *strings = reinterpret_cast<const char *>(results->strings);
+    int fetchedGroups = 0;
+
+    DuplicateResults::Builder batch;
+    QElapsedTimer batchTimer;
+    batchTimer.start();
+
     for (int i = 0; i < m_groupCount; ++i) {
-        if (m_shouldStop) return;
+        if (m_shouldStop) {
+            czkawka_duplicate_results_free(results);
+            return;
+        }
+
+        const CDuplicateGroup &cGroup = results->groups[i];
+        const CDuplicateEntry *entries = results->entries + cGroup.first_entry;
+
+        // Entries of a hash group share one arena range, so the first entry's hash is the group's
+        batch.beginGroup(cGroup.count > 0
+            ? QString::fromUtf8(strings + entries[0].hash_offset, entries[0].hash_len)
+            : QString());
+
+        for (size_t j = 0; j < cGroup.count; ++j) {
+            const CDuplicateEntry &cEntry = entries[j];
+            batch.addEntry(QString::fromUtf8(strings + cEntry.path_offset, cEntry.path_len),
+                           cEntry.size,
+                           cEntry.modified_date);
+        }
 
-        const CDuplicateEntry *entries = nullptr;
-        size_t count = 0;
+        // Flush a batch once it is large or old enough, and at the end
+        if (batchIsDue(batch, batchTimer) || i + 1 == m_groupCount) {
+            fetchedGroups += batch.groupCount();
+            Q_EMIT groupsFetched(batch.build());
+            batchTimer.restart();
+        }
+
+        // Progress per group would flood the event loop on large result sets
+        if ((i + 1) % 1024 == 0 || i + 1 == m_groupCount) {
+            ScanProgress fetchProgress;
+            fetchProgress.stage = ScanStage::FetchingResults;
+            fetchProgress.entriesChecked = i + 1;
+            fetchProgress.entriesToCheck = m_groupCount;
+            Q_EMIT progress(fetchProgress);
+        }
+    }
+
+    endStage(results->total_files, 0);
+    czkawka_duplicate_results_free(results);
+    m_succeeded = true;
+
+    qDebug() << "Scan completed, processed" << fetchedGroups << "groups";
+}
+
+void DuplicateFinder::ScanThread::runIncremental()
+{
+    constexpr int StageCount = 3;
+
+    const QStringList roots = outermostRoots(m_params.includePaths);
+    QStringList excluded;
+    for (const QString &path : m_params.excludePaths) {
+        excluded.append(QDir::cleanPath(path));
+    }
+    auto isExcluded = [&excluded](const QString &path) {
+        return std::any_of(excluded.cbegin(), excluded.cend(), [&path](const QString &directory) {
+            return isInside(path, directory);
+        });
+    };
+
+    const QString indexDirectory = m_params.indexDirectory.isEmpty()
+        ? FileIndex::defaultDirectory() : m_params.indexDirectory;
+    std::vector<FileIndex> indexes;
+    indexes.reserve(roots.size());
+    for (const QString &root : roots) {
+        indexes.emplace_back(root, m_params.hashType);
+        indexes.back().load(indexDirectory);
+    }
+
+    QElapsedTimer progressTimer;
+    progressTimer.start();
+    auto reportProgress = [this, &progressTimer](const ScanProgress &scanProgress, bool force) {
+        if (force || progressTimer.hasExpired(ProgressIntervalMs)) {
+            Q_EMIT progress(scanProgress);
+            progressTimer.restart();
+        }
+    };
+
+    // Stage 1: walk the roots; stat() is all a file costs here
+    ScanProgress walkProgress;
+    walkProgress.stage = ScanStage::CollectingFiles;
+    walkProgress.stageIndex = 0;
+    walkProgress.stageCount = StageCount;
+    reportProgress(walkProgress, true);
+    beginStage(ScanStage::CollectingFiles);
+
+    std::vector<ScannedFile> files;
+    quint64 walkedBytes = 0;
+    // A root that cannot be walked fails the scan; its files would be missing from the groups
+    bool walkFailed = false;
+    for (int root = 0; root < roots.size(); ++root) {
+        QByteArray rootPath = QFile::encodeName(roots[root]);
+        char *paths[] = {rootPath.data(), nullptr};
+        FTS *fts = ::fts_open(paths, FTS_PHYSICAL | FTS_NOCHDIR, nullptr);
+        if (!fts) {
+            qWarning() << "Cannot scan" << roots[root] << qt_error_string(errno);
+            walkFailed = true;
+            continue;
+        }
+
+        while (FTSENT *node = ::fts_read(fts)) {
+            if (m_shouldStop) {
+                ::fts_close(fts);
+                return;
+            }
+
+            if (node->fts_level == 0 && (node->fts_info == FTS_NS || node->fts_info == FTS_ERR
+                                         || node->fts_info == FTS_DNR)) {
+                qWarning() << "Cannot scan" << roots[root] << qt_error_string(node->fts_errno);
+                walkFailed = true;
+                continue;
+            }
+            if (node->fts_info == FTS_D) {
+                if ((node->fts_level > 0 && !m_params.recursive) || isExcluded(QFile::decodeName(node->fts_path))) {
+                    ::fts_set(fts, node, FTS_SKIP);
+                }
+                continue;
+            }
+            // Symbolic links, unreadable directories and failed stats are skipped like czkawka does
+            if (node->fts_info != FTS_F) {
+                continue;
+            }
+
+            const struct stat *fileStat = node->fts_statp;
+            const quint64 size = quint64(fileStat->st_size);
+            if (size < m_params.minSize || (m_params.maxSize > 0 && size > m_params.maxSize)) {
+                continue;
+            }
+
+            ScannedFile file;
+            file.path = QFile::decodeName(node->fts_path);
+            file.entry.inode = quint64(fileStat->st_ino);
+            file.entry.size = size;
+            file.entry.modifiedDate = quint64(fileStat->st_mtime);
+            file.device = quint64(fileStat->st_dev);
+            file.root = root;
+            files.push_back(std::move(file));
+            walkedBytes += size;
+
+            walkProgress.entriesChecked = files.size();
+            reportProgress(walkProgress, false);
+        }
+        ::fts_close(fts);
+    }
+    endStage(files.size(), walkedBytes);
+    reportProgress(walkProgress, true);
+
+    // Unchanged files keep their indexed hash whether or not they are compared this time
+    for (ScannedFile &file : files) {
+        file.entry.hash = indexes[file.root].hashFor(file.path, file.entry);
+    }
+
+    // Only files sharing their size with another file need a hash. Candidates
+    // are kept as runs of one size each.
+    std::vector<int> order(files.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&files](int a, int b) {
+        return files[a].entry.size != files[b].entry.size
+            ? files[a].entry.size < files[b].entry.size : files[a].path < files[b].path;
+    });
+
+    std::vector<int> candidates;
+    std::vector<std::pair<size_t, size_t>> sizeRuns;
+    for (size_t begin = 0; begin < order.size();) {
+        size_t end = begin + 1;
+        while (end < order.size() && files[order[end]].entry.size == files[order[begin]].entry.size) {
+            ++end;
+        }
+
+        const size_t runBegin = candidates.size();
+        candidates.insert(candidates.end(), order.begin() + begin, order.begin() + end);
+        if (m_params.ignoreHardLinks) {
+            // One path per inode; the sort is stable, so the first path by name is kept
+            std::stable_sort(candidates.begin() + runBegin, candidates.end(), [&files](int a, int b) {
+                return std::tie(files[a].device, files[a].entry.inode) < std::tie(files[b].device, files[b].entry.inode);
+            });
+            candidates.erase(std::unique(candidates.begin() + runBegin, candidates.end(), [&files](int a, int b) {
+                return files[a].device == files[b].device && files[a].entry.inode == files[b].entry.inode;
+            }), candidates.end());
+        }
+
+        if (candidates.size() - runBegin < 2) {
+            candidates.resize(runBegin);
+        } else {
+            sizeRuns.emplace_back(runBegin, candidates.size());
+        }
+        begin = end;
+    }
+
+    // Only the files the index had no valid hash for are read, by the bridge
+    // on a pool with the scan's thread limits and priority. The index takes
+    // the place of czkawka's cache, so the finder never loads it.
+    for (int candidate : candidates) {
+        const ScannedFile &file = files[candidate];
+        if (!file.entry.hash.isEmpty()) {
+            ++m_cacheStats.hits;
+            m_cacheStats.bytesSaved += file.entry.size;
+        }
+    }
+    m_cacheStats.candidates = candidates.size();
 
-        if (czkawka_duplicate_finder_get_group(m_finder, i, &entries, &count)) {
-            DuplicateGroup group;
+    m_finder = czkawka_duplicate_finder_new(static_cast<CCheckingMethod>(m_params.checkMethod),
+                                            static_cast<CHashType>(m_params.hashType),
+                                            m_params.ignoreHardLinks, false, 0, 0);
+    if (!m_finder) {
+        qWarning() << "Failed to create duplicate finder";
+        return;
+    }
+    czkawka_duplicate_finder_set_progress_callback(m_finder, &ScanThread::bridgeProgress, this, ProgressIntervalMs);
+    czkawka_duplicate_finder_set_thread_limits(m_finder, quint32(qMax(m_params.cpuThreads, 0)),
+                                               quint32(qMax(m_params.ioThreads, 0)), m_params.background);
+    // stop() may have run before the finder existed
+    if (m_shouldStop) {
+        czkawka_duplicate_finder_stop(m_finder);
+    }
 
-            for (size_t j = 0; j < count; ++j) {
-                DuplicateEntry entry;
-                entry.path = QString::fromUtf8(entries[j].path);
-                entry.size = entries[j].size;
-                entry.modifiedDate = entries[j].modified_date;
-                entry.hash = QString::fromUtf8(entries[j].hash);
+    // Hashes files[selected] as one stage; jobs come back in the same order
+    auto hashFiles = [this, &files](const std::vector<int> &selected, bool prehash, int stageIndex) {
+        std::vector<QByteArray> paths;
+        paths.reserve(selected.size());
+        std::vector<CHashJob> jobs(selected.size());
+        CScanProgress stageProgress = {};
+        stageProgress.stage = prehash ? PreHashing : FullHashing;
+        stageProgress.current_stage_idx = quint8(stageIndex);
+        stageProgress.max_stage_idx = StageCount - 1;
+        stageProgress.entries_to_check = selected.size();
+        for (size_t i = 0; i < selected.size(); ++i) {
+            const ScannedFile &file = files[selected[i]];
+            paths.push_back(QFile::encodeName(file.path));
+            jobs[i].path = paths.back().constData();
+            jobs[i].size = file.entry.size;
+            stageProgress.bytes_to_check += prehash ? qMin(file.entry.size, quint64(CZKAWKA_PREHASH_SIZE)) : file.entry.size;
+        }
+
+        bridgeProgress(&stageProgress, this);
+        beginStage(static_cast<ScanStage>(stageProgress.stage));
+        czkawka_duplicate_finder_hash_files(m_finder, jobs.data(), jobs.size(), prehash, stageProgress);
 
-                group.entries.append(entry);
+        quint64 doneFiles = 0;
+        quint64 doneBytes = 0;
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            if (!jobs[i].done) {
+                continue;
+            }
+            ++doneFiles;
+            doneBytes += prehash ? qMin(jobs[i].size, quint64(CZKAWKA_PREHASH_SIZE)) : jobs[i].size;
+            if (jobs[i].hash[0] == '\0') {
+                // Unreadable now; left out of the groups and the index
+                qWarning() << "Cannot hash" << files[selected[i]].path;
             }
+        }
+        endStage(doneFiles, doneBytes);
+        m_cacheStats.bytesHashed += doneBytes;
+        return jobs;
+    };
+
+    // Stage 2: in size runs the index knows nothing about, files whose first
+    // bytes no other file of the run shares cannot have a duplicate. Smaller
+    // files are read whole in one go instead.
+    std::vector<int> fullHashing;
+    std::vector<int> prehashing;
+    std::vector<std::pair<size_t, size_t>> prehashRuns;
+    for (const auto &[runBegin, runEnd] : sizeRuns) {
+        const auto begin = candidates.begin() + runBegin;
+        const auto end = candidates.begin() + runEnd;
+        const bool allMissing = std::all_of(begin, end, [&files](int candidate) {
+            return files[candidate].entry.hash.isEmpty();
+        });
+        if (allMissing && files[*begin].entry.size > quint64(CZKAWKA_PREHASH_SIZE)) {
+            prehashRuns.emplace_back(prehashing.size(), prehashing.size() + size_t(end - begin));
+            prehashing.insert(prehashing.end(), begin, end);
+        } else {
+            std::copy_if(begin, end, std::back_inserter(fullHashing), [&files](int candidate) {
+                return files[candidate].entry.hash.isEmpty();
+            });
+        }
+    }
 
-            m_results.append(group);
+    if (!prehashing.empty() && !m_shouldStop) {
+        const std::vector<CHashJob> prehashes = hashFiles(prehashing, true, 1);
+        for (const auto &[runBegin, runEnd] : prehashRuns) {
+            QHash<QByteArray, int> prehashCounts;
+            for (size_t i = runBegin; i < runEnd; ++i) {
+                if (prehashes[i].done && prehashes[i].hash[0] != '\0') {
+                    ++prehashCounts[QByteArray(prehashes[i].hash)];
+                }
+            }
+            for (size_t i = runBegin; i < runEnd; ++i) {
+                if (!prehashes[i].done) {
+                    continue;
+                }
+                if (prehashCounts.value(QByteArray(prehashes[i].hash)) >= 2) {
+                    fullHashing.push_back(prehashing[i]);
+                } else {
+                    // Unique or unreadable: read for nothing more than this
+                    ++m_cacheStats.misses;
+                }
+            }
+        }
+    }
 
-            // Free the entries
-            czkawka_duplicate_entries_free(const_cast<CDuplicateEntry*>(entries), count);
+    // Stage 3: full hashes of the files still in question
+    if (!fullHashing.empty() && !m_shouldStop) {
+        const std::vector<CHashJob> hashes = hashFiles(fullHashing, false, 2);
+        for (size_t i = 0; i < hashes.size(); ++i) {
+            if (hashes[i].done) {
+                ++m_cacheStats.misses;
+                files[fullHashing[i]].entry.hash = QString::fromLatin1(hashes[i].hash);
+            }
         }
+    }
 
-        Q_EMIT progress(i + 1, m_groupCount);
+    // Rebuilt from this walk, so deleted files drop out. Saved even when
+    // stopped while hashing: the hashes already paid for are kept.
+    for (FileIndex &index : indexes) {
+        index.clear();
     }
+    for (const ScannedFile &file : files) {
+        if (!file.entry.hash.isEmpty()) {
+            indexes[file.root].insert(file.path, file.entry);
+        }
+    }
+    for (const FileIndex &index : indexes) {
+        if (!index.save(indexDirectory)) {
+            qWarning() << "Cannot save the file index of" << index.root();
+        }
+    }
+
+    if (m_shouldStop) {
+        return;
+    }
+
+    // Groups by size, then by hash, as czkawka orders its hash groups
+    std::vector<std::pair<size_t, size_t>> groups;
+    for (const auto &[runBegin, runEnd] : sizeRuns) {
+        std::stable_sort(candidates.begin() + runBegin, candidates.begin() + runEnd, [&files](int a, int b) {
+            return std::tie(files[a].entry.hash, files[a].path) < std::tie(files[b].entry.hash, files[b].path);
+        });
+
+        for (size_t begin = runBegin; begin < runEnd;) {
+            const QString &groupHash = files[candidates[begin]].entry.hash;
+            size_t end = begin + 1;
+            while (end < runEnd && files[candidates[end]].entry.hash == groupHash) {
+                ++end;
+            }
+            if (end - begin >= 2 && !groupHash.isEmpty()) {
+                groups.emplace_back(begin, end);
+                m_wastedSpace += files[candidates[begin]].entry.size * (end - begin - 1);
+            }
+            begin = end;
+        }
+    }
+    m_groupCount = int(groups.size());
+
+    qDebug() << "Incremental scan hashed" << m_cacheStats.misses << "of" << m_cacheStats.candidates << "files,"
+             << "found" << m_groupCount << "duplicate groups";
 
-    qDebug() << "Scan completed, processed" << m_results.size() << "groups";
+    DuplicateResults::Builder batch;
+    QElapsedTimer batchTimer;
+    batchTimer.start();
+
+    ScanProgress fetchProgress;
+    fetchProgress.stage = ScanStage::FetchingResults;
+    fetchProgress.entriesToCheck = m_groupCount;
+    beginStage(ScanStage::FetchingResults);
+    quint64 fetchedFiles = 0;
+
+    for (int i = 0; i < m_groupCount; ++i) {
+        if (m_shouldStop) {
+            return;
+        }
+
+        const auto [begin, end] = groups[i];
+        batch.beginGroup(files[candidates[begin]].entry.hash);
+        for (size_t j = begin; j < end; ++j) {
+            ScannedFile &file = files[candidates[j]];
+            batch.addEntry(std::move(file.path), file.entry.size, file.entry.modifiedDate);
+        }
+        fetchedFiles += end - begin;
+
+        if (batchIsDue(batch, batchTimer) || i + 1 == m_groupCount) {
+            Q_EMIT groupsFetched(batch.build());
+            batchTimer.restart();
+        }
+
+        fetchProgress.entriesChecked = i + 1;
+        reportProgress(fetchProgress, i + 1 == m_groupCount);
+    }
+    endStage(fetchedFiles, 0);
+    m_succeeded = !walkFailed;
 }
@@ -1,12 +1,21 @@
 #ifndef DUPLICATEFINDER_H
 #define DUPLICATEFINDER_H
 
+#include <QElapsedTimer>
+#include <QList>
 #include <QObject>
+#include <QSharedPointer>
 #include <QString>
 #include <QStringList>
 #include <QThread>
 
+#include <atomic>
+
 struct CzkawkaDuplicateFinder;
+struct CScanProgress;
+
+class DuplicateResults;
+using DuplicateResultsPtr = QSharedPointer<const DuplicateResults>;
 
 class DuplicateFinder : public QObject
 {
@@ -19,6 +28,14 @@ public:
         bool recursive;
         bool ignoreHardLinks;
         bool useCache;
+        quint64 minimalCacheFileSize = 1024 * 1024;        // Smaller files are hashed on every scan
+        quint64 minimalPrehashCacheFileSize = 1024 * 1024;
+        QString cacheDirectory;   // Empty for czkawka's default location
+        bool incremental = false; // Hash scans only: reuse hashes of unchanged files from a FileIndex
+        QString indexDirectory;   // Empty for FileIndex::defaultDirectory()
+        int cpuThreads = 0;       // Scan worker threads, 0 for one per core
+        int ioThreads = 0;        // Files read at once, 0 for as many as workers
+        bool background = false;  // Lowest CPU and I/O priority for the scan's threads
         quint64 minSize;
         quint64 maxSize;
         QStringList includePaths;
@@ -30,34 +47,117 @@ public:
         quint64 size;
         quint64 modifiedDate;
         QString hash;
+        quint64 device = 0;       // Filled in by the watcher, to tell hard links apart
+        quint64 inode = 0;
     };
 
     struct DuplicateGroup {
         QList<DuplicateEntry> entries;
     };
 
+    // Values up to Other mirror CScanStage from the bridge
+    enum class ScanStage {
+        CollectingFiles = 0,
+        ScanningName,
+        ScanningSizeName,
+        ScanningSize,
+        PreHashCacheLoading,
+        PreHashing,
+        PreHashCacheSaving,
+        FullHashCacheLoading,
+        FullHashing,
+        FullHashCacheSaving,
+        Other,
+        FetchingResults
+    };
+
+    // How much hashing the cache saved in the last scan. Misses and
+    // bytesHashed are measured; hits and bytesSaved are approximate, except
+    // for incremental scans, where every figure is counted.
+    struct CacheStats {
+        quint64 candidates = 0;   // Files that needed a full hash
+        quint64 hits = 0;
+        quint64 misses = 0;
+        quint64 bytesHashed = 0;
+        quint64 bytesSaved = 0;
+    };
+
+    // Wall time and work of one stage of the last scan
+    struct StageStatistics {
+        ScanStage stage = ScanStage::Other;
+        qint64 wallTimeUs = 0;
+        quint64 files = 0;        // Entries the stage went through
+        quint64 bytes = 0;
+
+        double filesPerSecond() const;
+        double bytesPerSecond() const;
+    };
+
+    // Where the last scan spent its time. Stages are measured by the bridge,
+    // or by ScanThread for incremental scans and result fetching, and listed
+    // in the order they ran.
+    struct ScanStatistics {
+        QList<StageStatistics> stages;
+        qint64 totalTimeUs = 0;      // From startScan() to resultsReady()
+        qint64 receiverTimeUs = 0;   // Spent in groupsAvailable() receivers, such as the model
+        int groupCount = 0;
+        quint64 wastedSpace = 0;
+        CacheStats cache;
+    };
+
+    struct ScanProgress {
+        ScanStage stage = ScanStage::Other;
+        int stageIndex = 0;       // 0-based, valid when stageCount > 0
+        int stageCount = 0;
+        quint64 entriesChecked = 0;
+        quint64 entriesToCheck = 0;
+        quint64 bytesChecked = 0;
+        quint64 bytesToCheck = 0;
+    };
+
     explicit DuplicateFinder(QObject *parent = nullptr);
     ~DuplicateFinder();
 
+    // czkawka keeps the cache directory of the first scan that loads the
+    // cache; a different params.cacheDirectory later on is ignored
     void startScan(const ScanParameters &params);
+    // True once that directory is fixed for the rest of the process
+    static bool isCacheDirectoryFixed();
     void stopScan();
 
-    QList<DuplicateGroup> getResults() const;
+    // Consumers that only stream groupsAvailable() can drop the batches;
+    // getResults() then stays empty
+    void setKeepResults(bool keep);
+
+    // Result batches in scan order; shared, never copied
+    const QList<DuplicateResultsPtr> &getResults() const;
     int getGroupCount() const;
     quint64 getWastedSpace() const;
+    CacheStats getCacheStats() const;
+    ScanStatistics getScanStatistics() const;
+
+    // Short, stable name of a stage for logs and machine-readable output
+    static QString stageName(ScanStage stage);
 
 Q_SIGNALS:
     void scanStarted();
-    void scanProgress(int current, int total);
+    void scanProgress(const DuplicateFinder::ScanProgress &progress);
     void scanFinished(bool success);
-    void resultsReady(int groupCount, quint64 wastedSpace);
+    // Emitted in batches while results are fetched, before resultsReady
+    void groupsAvailable(const DuplicateResultsPtr &groups);
+    void resultsReady(int groupCount, quint64 wastedSpace, const DuplicateFinder::ScanStatistics &statistics);
 
 private:
     class ScanThread;
     ScanThread *m_scanThread;
-    QList<DuplicateGroup> m_results;
+    QList<DuplicateResultsPtr> m_results;
     int m_groupCount;
     quint64 m_wastedSpace;
+    CacheStats m_cacheStats;
+    ScanStatistics m_statistics;
+    QElapsedTimer m_scanTimer;
+    qint64 m_receiverTimeUs;
+    bool m_keepResults;
 };
 
 // Worker thread for scanning
@@ -70,23 +170,38 @@ public:
     ~ScanThread();
 
     void stop();
-    QList<DuplicateFinder::DuplicateGroup> getResults() const;
+    // False when the scan failed or was stopped before its results were complete
+    bool succeeded() const;
     int getGroupCount() const;
     quint64 getWastedSpace() const;
+    DuplicateFinder::CacheStats getCacheStats() const;
+    // Stages of the finished run; the totals are filled in by DuplicateFinder
+    DuplicateFinder::ScanStatistics getStatistics() const;
 
 Q_SIGNALS:
-    void progress(int current, int total);
+    void progress(const DuplicateFinder::ScanProgress &progress);
+    void groupsFetched(const DuplicateResultsPtr &groups);
 
 protected:
     void run() override;
 
 private:
+    static void bridgeProgress(const CScanProgress *progress, void *userData);
+    // Walks and hashes without czkawka, reading only files the index cannot vouch for
+    void runIncremental();
+    // Time a stage this thread runs itself, as the bridge does for its own
+    void beginStage(ScanStage stage);
+    void endStage(quint64 files, quint64 bytes);
+
     DuplicateFinder::ScanParameters m_params;
     CzkawkaDuplicateFinder *m_finder;
-    QList<DuplicateFinder::DuplicateGroup> m_results;
     int m_groupCount;
     quint64 m_wastedSpace;
-    bool m_shouldStop;
+    DuplicateFinder::CacheStats m_cacheStats;
+    DuplicateFinder::ScanStatistics m_statistics;
+    QElapsedTimer m_stageTimer;
+    bool m_succeeded;
+    std::atomic<bool> m_shouldStop; // Set by stop() from another thread
 };
 
 #endif // DUPLICATEFINDER_H
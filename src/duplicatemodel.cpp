@@ -1,95 +1,668 @@
 #include "duplicatemodel.h"
-#include <QFileInfo>
+#include "trace.h"
 #include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QRegularExpression>
 #include <QIcon>
 #include <QFont>
+#include <QThread>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <sys/stat.h>
+#include <utility>
+
+namespace {
+
+// Below this many items a plain single-threaded sort is faster than fanning out
+constexpr qsizetype ParallelSortThreshold = 50000;
+
+// Stable sort that splits large ranges into one run per core, sorts the runs
+// on the global thread pool and merges neighbouring runs pairwise
+template<typename Less>
+void parallelStableSort(int *begin, int *end, Less less)
+{
+    const qsizetype count = end - begin;
+    if (count < ParallelSortThreshold) {
+        std::stable_sort(begin, end, less);
+        return;
+    }
+
+    const qsizetype runCount = qMax(2, QThread::idealThreadCount());
+    const qsizetype runSize = (count + runCount - 1) / runCount;
+
+    QList<std::pair<qsizetype, qsizetype>> runs;
+    for (qsizetype first = 0; first < count; first += runSize) {
+        runs.append({first, qMin(first + runSize, count)});
+    }
+
+    QtConcurrent::blockingMap(runs, [&](const std::pair<qsizetype, qsizetype> &run) {
+        std::stable_sort(begin + run.first, begin + run.second, less);
+    });
+
+    while (runs.size() > 1) {
+        // {first, middle, last} of each pair of neighbouring runs
+        QList<std::array<qsizetype, 3>> merges;
+        QList<std::pair<qsizetype, qsizetype>> merged;
+        for (qsizetype i = 0; i + 1 < runs.size(); i += 2) {
+            merges.append({runs[i].first, runs[i].second, runs[i + 1].second});
+            merged.append({runs[i].first, runs[i + 1].second});
+        }
+        if (runs.size() % 2) {
+            merged.append(runs.last());
+        }
+
+        QtConcurrent::blockingMap(merges, [&](const std::array<qsizetype, 3> &merge) {
+            std::inplace_merge(begin + merge[0], begin + merge[1], begin + merge[2], less);
+        });
+        runs = merged;
+    }
+}
+
+// Orders indices by a cheap or precomputed key in the requested direction
+template<typename Key>
+auto keyLess(Qt::SortOrder order, Key key)
+{
+    return [order, key](int a, int b) {
+        return order == Qt::AscendingOrder ? key(a) < key(b) : key(b) < key(a);
+    };
+}
+
+// True if path is directory itself or lies below it
+bool isInside(const QString &path, const QString &directory)
+{
+    if (!path.startsWith(directory)) {
+        return false;
+    }
+    return path.size() == directory.size() || directory.endsWith(QLatin1Char('/'))
+        || path.at(directory.size()) == QLatin1Char('/');
+}
+
+using FileId = std::pair<quint64, quint64>; // Device and inode
+
+// {0, 0} if path cannot be read
+FileId fileId(const QString &path)
+{
+    struct stat fileStat;
+    if (::lstat(QFile::encodeName(path).constData(), &fileStat) != 0) {
+        return {0, 0};
+    }
+    return {quint64(fileStat.st_dev), quint64(fileStat.st_ino)};
+}
+
+// Directory part of a path, as DuplicateResults::Builder interns it
+QString parentDirectory(const QString &path)
+{
+    const qsizetype slash = path.lastIndexOf(QLatin1Char('/'));
+    return path.left(slash == 0 ? 1 : qMax<qsizetype>(slash, 0));
+}
+
+} // namespace
 
 DuplicateModel::DuplicateModel(QObject *parent)
     : QAbstractItemModel(parent)
 {
 }
 
-void DuplicateModel::setResults(const QList<DuplicateFinder::DuplicateGroup> &results)
+void DuplicateModel::setResults(const DuplicateResultsPtr &results)
 {
+    Trace::Span span("DuplicateModel::setResults");
     beginResetModel();
 
-    m_groups = results;
-    m_items.clear();
+    m_batches.clear();
+    m_groups.clear();
+    m_order.clear();
+    m_fileOrder.clear();
+    m_checked.clear();
+    m_checkedBytes = 0;
+    m_totalBytes = 0;
+    m_selectedFilesValid = false;
+    appendBatch(results);
+    sortGroups(m_sortColumn, m_sortOrder);
+    sortFiles(m_sortColumn, m_sortOrder);
+    m_fetchedGroups = qMin<int>(m_groups.size(), FetchBatchSize);
+
+    endResetModel();
+    Q_EMIT selectionChanged();
+}
 
-    for (int groupIdx = 0; groupIdx < m_groups.size(); ++groupIdx) {
-        const auto &group = m_groups[groupIdx];
-        QList<FileItem> groupItems;
+void DuplicateModel::appendGroups(const DuplicateResultsPtr &groups)
+{
+    Trace::Span span("DuplicateModel::appendGroups");
+    if (!groups || groups->groupCount() == 0) {
+        return;
+    }
+
+    // New groups go after the existing rows until the next sort().
+    // Rows past the first page stay hidden until a view asks for them.
+    appendBatch(groups);
+    const int visible = qMin<int>(m_groups.size(), qMax(m_fetchedGroups, FetchBatchSize));
+    if (visible > m_fetchedGroups) {
+        beginInsertRows(QModelIndex(), m_fetchedGroups, visible - 1);
+        m_fetchedGroups = visible;
+        endInsertRows();
+    }
+}
+
+void DuplicateModel::appendBatch(const DuplicateResultsPtr &groups)
+{
+    if (!groups) {
+        return;
+    }
 
-        for (const auto &entry : group.entries) {
-            QFileInfo fileInfo(entry.path);
+    const int batch = m_batches.size();
+    const int firstEntry = int(m_checked.size());
+    m_batches.append(groups);
 
-            FileItem item;
-            item.path = entry.path;
-            item.fileName = fileInfo.fileName();
-            item.directory = fileInfo.absolutePath();
-            item.size = entry.size;
-            item.modifiedDate = entry.modifiedDate;
-            item.hash = entry.hash;
-            item.checked = false;
-            item.groupIndex = groupIdx;
+    m_groups.reserve(m_groups.size() + groups->groupCount());
+    m_order.reserve(m_order.size() + groups->groupCount());
+    for (int i = 0; i < groups->groupCount(); ++i) {
+        m_order.append(m_groups.size());
+        m_groups.append({batch, i, firstEntry + groups->groupBegin(i)});
+    }
 
-            groupItems.append(item);
+    if (!m_fileOrder.isEmpty()) {
+        m_fileOrder.reserve(firstEntry + groups->entryCount());
+        for (int i = 0; i < groups->groupCount(); ++i) {
+            for (int file = 0; file < groups->groupSize(i); ++file) {
+                m_fileOrder.append(file);
+            }
         }
+    }
 
-        m_items.append(groupItems);
+    m_checked.grow(groups->entryCount());
+    for (int entry = 0; entry < groups->entryCount(); ++entry) {
+        m_totalBytes += groups->size(entry);
     }
+}
 
-    endResetModel();
+int DuplicateModel::groupSize(int groupIdx) const
+{
+    const GroupRef &ref = m_groups[groupIdx];
+    return m_batches[ref.batch]->groupSize(ref.group);
+}
+
+quint64 DuplicateModel::groupWastedSpace(int groupIdx) const
+{
+    // Everything except one kept copy of the largest file
+    const GroupRef &ref = m_groups[groupIdx];
+    const DuplicateResults &batch = *m_batches[ref.batch];
+    const int begin = batch.groupBegin(ref.group);
+    quint64 total = 0;
+    quint64 largest = 0;
+    for (int entry = begin; entry < begin + batch.groupSize(ref.group); ++entry) {
+        total += batch.size(entry);
+        largest = qMax(largest, batch.size(entry));
+    }
+    return total - largest;
+}
+
+int DuplicateModel::fileOffset(int groupIdx, int fileRow) const
+{
+    return m_fileOrder.isEmpty() ? fileRow : m_fileOrder[m_groups[groupIdx].firstEntry + fileRow];
 }
 
 void DuplicateModel::clear()
 {
     beginResetModel();
+    m_batches.clear();
     m_groups.clear();
-    m_items.clear();
+    m_order.clear();
+    m_fileOrder.clear();
+    m_checked.clear();
+    m_checkedBytes = 0;
+    m_totalBytes = 0;
+    m_selectedFilesValid = false;
+    m_fetchedGroups = 0;
     endResetModel();
+    Q_EMIT selectionChanged();
 }
 
-void DuplicateModel::selectAll()
+void DuplicateModel::updateFiles(const QStringList &changedPaths, const QList<DuplicateFinder::DuplicateEntry> &current,
+                                 bool ignoreHardLinks)
 {
-    for (auto &groupItems : m_items) {
-        for (auto &item : groupItems) {
-            item.checked = true;
+    Trace::Span span("DuplicateModel::updateFiles");
+
+    // Files leaving their groups; the parents let most files be ruled out
+    // without building their path
+    QSet<QString> dropped;
+    QSet<QString> droppedParents;
+    QStringList droppedDirectories;
+    auto drop = [&](const QString &path) {
+        dropped.insert(path);
+        droppedParents.insert(parentDirectory(path));
+    };
+    for (const QString &path : changedPaths) {
+        if (path.endsWith(QLatin1Char('/'))) {
+            droppedDirectories.append(path.chopped(1));
+        } else {
+            drop(path);
+        }
+    }
+
+    // Files (re)joining a group, by size and hash
+    using GroupKey = std::pair<quint64, QString>;
+    QHash<GroupKey, QList<int>> arrivals;
+    for (int i = 0; i < current.size(); ++i) {
+        drop(current[i].path);
+        if (!current[i].hash.isEmpty()) {
+            arrivals[{current[i].size, current[i].hash}].append(i);
+        }
+    }
+
+    // Leaves out members that share their inode with a file in inodes or an
+    // earlier member; entries without an inode are always kept
+    auto dropLinks = [&current](QList<int> &members, QSet<FileId> &inodes) {
+        members.removeIf([&](int i) {
+            const FileId id{current[i].device, current[i].inode};
+            if (id.second == 0) {
+                return false;
+            }
+            if (inodes.contains(id)) {
+                return true;
+            }
+            inodes.insert(id);
+            return false;
+        });
+    };
+
+    auto isDropped = [&](const DuplicateResults &batch, int entry) {
+        const QString directory = batch.directory(entry);
+        for (const QString &removed : std::as_const(droppedDirectories)) {
+            if (isInside(directory, removed)) {
+                return true;
+            }
+        }
+        return droppedParents.contains(directory) && dropped.contains(batch.path(entry));
+    };
+
+    // Untouched groups stay in their batch; changed groups are copied into a
+    // new one, since batches are immutable
+    DuplicateResults::Builder builder;
+    const int newBatch = m_batches.size();
+    QList<GroupRef> groups;
+    groups.reserve(m_groups.size());
+    QList<int> groupMap(m_groups.size(), -1); // Old group index -> new, -1 once gone
+    QList<qsizetype> slotMap(m_checked.size(), -1); // Old file slot -> new
+    SelectionSet checked;
+    quint64 checkedBytes = 0;
+    quint64 totalBytes = 0;
+    bool changed = false;
+
+    for (int groupIdx = 0; groupIdx < m_groups.size(); ++groupIdx) {
+        const GroupRef &ref = m_groups[groupIdx];
+        const DuplicateResults &batch = *m_batches[ref.batch];
+        const int begin = batch.groupBegin(ref.group);
+        const int size = batch.groupSize(ref.group);
+        const QString hash = batch.groupHash(ref.group);
+
+        QList<int> kept;
+        kept.reserve(size);
+        for (int file = 0; file < size; ++file) {
+            if (!isDropped(batch, begin + file)) {
+                kept.append(file);
+            }
+        }
+
+        QList<int> joining;
+        if (size > 0 && !hash.isEmpty()) {
+            joining = arrivals.take({batch.size(begin), hash});
+        }
+        if (ignoreHardLinks && !joining.isEmpty()) {
+            // A link to a file that stays in the group must not rejoin it
+            QSet<FileId> inodes;
+            for (int file : std::as_const(kept)) {
+                inodes.insert(fileId(batch.path(begin + file)));
+            }
+            dropLinks(joining, inodes);
+        }
+
+        const bool untouched = kept.size() == size && joining.isEmpty();
+        changed = changed || !untouched;
+        if (kept.size() + joining.size() < 2) {
+            continue;
+        }
+
+        const qsizetype firstEntry = checked.size();
+        checked.grow(kept.size() + joining.size());
+        groupMap[groupIdx] = groups.size();
+        if (untouched) {
+            groups.append({ref.batch, ref.group, int(firstEntry)});
+        } else {
+            builder.beginGroup(hash);
+            groups.append({newBatch, builder.groupCount() - 1, int(firstEntry)});
+        }
+
+        for (int i = 0; i < kept.size(); ++i) {
+            const int entry = begin + kept[i];
+            const qsizetype oldSlot = ref.firstEntry + kept[i];
+            slotMap[oldSlot] = firstEntry + i;
+            totalBytes += batch.size(entry);
+            if (m_checked.test(oldSlot)) {
+                checked.set(firstEntry + i, true);
+                checkedBytes += batch.size(entry);
+            }
+            if (!untouched) {
+                builder.addEntry(batch.path(entry), batch.size(entry), batch.modifiedDate(entry));
+            }
+        }
+        // Files that changed start out unchecked
+        for (int i : std::as_const(joining)) {
+            builder.addEntry(current[i].path, current[i].size, current[i].modifiedDate);
+            totalBytes += current[i].size;
         }
     }
-    Q_EMIT dataChanged(index(0, 0), index(rowCount() - 1, 0));
+
+    // Arrivals that matched no group form new ones, in the order they came
+    const int firstNewGroup = groups.size();
+    for (const DuplicateFinder::DuplicateEntry &entry : current) {
+        QList<int> members = arrivals.take({entry.size, entry.hash});
+        if (ignoreHardLinks) {
+            QSet<FileId> inodes;
+            dropLinks(members, inodes);
+        }
+        if (members.size() < 2) {
+            continue;
+        }
+        changed = true;
+        builder.beginGroup(entry.hash);
+        groups.append({newBatch, builder.groupCount() - 1, int(checked.size())});
+        checked.grow(members.size());
+        for (int i : members) {
+            builder.addEntry(current[i].path, current[i].size, current[i].modifiedDate);
+            totalBytes += current[i].size;
+        }
+    }
+
+    if (!changed) {
+        return;
+    }
+
+    Q_EMIT layoutAboutToBeChanged();
+
+    const QModelIndexList oldIndexes = persistentIndexList();
+    QList<std::pair<int, int>> targets; // New group index or -1, file offset or -1 for a group row
+    targets.reserve(oldIndexes.size());
+    for (const QModelIndex &idx : oldIndexes) {
+        const quintptr id = idx.internalId();
+        const int groupIdx = m_order[id >> 32];
+        const int fileRow = int(id & 0xFFFFFFFF) - 1;
+        const int newGroup = groupMap[groupIdx];
+        if (fileRow < 0 || newGroup < 0) {
+            targets.append({newGroup, -1});
+            continue;
+        }
+        const qsizetype slot = slotMap[m_groups[groupIdx].firstEntry + fileOffset(groupIdx, fileRow)];
+        if (slot < 0) {
+            targets.append({-1, -1});
+        } else {
+            targets.append({newGroup, int(slot - groups[newGroup].firstEntry)});
+        }
+    }
+
+    // Rows keep their order, new groups go last until the next sort()
+    QList<int> order;
+    order.reserve(groups.size());
+    int fetched = 0;
+    for (int row = 0; row < m_order.size(); ++row) {
+        const int groupIdx = groupMap[m_order[row]];
+        if (groupIdx >= 0) {
+            order.append(groupIdx);
+            fetched += row < m_fetchedGroups;
+        }
+    }
+    for (int groupIdx = firstNewGroup; groupIdx < groups.size(); ++groupIdx) {
+        order.append(groupIdx);
+    }
+
+    // Drop batches no group refers to any more
+    if (builder.groupCount() > 0) {
+        m_batches.append(builder.build());
+    }
+    QList<int> batchMap(m_batches.size(), -1);
+    QList<DuplicateResultsPtr> batches;
+    for (GroupRef &ref : groups) {
+        if (batchMap[ref.batch] < 0) {
+            batchMap[ref.batch] = batches.size();
+            batches.append(m_batches[ref.batch]);
+        }
+        ref.batch = batchMap[ref.batch];
+    }
+
+    m_batches = batches;
+    m_groups = groups;
+    m_order = order;
+    m_checked = checked;
+    m_checkedBytes = checkedBytes;
+    m_totalBytes = totalBytes;
+    m_selectedFilesValid = false;
+    m_fetchedGroups = qMin<int>(m_groups.size(), qMax(fetched, FetchBatchSize));
+    m_fileOrder.clear();
+    sortFiles(m_sortColumn, m_sortOrder);
+
+    changePersistentIndexList(oldIndexes, relocatedIndexes(oldIndexes, targets));
+
+    Q_EMIT layoutChanged();
+    Q_EMIT selectionChanged();
 }
 
-void DuplicateModel::selectNone()
+void DuplicateModel::removeFiles(const QStringList &paths)
+{
+    updateFiles(paths, {});
+}
+
+int DuplicateModel::groupCount() const
+{
+    return m_groups.size();
+}
+
+QSet<quint64> DuplicateModel::groupSizes() const
 {
-    for (auto &groupItems : m_items) {
-        for (auto &item : groupItems) {
-            item.checked = false;
+    QSet<quint64> sizes;
+    for (const GroupRef &ref : m_groups) {
+        const DuplicateResults &batch = *m_batches[ref.batch];
+        if (batch.groupSize(ref.group) > 0) {
+            sizes.insert(batch.size(batch.groupBegin(ref.group)));
         }
     }
-    Q_EMIT dataChanged(index(0, 0), index(rowCount() - 1, 0));
+    return sizes;
+}
+
+quint64 DuplicateModel::wastedSpace() const
+{
+    quint64 total = 0;
+    for (int groupIdx = 0; groupIdx < m_groups.size(); ++groupIdx) {
+        total += groupWastedSpace(groupIdx);
+    }
+    return total;
+}
+
+const DuplicateResults &DuplicateModel::batchOf(int groupIdx) const
+{
+    return *m_batches[m_groups[groupIdx].batch];
+}
+
+int DuplicateModel::batchGroup(int groupIdx) const
+{
+    return m_groups[groupIdx].group;
+}
+
+bool DuplicateModel::isChecked(int groupIdx, int fileIdx) const
+{
+    return m_checked.test(m_groups[groupIdx].firstEntry + fileIdx);
+}
+
+void DuplicateModel::selectAll()
+{
+    m_checked.setAll(true);
+    m_checkedBytes = m_totalBytes;
+    checkStatesChanged();
+}
+
+void DuplicateModel::selectNone()
+{
+    m_checked.setAll(false);
+    m_checkedBytes = 0;
+    checkStatesChanged();
 }
 
 void DuplicateModel::invertSelection()
 {
-    for (auto &groupItems : m_items) {
-        for (auto &item : groupItems) {
-            item.checked = !item.checked;
+    m_checked.invert();
+    m_checkedBytes = m_totalBytes - m_checkedBytes;
+    checkStatesChanged();
+}
+
+void DuplicateModel::checkStatesChanged()
+{
+    m_selectedFilesValid = false;
+
+    // Check boxes live on file rows, so notify each fetched group's children
+    for (int groupRow = 0; groupRow < m_fetchedGroups; ++groupRow) {
+        const int size = groupSize(m_order[groupRow]);
+        if (size > 0) {
+            const QModelIndex group = index(groupRow, 0);
+            Q_EMIT dataChanged(index(0, 0, group), index(size - 1, 0, group), {Qt::CheckStateRole});
+        }
+    }
+
+    Q_EMIT selectionChanged();
+}
+
+bool DuplicateModel::autoSelect(KeepRule rule, const QString &argument)
+{
+    QRegularExpression pattern;
+    QString prefix;
+    if (rule == KeepRule::MatchingPattern) {
+        pattern.setPattern(argument);
+        if (argument.isEmpty() || !pattern.isValid()) {
+            return false;
+        }
+        pattern.optimize();
+    } else if (rule == KeepRule::InDirectory) {
+        if (argument.isEmpty()) {
+            return false;
+        }
+        prefix = QDir::cleanPath(argument);
+        if (!prefix.endsWith(QLatin1Char('/'))) {
+            prefix += QLatin1Char('/');
+        }
+    }
+    const QStringView prefixDir = QStringView(prefix).chopped(prefix.isEmpty() ? 0 : 1);
+
+    // Returns the offset of the file to keep in a group, or -1 for none
+    auto keptFile = [&](int groupIdx) -> int {
+        const GroupRef &ref = m_groups[groupIdx];
+        const DuplicateResults &batch = *m_batches[ref.batch];
+        const int begin = batch.groupBegin(ref.group);
+        const int size = batch.groupSize(ref.group);
+        if (size == 0) {
+            return -1;
+        }
+
+        int best = 0;
+        switch (rule) {
+        case KeepRule::Newest:
+            for (int file = 1; file < size; ++file) {
+                if (batch.modifiedDate(begin + file) > batch.modifiedDate(begin + best)) {
+                    best = file;
+                }
+            }
+            return best;
+        case KeepRule::Oldest:
+            for (int file = 1; file < size; ++file) {
+                if (batch.modifiedDate(begin + file) < batch.modifiedDate(begin + best)) {
+                    best = file;
+                }
+            }
+            return best;
+        case KeepRule::ShortestPath:
+            for (int file = 1; file < size; ++file) {
+                if (batch.pathLength(begin + file) < batch.pathLength(begin + best)) {
+                    best = file;
+                }
+            }
+            return best;
+        case KeepRule::InDirectory:
+            for (int file = 0; file < size; ++file) {
+                const QString directory = batch.directory(begin + file);
+                if (directory.startsWith(prefix) || directory == prefixDir) {
+                    return file;
+                }
+            }
+            return -1;
+        case KeepRule::MatchingPattern:
+            for (int file = 0; file < size; ++file) {
+                if (pattern.match(batch.path(begin + file)).hasMatch()) {
+                    return file;
+                }
+            }
+            return -1;
+        }
+        return -1;
+    };
+
+    // Pick the kept file of every group in parallel; each slot starts out as
+    // its group index and is overwritten with the kept offset
+    QList<int> kept(m_groups.size());
+    std::iota(kept.begin(), kept.end(), 0);
+    QtConcurrent::blockingMap(kept, [&](int &slot) {
+        slot = keptFile(slot);
+    });
+
+    // Check everything, then clear the kept files and groups without one
+    m_checked.setAll(true);
+    m_checkedBytes = m_totalBytes;
+    for (int groupIdx = 0; groupIdx < m_groups.size(); ++groupIdx) {
+        const GroupRef &ref = m_groups[groupIdx];
+        const DuplicateResults &batch = *m_batches[ref.batch];
+        const int begin = batch.groupBegin(ref.group);
+        const int first = kept[groupIdx] < 0 ? 0 : kept[groupIdx];
+        const int last = kept[groupIdx] < 0 ? batch.groupSize(ref.group) : kept[groupIdx] + 1;
+        for (int file = first; file < last; ++file) {
+            m_checked.set(ref.firstEntry + file, false);
+            m_checkedBytes -= batch.size(begin + file);
         }
     }
-    Q_EMIT dataChanged(index(0, 0), index(rowCount() - 1, 0));
+
+    checkStatesChanged();
+    return true;
+}
+
+qsizetype DuplicateModel::selectedCount() const
+{
+    return m_checked.count();
+}
+
+quint64 DuplicateModel::selectedSize() const
+{
+    return m_checkedBytes;
 }
 
 QList<QString> DuplicateModel::getSelectedFiles() const
 {
+    if (m_selectedFilesValid) {
+        return m_selectedFiles;
+    }
+
     QList<QString> selectedFiles;
-    for (const auto &groupItems : m_items) {
-        for (const auto &item : groupItems) {
-            if (item.checked) {
-                selectedFiles.append(item.path);
+    selectedFiles.reserve(m_checked.count());
+    for (const GroupRef &ref : m_groups) {
+        const DuplicateResults &batch = *m_batches[ref.batch];
+        const int begin = batch.groupBegin(ref.group);
+        const int size = batch.groupSize(ref.group);
+        for (int fileIdx = 0; fileIdx < size; ++fileIdx) {
+            if (m_checked.test(ref.firstEntry + fileIdx)) {
+                selectedFiles.append(batch.path(begin + fileIdx));
             }
         }
     }
+
+    m_selectedFiles = selectedFiles;
+    m_selectedFilesValid = true;
     return selectedFiles;
 }
 
@@ -101,15 +674,15 @@ QModelIndex DuplicateModel::index(int row, int column, const QModelIndex &parent
 
     if (!parent.isValid()) {
         // Top-level item (group header)
-        if (row >= 0 && row < m_items.size()) {
+        if (row >= 0 && row < m_fetchedGroups) {
             return createIndex(row, column, quintptr(row) << 32);
         }
     } else {
         // Child item (file in group)
-        int groupIdx = parent.row();
-        if (groupIdx >= 0 && groupIdx < m_items.size()) {
-            if (row >= 0 && row < m_items[groupIdx].size()) {
-                return createIndex(row, column, (quintptr(groupIdx) << 32) | (row + 1));
+        int groupRow = parent.row();
+        if (groupRow >= 0 && groupRow < m_fetchedGroups) {
+            if (row >= 0 && row < groupSize(m_order[groupRow])) {
+                return createIndex(row, column, (quintptr(groupRow) << 32) | (row + 1));
             }
         }
     }
@@ -131,25 +704,25 @@ QModelIndex DuplicateModel::parent(const QModelIndex &child) const
         return QModelIndex();
     } else {
         // Child item, return group header as parent
-        int groupIdx = id >> 32;
-        return createIndex(groupIdx, 0, quintptr(groupIdx) << 32);
+        int groupRow = id >> 32;
+        return createIndex(groupRow, 0, quintptr(groupRow) << 32);
     }
 }
 
 int DuplicateModel::rowCount(const QModelIndex &parent) const
 {
     if (!parent.isValid()) {
-        // Root level: return number of groups
-        return m_items.size();
+        // Root level: return number of groups fetched so far
+        return m_fetchedGroups;
     } else {
         quintptr id = parent.internalId();
         int childRow = id & 0xFFFFFFFF;
 
         if (childRow == 0) {
             // Group header: return number of files in this group
-            int groupIdx = id >> 32;
-            if (groupIdx >= 0 && groupIdx < m_items.size()) {
-                return m_items[groupIdx].size();
+            int groupRow = id >> 32;
+            if (groupRow >= 0 && groupRow < m_fetchedGroups) {
+                return groupSize(m_order[groupRow]);
             }
         }
     }
@@ -173,13 +746,19 @@ QVariant DuplicateModel::data(const QModelIndex &index, int role) const
     int childRow = id & 0xFFFFFFFF;
 
     if (childRow == 0) {
-        // Group header
-        int groupIdx = id >> 32;
-        if (groupIdx >= 0 && groupIdx < m_items.size()) {
+        // Group header; groups keep their scan number when sorted
+        int groupRow = id >> 32;
+        if (groupRow >= 0 && groupRow < m_fetchedGroups) {
+            const int groupIdx = m_order[groupRow];
             if (role == Qt::DisplayRole && index.column() == 1) {
                 return QStringLiteral("Group %1 (%2 files)")
                     .arg(groupIdx + 1)
-                    .arg(m_items[groupIdx].size());
+                    .arg(groupSize(groupIdx));
+            } else if (role == Qt::DisplayRole && index.column() == 2) {
+                return tr("%1 wasted").arg(formatSize(groupWastedSpace(groupIdx)));
+            } else if (role == Qt::DisplayRole && index.column() == 4) {
+                const GroupRef &ref = m_groups[groupIdx];
+                return m_batches[ref.batch]->groupHash(ref.group);
             } else if (role == Qt::FontRole) {
                 QFont font;
                 font.setBold(true);
@@ -190,27 +769,32 @@ QVariant DuplicateModel::data(const QModelIndex &index, int role) const
         }
     } else {
         // File item
-        int groupIdx = id >> 32;
-        int fileIdx = childRow - 1;
+        int groupRow = id >> 32;
+        int fileRow = childRow - 1;
 
-        if (groupIdx >= 0 && groupIdx < m_items.size() &&
-            fileIdx >= 0 && fileIdx < m_items[groupIdx].size()) {
+        if (groupRow >= 0 && groupRow < m_fetchedGroups &&
+            fileRow >= 0 && fileRow < groupSize(m_order[groupRow])) {
 
-            const FileItem &item = m_items[groupIdx][fileIdx];
+            // Names and paths are derived from the columnar batch on demand
+            const int groupIdx = m_order[groupRow];
+            const int fileIdx = fileOffset(groupIdx, fileRow);
+            const GroupRef &ref = m_groups[groupIdx];
+            const DuplicateResults &batch = *m_batches[ref.batch];
+            const int entry = batch.groupBegin(ref.group) + fileIdx;
 
             if (role == Qt::DisplayRole) {
                 switch (index.column()) {
                 case 0: return QString(); // Checkbox column
-                case 1: return item.fileName;
-                case 2: return formatSize(item.size);
-                case 3: return formatDate(item.modifiedDate);
-                case 4: return item.directory;
+                case 1: return batch.fileName(entry);
+                case 2: return formatSize(batch.size(entry));
+                case 3: return formatDate(batch.modifiedDate(entry));
+                case 4: return batch.directory(entry);
                 default: return QVariant();
                 }
             } else if (role == Qt::CheckStateRole && index.column() == 0) {
-                return item.checked ? Qt::Checked : Qt::Unchecked;
+                return m_checked.test(ref.firstEntry + fileIdx) ? Qt::Checked : Qt::Unchecked;
             } else if (role == Qt::ToolTipRole) {
-                return item.path;
+                return batch.path(entry);
             }
         }
     }
@@ -266,14 +850,24 @@ bool DuplicateModel::setData(const QModelIndex &index, const QVariant &value, in
     int childRow = id & 0xFFFFFFFF;
 
     if (childRow > 0) {
-        int groupIdx = id >> 32;
-        int fileIdx = childRow - 1;
+        int groupRow = id >> 32;
+        int fileRow = childRow - 1;
 
-        if (groupIdx >= 0 && groupIdx < m_items.size() &&
-            fileIdx >= 0 && fileIdx < m_items[groupIdx].size()) {
+        if (groupRow >= 0 && groupRow < m_fetchedGroups &&
+            fileRow >= 0 && fileRow < groupSize(m_order[groupRow])) {
 
-            m_items[groupIdx][fileIdx].checked = (value.toInt() == Qt::Checked);
-            Q_EMIT dataChanged(index, index);
+            const int groupIdx = m_order[groupRow];
+            const int fileIdx = fileOffset(groupIdx, fileRow);
+            const GroupRef &ref = m_groups[groupIdx];
+            const bool checked = value.toInt() == Qt::Checked;
+
+            if (m_checked.set(ref.firstEntry + fileIdx, checked)) {
+                const quint64 size = m_batches[ref.batch]->size(m_batches[ref.batch]->groupBegin(ref.group) + fileIdx);
+                m_checkedBytes = checked ? m_checkedBytes + size : m_checkedBytes - size;
+                m_selectedFilesValid = false;
+                Q_EMIT dataChanged(index, index, {Qt::CheckStateRole});
+                Q_EMIT selectionChanged();
+            }
             return true;
         }
     }
@@ -281,6 +875,180 @@ bool DuplicateModel::setData(const QModelIndex &index, const QVariant &value, in
     return false;
 }
 
+bool DuplicateModel::hasChildren(const QModelIndex &parent) const
+{
+    if (!parent.isValid()) {
+        return m_fetchedGroups > 0;
+    }
+
+    // O(1) from the group offsets, so collapsed groups never build their rows
+    const quintptr id = parent.internalId();
+    return (id & 0xFFFFFFFF) == 0 && groupSize(m_order[id >> 32]) > 0;
+}
+
+bool DuplicateModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && m_fetchedGroups < m_groups.size();
+}
+
+void DuplicateModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent)) {
+        return;
+    }
+
+    const int count = qMin<int>(m_groups.size() - m_fetchedGroups, FetchBatchSize);
+    beginInsertRows(QModelIndex(), m_fetchedGroups, m_fetchedGroups + count - 1);
+    m_fetchedGroups += count;
+    endInsertRows();
+}
+
+void DuplicateModel::sort(int column, Qt::SortOrder order)
+{
+    Trace::Span span("DuplicateModel::sort");
+    Q_EMIT layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+
+    // Remember which group and file each persistent index refers to
+    const QModelIndexList oldIndexes = persistentIndexList();
+    QList<std::pair<int, int>> targets; // Group index, file offset or -1 for a group row
+    targets.reserve(oldIndexes.size());
+    for (const QModelIndex &idx : oldIndexes) {
+        const quintptr id = idx.internalId();
+        const int groupIdx = m_order[id >> 32];
+        const int fileRow = int(id & 0xFFFFFFFF) - 1;
+        targets.append({groupIdx, fileRow < 0 ? -1 : fileOffset(groupIdx, fileRow)});
+    }
+
+    m_sortColumn = column;
+    m_sortOrder = order;
+    sortGroups(column, order);
+    sortFiles(column, order);
+
+    changePersistentIndexList(oldIndexes, relocatedIndexes(oldIndexes, targets));
+
+    Q_EMIT layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+}
+
+QModelIndexList DuplicateModel::relocatedIndexes(const QModelIndexList &oldIndexes,
+                                                 const QList<std::pair<int, int>> &targets) const
+{
+    QModelIndexList newIndexes;
+    if (oldIndexes.isEmpty()) {
+        return newIndexes;
+    }
+
+    QList<int> rowOfGroup(m_groups.size());
+    for (int row = 0; row < m_order.size(); ++row) {
+        rowOfGroup[m_order[row]] = row;
+    }
+
+    newIndexes.reserve(oldIndexes.size());
+    for (qsizetype i = 0; i < oldIndexes.size(); ++i) {
+        const auto [groupIdx, offset] = targets[i];
+        const int indexColumn = oldIndexes[i].column();
+        if (groupIdx < 0 || rowOfGroup[groupIdx] >= m_fetchedGroups) {
+            newIndexes.append(QModelIndex());
+            continue;
+        }
+
+        const int groupRow = rowOfGroup[groupIdx];
+        if (offset < 0) {
+            newIndexes.append(createIndex(groupRow, indexColumn, quintptr(groupRow) << 32));
+        } else {
+            int fileRow = 0;
+            while (fileOffset(groupIdx, fileRow) != offset) {
+                ++fileRow;
+            }
+            newIndexes.append(createIndex(fileRow, indexColumn, (quintptr(groupRow) << 32) | (fileRow + 1)));
+        }
+    }
+    return newIndexes;
+}
+
+void DuplicateModel::sortGroups(int column, Qt::SortOrder order)
+{
+    int *begin = m_order.data();
+    int *end = begin + m_order.size();
+
+    switch (column) {
+    case 1:
+        parallelStableSort(begin, end, keyLess(order, [this](int groupIdx) { return groupSize(groupIdx); }));
+        break;
+    case 2: {
+        // Wasted space walks every file, so compute it once per group
+        QList<quint64> wasted(m_groups.size());
+        for (int groupIdx = 0; groupIdx < m_groups.size(); ++groupIdx) {
+            wasted[groupIdx] = groupWastedSpace(groupIdx);
+        }
+        parallelStableSort(begin, end, keyLess(order, [&wasted](int groupIdx) { return wasted[groupIdx]; }));
+        break;
+    }
+    case 3:
+        // Files are sorted by date; groups keep their current order
+        break;
+    case 4:
+        parallelStableSort(begin, end, keyLess(order, [this](int groupIdx) {
+            const GroupRef &ref = m_groups[groupIdx];
+            return m_batches[ref.batch]->groupHash(ref.group);
+        }));
+        break;
+    default:
+        std::iota(begin, end, 0);
+        break;
+    }
+}
+
+void DuplicateModel::sortFiles(int column, Qt::SortOrder order)
+{
+    if (column < 1 || column > 4) {
+        m_fileOrder.clear();
+        return;
+    }
+
+    if (m_fileOrder.isEmpty()) {
+        m_fileOrder.resize(m_checked.size());
+        for (const GroupRef &ref : m_groups) {
+            const int size = m_batches[ref.batch]->groupSize(ref.group);
+            std::iota(m_fileOrder.begin() + ref.firstEntry, m_fileOrder.begin() + ref.firstEntry + size, 0);
+        }
+    }
+
+    // Groups are small, so each is sorted serially; many groups are spread
+    // over the thread pool instead
+    int *fileOrder = m_fileOrder.data();
+    auto sortGroup = [&](const GroupRef &ref) {
+        const DuplicateResults &batch = *m_batches[ref.batch];
+        const int begin = batch.groupBegin(ref.group);
+        int *first = fileOrder + ref.firstEntry;
+        int *last = first + batch.groupSize(ref.group);
+
+        switch (column) {
+        case 1:
+            std::stable_sort(first, last, keyLess(order, [&](int file) {
+                return std::make_pair(batch.fileNameView(begin + file), batch.directory(begin + file));
+            }));
+            break;
+        case 2:
+            std::stable_sort(first, last, keyLess(order, [&](int file) { return batch.size(begin + file); }));
+            break;
+        case 3:
+            std::stable_sort(first, last, keyLess(order, [&](int file) { return batch.modifiedDate(begin + file); }));
+            break;
+        case 4:
+            std::stable_sort(first, last, keyLess(order, [&](int file) {
+                return std::make_pair(batch.directory(begin + file), batch.fileNameView(begin + file));
+            }));
+            break;
+        }
+    };
+
+    if (m_groups.size() < ParallelSortThreshold) {
+        std::for_each(m_groups.cbegin(), m_groups.cend(), sortGroup);
+    } else {
+        QtConcurrent::blockingMap(m_groups, sortGroup);
+    }
+}
+
 QString DuplicateModel::formatSize(quint64 size) const
 {
     if (size > 1024 * 1024 * 1024) {
@@ -3,7 +3,11 @@
 
 #include <QAbstractItemModel>
 #include <QList>
-#include "duplicatefinder.h"
+#include <QSet>
+#include "duplicateresults.h"
+#include "selectionset.h"
+
+#include <utility>
 
 class DuplicateModel : public QAbstractItemModel
 {
@@ -12,14 +16,60 @@ class DuplicateModel : public QAbstractItemModel
 public:
     explicit DuplicateModel(QObject *parent = nullptr);
 
-    void setResults(const QList<DuplicateFinder::DuplicateGroup> &results);
+    // Top-level groups are exposed to views in pages of this size
+    static constexpr int FetchBatchSize = 500;
+
+    // Which file autoSelect() leaves unchecked in each group
+    enum class KeepRule {
+        Newest,
+        Oldest,
+        ShortestPath,
+        InDirectory,     // Argument: directory, first file inside it is kept
+        MatchingPattern, // Argument: regular expression matched against the full path
+    };
+
+    void setResults(const DuplicateResultsPtr &results);
+    // Append groups after the existing ones without resetting the model
+    void appendGroups(const DuplicateResultsPtr &groups);
     void clear();
+    // Follows changes on disk without a rescan. Every path in changedPaths
+    // leaves its group; a path ending in '/' takes everything below that
+    // directory along. Each file in current then joins the group with its
+    // size and hash, or forms a new group with other files in current.
+    // Groups left with a single file disappear, new ones go after the
+    // existing rows. Other files keep their rows and check states. With
+    // ignoreHardLinks, a file sharing its inode with one already in the
+    // group stays out of it.
+    void updateFiles(const QStringList &changedPaths, const QList<DuplicateFinder::DuplicateEntry> &current,
+                     bool ignoreHardLinks = false);
+    // Drops files that were deleted, moved away or replaced by links
+    void removeFiles(const QStringList &paths);
+
+    // All groups held by the model, including those not fetched by a view yet
+    int groupCount() const;
+    // Distinct file sizes over all groups
+    QSet<quint64> groupSizes() const;
+    // Bytes freed by keeping one copy in every group
+    quint64 wastedSpace() const;
+
+    // Groups in scan order, independent of sorting and fetching. Group
+    // groupIdx is group batchGroup(groupIdx) of batchOf(groupIdx).
+    const DuplicateResults &batchOf(int groupIdx) const;
+    int batchGroup(int groupIdx) const;
+    bool isChecked(int groupIdx, int fileIdx) const;
 
     void selectAll();
     void selectNone();
     void invertSelection();
+    // Checks every file except the one kept by the rule in each group. Groups
+    // without a matching file are left fully unchecked. Returns false if the
+    // argument is invalid for the rule.
+    bool autoSelect(KeepRule rule, const QString &argument = QString());
 
     QList<QString> getSelectedFiles() const;
+    // Maintained on every change, O(1)
+    qsizetype selectedCount() const;
+    quint64 selectedSize() const;
 
     // QAbstractItemModel interface
     QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
@@ -30,21 +80,51 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
     Qt::ItemFlags flags(const QModelIndex &index) const override;
     bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+    // Column 1 sorts groups by file count and files by name, column 2 by wasted
+    // bytes and file size, column 3 files by modification time, column 4 groups
+    // by hash and files by path. Column 0 restores the scan order.
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+Q_SIGNALS:
+    // Emitted whenever check states change, after the matching dataChanged()
+    void selectionChanged();
 
 private:
-    struct FileItem {
-        QString path;
-        QString fileName;
-        QString directory;
-        quint64 size;
-        quint64 modifiedDate;
-        QString hash;
-        bool checked;
-        int groupIndex;
+    // A top-level row: one group inside one shared result batch
+    struct GroupRef {
+        int batch;
+        int group;
+        int firstEntry; // Index of the group's first file in m_checked
     };
 
-    QList<DuplicateFinder::DuplicateGroup> m_groups;
-    QList<QList<FileItem>> m_items; // Items organized by group
+    int groupSize(int groupIdx) const;
+    quint64 groupWastedSpace(int groupIdx) const;
+    // Maps a visible file row to the file's offset inside its group
+    int fileOffset(int groupIdx, int fileRow) const;
+    void appendBatch(const DuplicateResultsPtr &groups);
+    // Persistent indexes after a layout change, from the group index and file
+    // offset each old index refers to; a group of -1 invalidates the index
+    QModelIndexList relocatedIndexes(const QModelIndexList &oldIndexes, const QList<std::pair<int, int>> &targets) const;
+    void sortGroups(int column, Qt::SortOrder order);
+    void sortFiles(int column, Qt::SortOrder order);
+    void checkStatesChanged();
+
+    QList<DuplicateResultsPtr> m_batches;
+    QList<GroupRef> m_groups; // In scan order
+    QList<int> m_order; // Top-level row -> index into m_groups
+    QList<int> m_fileOrder; // Per file slot -> offset in its group, empty while unsorted
+    SelectionSet m_checked; // One bit per file, groups laid out consecutively
+    quint64 m_checkedBytes = 0;
+    quint64 m_totalBytes = 0;
+    mutable QList<QString> m_selectedFiles; // Cache for getSelectedFiles()
+    mutable bool m_selectedFilesValid = false;
+    int m_fetchedGroups = 0; // Leading groups visible through rowCount()
+    int m_sortColumn = 0;
+    Qt::SortOrder m_sortOrder = Qt::AscendingOrder;
 
     QString formatSize(quint64 size) const;
     QString formatDate(quint64 timestamp) const;
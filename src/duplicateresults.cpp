@@ -0,0 +1,159 @@
+#include "duplicateresults.h"
+
+DuplicateResultsPtr DuplicateResults::fromGroups(const QList<DuplicateFinder::DuplicateGroup> &groups)
+{
+    Builder builder;
+    for (const auto &group : groups) {
+        builder.beginGroup(group.entries.isEmpty() ? QString() : group.entries.first().hash);
+        for (const auto &entry : group.entries) {
+            builder.addEntry(entry.path, entry.size, entry.modifiedDate);
+        }
+    }
+    return builder.build();
+}
+
+int DuplicateResults::groupCount() const
+{
+    return m_groupHashes.size();
+}
+
+int DuplicateResults::entryCount() const
+{
+    return m_sizes.size();
+}
+
+int DuplicateResults::groupBegin(int group) const
+{
+    return m_groupOffsets[group];
+}
+
+int DuplicateResults::groupSize(int group) const
+{
+    return m_groupOffsets[group + 1] - m_groupOffsets[group];
+}
+
+QString DuplicateResults::groupHash(int group) const
+{
+    return m_groupHashes[group];
+}
+
+QString DuplicateResults::path(int entry) const
+{
+    const QString &dir = m_directories[m_directoryIds[entry]];
+    const QStringView name = QStringView(m_names).mid(m_nameOffsets[entry], m_nameOffsets[entry + 1] - m_nameOffsets[entry]);
+    if (dir.isEmpty()) {
+        return name.toString();
+    }
+
+    QString result;
+    result.reserve(dir.size() + 1 + name.size());
+    result += dir;
+    if (!dir.endsWith(QLatin1Char('/'))) {
+        result += QLatin1Char('/');
+    }
+    result += name;
+    return result;
+}
+
+qsizetype DuplicateResults::pathLength(int entry) const
+{
+    const QString &dir = m_directories[m_directoryIds[entry]];
+    const qsizetype nameLength = m_nameOffsets[entry + 1] - m_nameOffsets[entry];
+    if (dir.isEmpty()) {
+        return nameLength;
+    }
+    return dir.size() + (dir.endsWith(QLatin1Char('/')) ? 0 : 1) + nameLength;
+}
+
+QString DuplicateResults::fileName(int entry) const
+{
+    return m_names.mid(m_nameOffsets[entry], m_nameOffsets[entry + 1] - m_nameOffsets[entry]);
+}
+
+QStringView DuplicateResults::fileNameView(int entry) const
+{
+    return QStringView(m_names).mid(m_nameOffsets[entry], m_nameOffsets[entry + 1] - m_nameOffsets[entry]);
+}
+
+QString DuplicateResults::directory(int entry) const
+{
+    // Shares the interned string, no allocation
+    return m_directories[m_directoryIds[entry]];
+}
+
+quint64 DuplicateResults::size(int entry) const
+{
+    return m_sizes[entry];
+}
+
+quint64 DuplicateResults::modifiedDate(int entry) const
+{
+    return m_modifiedDates[entry];
+}
+
+// Builder implementation
+
+DuplicateResults::Builder::Builder()
+    : m_results(new DuplicateResults)
+{
+}
+
+void DuplicateResults::Builder::reserve(int groups, int entries)
+{
+    m_results->m_groupOffsets.reserve(groups + 1);
+    m_results->m_groupHashes.reserve(groups);
+    m_results->m_directoryIds.reserve(entries);
+    m_results->m_nameOffsets.reserve(entries + 1);
+    m_results->m_sizes.reserve(entries);
+    m_results->m_modifiedDates.reserve(entries);
+}
+
+void DuplicateResults::Builder::beginGroup(const QString &hash)
+{
+    m_results->m_groupHashes.append(hash);
+    m_results->m_groupOffsets.append(m_results->m_groupOffsets.last());
+}
+
+void DuplicateResults::Builder::addEntry(QString path, quint64 size, quint64 modifiedDate)
+{
+    Q_ASSERT(!m_results->m_groupHashes.isEmpty());
+
+    const qsizetype slash = path.lastIndexOf(QLatin1Char('/'));
+    m_results->m_names += QStringView(path).mid(slash + 1);
+    m_results->m_nameOffsets.append(m_results->m_names.size());
+
+    // Reuse the decoded path buffer as the directory key
+    QString directory = std::move(path);
+    directory.truncate(slash == 0 ? 1 : qMax<qsizetype>(slash, 0));
+
+    auto it = m_directoryIds.constFind(directory);
+    if (it == m_directoryIds.constEnd()) {
+        it = m_directoryIds.insert(directory, m_results->m_directories.size());
+        m_results->m_directories.append(directory);
+    }
+    m_results->m_directoryIds.append(it.value());
+
+    m_results->m_sizes.append(size);
+    m_results->m_modifiedDates.append(modifiedDate);
+    ++m_results->m_groupOffsets.last();
+}
+
+int DuplicateResults::Builder::groupCount() const
+{
+    return m_results->groupCount();
+}
+
+int DuplicateResults::Builder::entryCount() const
+{
+    return m_results->entryCount();
+}
+
+DuplicateResultsPtr DuplicateResults::Builder::build()
+{
+    m_directoryIds.clear();
+    m_results->m_names.squeeze();
+
+    DuplicateResultsPtr results(m_results.release());
+    m_results.reset(new DuplicateResults);
+    return results;
+}
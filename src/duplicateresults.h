@@ -0,0 +1,78 @@
+#ifndef DUPLICATERESULTS_H
+#define DUPLICATERESULTS_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <memory>
+#include "duplicatefinder.h"
+
+// Immutable batch of duplicate groups produced by a scan.
+// Shared between the scan thread, DuplicateFinder and DuplicateModel through
+// DuplicateResultsPtr, so results are stored once however many consumers read them.
+//
+// Storage is columnar: directories are interned per batch, file names live in
+// one UTF-16 buffer, and sizes and modification times are packed arrays.
+// Entries are addressed by their index in the batch; group g owns the entries
+// [groupBegin(g), groupBegin(g) + groupSize(g)).
+class DuplicateResults
+{
+public:
+    class Builder;
+
+    static DuplicateResultsPtr fromGroups(const QList<DuplicateFinder::DuplicateGroup> &groups);
+
+    int groupCount() const;
+    int entryCount() const;
+
+    int groupBegin(int group) const;
+    int groupSize(int group) const;
+    QString groupHash(int group) const;
+
+    QString path(int entry) const;
+    // Length of path(entry) without building it
+    qsizetype pathLength(int entry) const;
+    QString fileName(int entry) const;
+    // fileName() without a copy, valid as long as these results
+    QStringView fileNameView(int entry) const;
+    QString directory(int entry) const;
+    quint64 size(int entry) const;
+    quint64 modifiedDate(int entry) const;
+
+private:
+    DuplicateResults() = default;
+
+    QList<quint32> m_groupOffsets{0}; // groupCount() + 1 entry offsets
+    QStringList m_groupHashes;
+    QStringList m_directories;
+    QList<quint32> m_directoryIds;
+    QString m_names;
+    QList<quint32> m_nameOffsets{0};  // entryCount() + 1 offsets into m_names
+    QList<quint64> m_sizes;
+    QList<quint64> m_modifiedDates;
+};
+
+// Accumulates groups into a new batch; not thread-safe, use from one thread
+class DuplicateResults::Builder
+{
+public:
+    Builder();
+
+    void reserve(int groups, int entries);
+
+    void beginGroup(const QString &hash);
+    void addEntry(QString path, quint64 size, quint64 modifiedDate);
+
+    int groupCount() const;
+    int entryCount() const;
+
+    // Hands out the batch and leaves the builder empty
+    DuplicateResultsPtr build();
+
+private:
+    std::unique_ptr<DuplicateResults> m_results;
+    QHash<QString, quint32> m_directoryIds;
+};
+
+#endif // DUPLICATERESULTS_H
@@ -0,0 +1,161 @@
+#include "duplicateverifier.h"
+#include <QFile>
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+struct OpenFile {
+    int file; // Index into the files being verified
+    int fd;
+};
+
+// Reads up to size bytes at offset, retrying short reads; returns the byte count or -1
+ssize_t readChunk(int fd, char *buffer, size_t size, off_t offset)
+{
+    size_t total = 0;
+    while (total < size) {
+        const ssize_t count = ::pread(fd, buffer + total, size - total, offset + off_t(total));
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (count == 0) {
+            break;
+        }
+        total += size_t(count);
+    }
+    return ssize_t(total);
+}
+
+int openForReading(const QString &path)
+{
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        // Files are read once, front to back: ask for aggressive readahead
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    return fd;
+}
+}
+
+QList<DuplicateVerifier::Check> DuplicateVerifier::verify(const QString &reference, const QList<File> &files,
+                                                          const std::atomic<bool> *cancelled)
+{
+    QList<Check> checks(files.size());
+    auto isCancelled = [cancelled]() {
+        return cancelled && cancelled->load(std::memory_order_relaxed);
+    };
+    auto failWith = [&checks](int file, int errorCode) {
+        checks[file] = {errorCode == ENOENT ? Result::Missing : Result::Failed, qt_error_string(errorCode)};
+    };
+
+    // Metadata first: a file changed since the scan is dropped without being read
+    QList<int> candidates;
+    QList<struct stat> candidateStats;
+    for (int file = 0; file < files.size(); ++file) {
+        if (isCancelled()) {
+            return checks;
+        }
+        struct stat fileStat;
+        if (::stat(QFile::encodeName(files[file].path).constData(), &fileStat) != 0) {
+            failWith(file, errno);
+        } else if (quint64(fileStat.st_size) != files[file].size
+                   || quint64(fileStat.st_mtime) != files[file].modifiedDate) {
+            checks[file] = {Result::Changed, tr("Modified since the scan")};
+        } else {
+            candidates.append(file);
+            candidateStats.append(fileStat);
+        }
+    }
+
+    if (reference.isEmpty()) {
+        for (int file : std::as_const(candidates)) {
+            checks[file] = {Result::Verified, QString()};
+        }
+        return checks;
+    }
+
+    const int referenceFd = openForReading(reference);
+    struct stat referenceStat;
+    if (referenceFd < 0 || ::fstat(referenceFd, &referenceStat) != 0) {
+        const QString error = tr("Cannot read %1: %2").arg(reference, qt_error_string(errno));
+        if (referenceFd >= 0) {
+            ::close(referenceFd);
+        }
+        for (int file : std::as_const(candidates)) {
+            checks[file] = {Result::Different, error};
+        }
+        return checks;
+    }
+
+    const QString differs = tr("Contents differ from %1").arg(reference);
+    QList<int> toCompare;
+    for (int i = 0; i < candidates.size(); ++i) {
+        const struct stat &fileStat = candidateStats[i];
+        if (fileStat.st_dev == referenceStat.st_dev && fileStat.st_ino == referenceStat.st_ino) {
+            // Already the same file, nothing to read
+            checks[candidates[i]] = {Result::Verified, QString()};
+        } else if (fileStat.st_size != referenceStat.st_size) {
+            checks[candidates[i]] = {Result::Different, differs};
+        } else {
+            toCompare.append(candidates[i]);
+        }
+    }
+
+    std::vector<char> referenceBuffer(ChunkSize);
+    std::vector<char> fileBuffer(ChunkSize);
+    std::vector<OpenFile> open;
+    open.reserve(MaxOpenFiles);
+
+    for (int first = 0; first < toCompare.size() && !isCancelled(); first += MaxOpenFiles) {
+        for (int i = first; i < qMin(first + MaxOpenFiles, int(toCompare.size())); ++i) {
+            const int fd = openForReading(files[toCompare[i]].path);
+            if (fd < 0) {
+                failWith(toCompare[i], errno);
+            } else {
+                open.push_back({toCompare[i], fd});
+            }
+        }
+
+        // Lockstep: each reference chunk is read once and compared with every
+        // file still matching; a file leaves the slice at its first difference
+        for (off_t offset = 0; !open.empty() && !isCancelled(); offset += ChunkSize) {
+            const ssize_t referenceCount = readChunk(referenceFd, referenceBuffer.data(), ChunkSize, offset);
+            const int referenceError = errno;
+            for (auto it = open.begin(); it != open.end();) {
+                const ssize_t count = referenceCount < 0
+                    ? -1 : readChunk(it->fd, fileBuffer.data(), ChunkSize, offset);
+                if (count < 0) {
+                    checks[it->file] = {Result::Failed,
+                                        qt_error_string(referenceCount < 0 ? referenceError : errno)};
+                } else if (count != referenceCount
+                           || std::memcmp(referenceBuffer.data(), fileBuffer.data(), size_t(count)) != 0) {
+                    checks[it->file] = {Result::Different, differs};
+                } else if (count < ChunkSize) {
+                    checks[it->file] = {Result::Verified, QString()};
+                } else {
+                    ++it;
+                    continue;
+                }
+                ::close(it->fd);
+                it = open.erase(it);
+            }
+        }
+
+        // Only left open when cancelled; those files keep the Cancelled result
+        for (const OpenFile &file : open) {
+            ::close(file.fd);
+        }
+        open.clear();
+    }
+
+    ::close(referenceFd);
+    return checks;
+}
@@ -0,0 +1,53 @@
+#ifndef DUPLICATEVERIFIER_H
+#define DUPLICATEVERIFIER_H
+
+#include <QCoreApplication>
+#include <QList>
+#include <QString>
+#include <atomic>
+
+// Re-confirms, right before files are changed, that duplicates found by a scan
+// are still duplicates.
+//
+// Every file is first checked against the size and modification time the scan
+// recorded. The files that pass are then compared byte by byte with a reference
+// file, in lockstep so the reference is read only once, and each file stops
+// being read at its first differing byte. Safe to call from several threads at
+// once.
+class DuplicateVerifier
+{
+    Q_DECLARE_TR_FUNCTIONS(DuplicateVerifier)
+
+public:
+    struct File {
+        QString path;
+        quint64 size = 0;
+        quint64 modifiedDate = 0; // Seconds since the epoch, as recorded by the scan
+    };
+
+    enum class Result {
+        Verified,
+        Changed,   // Size or modification time differ from the scan
+        Different, // Contents differ from the reference, or the reference is gone
+        Missing,   // The file no longer exists
+        Failed,
+        Cancelled,
+    };
+
+    struct Check {
+        Result result = Result::Cancelled;
+        QString error; // Set unless the file was verified or cancelled
+    };
+
+    // Files are read in chunks of this size
+    static constexpr int ChunkSize = 256 * 1024;
+    // Larger groups are compared in slices of this many files
+    static constexpr int MaxOpenFiles = 64;
+
+    // Checks files against reference; with an empty reference only size and
+    // modification time are checked. Results are in the order of files.
+    static QList<Check> verify(const QString &reference, const QList<File> &files,
+                               const std::atomic<bool> *cancelled = nullptr);
+};
+
+#endif // DUPLICATEVERIFIER_H
@@ -0,0 +1,355 @@
+#include "duplicatewatcher.h"
+#include "czkawka_bridge/czkawka_bridge.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSocketNotifier>
+
+#include <algorithm>
+#include <cerrno>
+#include <fts.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+constexpr quint32 WatchMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+    | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+bool isInside(const QString &path, const QString &directory)
+{
+    if (!path.startsWith(directory)) {
+        return false;
+    }
+    return path.size() == directory.size() || directory.endsWith(QLatin1Char('/'))
+        || path.at(directory.size()) == QLatin1Char('/');
+}
+
+QString childPath(const QString &directory, const QString &name)
+{
+    if (directory.endsWith(QLatin1Char('/'))) {
+        return directory + name;
+    }
+    return directory + QLatin1Char('/') + name;
+}
+}
+
+DuplicateWatcher::DuplicateWatcher(QObject *parent)
+    : QObject(parent)
+{
+    // One pass at a time keeps hashing from competing with itself
+    m_pool.setMaxThreadCount(1);
+    m_flushTimer.setSingleShot(true);
+    connect(&m_flushTimer, &QTimer::timeout, this, &DuplicateWatcher::flush);
+}
+
+DuplicateWatcher::~DuplicateWatcher()
+{
+    stop();
+    m_pool.waitForDone();
+}
+
+bool DuplicateWatcher::start(const DuplicateFinder::ScanParameters &params)
+{
+    stop();
+
+    m_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        qWarning() << "Cannot watch for changes:" << qt_error_string(errno);
+        return false;
+    }
+
+    m_params = params;
+    m_excluded.clear();
+    for (const QString &path : params.excludePaths) {
+        m_excluded.append(QDir::cleanPath(path));
+    }
+    m_cancel = QSharedPointer<std::atomic_bool>::create(false);
+    m_limitReported = false;
+
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &DuplicateWatcher::readEvents);
+
+    for (const QString &path : params.includePaths) {
+        watchTree(QDir::cleanPath(path), false);
+    }
+    qDebug() << "Watching" << m_directories.size() << "directories for changes";
+    return true;
+}
+
+void DuplicateWatcher::stop()
+{
+    ++m_generation;
+    if (m_cancel) {
+        m_cancel->store(true);
+    }
+    m_flushTimer.stop();
+    m_pending.clear();
+    m_removedDirectories.clear();
+    m_directories.clear();
+
+    delete m_notifier;
+    m_notifier = nullptr;
+    if (m_fd >= 0) {
+        // Closing the descriptor drops every watch at once
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool DuplicateWatcher::isActive() const
+{
+    return m_fd >= 0;
+}
+
+void DuplicateWatcher::setGroupSizes(const QSet<quint64> &sizes)
+{
+    m_groupSizes = sizes;
+}
+
+bool DuplicateWatcher::isExcluded(const QString &path) const
+{
+    return std::any_of(m_excluded.cbegin(), m_excluded.cend(), [&path](const QString &directory) {
+        return isInside(path, directory);
+    });
+}
+
+void DuplicateWatcher::watchTree(const QString &path, bool reportFiles)
+{
+    QByteArray rootPath = QFile::encodeName(path);
+    char *paths[] = {rootPath.data(), nullptr};
+    FTS *fts = ::fts_open(paths, FTS_PHYSICAL | FTS_NOCHDIR, nullptr);
+    if (!fts) {
+        return;
+    }
+
+    while (FTSENT *node = ::fts_read(fts)) {
+        if (node->fts_info == FTS_F && reportFiles) {
+            // A directory moved into the tree brings files nobody was told about
+            addPending(QFile::decodeName(node->fts_path));
+            continue;
+        }
+        if (node->fts_info != FTS_D) {
+            continue;
+        }
+
+        const QString directory = QFile::decodeName(node->fts_path);
+        if (isExcluded(directory)) {
+            ::fts_set(fts, node, FTS_SKIP);
+            continue;
+        }
+
+        const int wd = ::inotify_add_watch(m_fd, node->fts_path, WatchMask);
+        if (wd >= 0) {
+            m_directories.insert(wd, directory);
+        } else if (errno == ENOSPC && !m_limitReported) {
+            m_limitReported = true;
+            Q_EMIT changesMissed(tr("Too many directories to watch; raise fs.inotify.max_user_watches"));
+        }
+
+        if (!m_params.recursive) {
+            ::fts_set(fts, node, FTS_SKIP);
+        }
+    }
+    ::fts_close(fts);
+}
+
+void DuplicateWatcher::unwatchTree(const QString &path)
+{
+    // Watches follow the inode, so a directory moved away would keep reporting under its old path
+    for (auto it = m_directories.begin(); it != m_directories.end();) {
+        if (isInside(it.value(), path)) {
+            ::inotify_rm_watch(m_fd, it.key());
+            it = m_directories.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void DuplicateWatcher::addPending(const QString &path, bool removedDirectory)
+{
+    if (m_pending.isEmpty() && m_removedDirectories.isEmpty()) {
+        m_firstPending.start();
+    }
+    if (removedDirectory) {
+        m_removedDirectories.insert(path);
+    } else {
+        m_pending.insert(path);
+    }
+}
+
+void DuplicateWatcher::readEvents()
+{
+    alignas(struct inotify_event) char buffer[64 * 1024];
+
+    for (;;) {
+        const ssize_t length = ::read(m_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break; // EAGAIN once drained
+        }
+
+        for (const char *next = buffer; next < buffer + length;) {
+            const auto *event = reinterpret_cast<const struct inotify_event *>(next);
+            next += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                Q_EMIT changesMissed(tr("Changes came in faster than they could be followed"));
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                m_directories.remove(event->wd);
+                continue;
+            }
+
+            const auto directory = m_directories.constFind(event->wd);
+            if (directory == m_directories.cend() || event->len == 0) {
+                continue;
+            }
+            const QString path = childPath(directory.value(), QFile::decodeName(event->name));
+            if (isExcluded(path)) {
+                continue;
+            }
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    if (m_params.recursive) {
+                        watchTree(path, true);
+                    }
+                } else if (event->mask & IN_MOVED_FROM) {
+                    unwatchTree(path);
+                    addPending(path, true);
+                }
+                continue;
+            }
+
+            addPending(path);
+        }
+    }
+
+    schedule();
+}
+
+void DuplicateWatcher::schedule()
+{
+    if (m_pending.isEmpty() && m_removedDirectories.isEmpty()) {
+        return;
+    }
+    if (m_hashing) {
+        // Picked up when the running pass reports back
+        return;
+    }
+
+    // Every new event restarts the quiet period, up to the maximum delay
+    qint64 wait = qMin<qint64>(QuietPeriodMs, MaxDelayMs - m_firstPending.elapsed());
+    if (m_lastFlush.isValid()) {
+        wait = qMax<qint64>(wait, MinIntervalMs - m_lastFlush.elapsed());
+    }
+    m_flushTimer.start(int(qMax<qint64>(wait, 0)));
+}
+
+void DuplicateWatcher::flush()
+{
+    if (m_pending.size() > MaxPendingPaths) {
+        m_pending.clear();
+        m_removedDirectories.clear();
+        Q_EMIT changesMissed(tr("Too many files changed at once"));
+        return;
+    }
+
+    QStringList changedPaths = m_pending.values();
+    for (const QString &directory : std::as_const(m_removedDirectories)) {
+        changedPaths.append(directory + QLatin1Char('/'));
+    }
+    if (changedPaths.isEmpty()) {
+        return;
+    }
+
+    m_pending.clear();
+    m_removedDirectories.clear();
+    m_lastFlush.start();
+    m_hashing = true;
+
+    const quint64 generation = m_generation;
+    const QSet<quint64> groupSizes = m_groupSizes;
+    const DuplicateFinder::ScanParameters params = m_params;
+    const QSharedPointer<std::atomic_bool> cancel = m_cancel;
+    m_pool.start([this, generation, changedPaths, groupSizes, params, cancel]() {
+        const QList<DuplicateFinder::DuplicateEntry> current = hashChanged(changedPaths, groupSizes, params, cancel.data());
+        QMetaObject::invokeMethod(this, [this, generation, changedPaths, current]() {
+            onHashed(generation, changedPaths, current);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DuplicateWatcher::onHashed(quint64 generation, const QStringList &changedPaths,
+                                const QList<DuplicateFinder::DuplicateEntry> &current)
+{
+    m_hashing = false;
+    if (generation == m_generation) {
+        Q_EMIT filesChanged(changedPaths, current);
+    }
+    schedule();
+}
+
+QList<DuplicateFinder::DuplicateEntry> DuplicateWatcher::hashChanged(const QStringList &paths,
+                                                                     const QSet<quint64> &groupSizes,
+                                                                     const DuplicateFinder::ScanParameters &params,
+                                                                     const std::atomic<bool> *stopFlag)
+{
+    QList<DuplicateFinder::DuplicateEntry> candidates;
+    QHash<quint64, int> sizeCounts;
+    for (const QString &path : paths) {
+        struct stat fileStat;
+        if (path.endsWith(QLatin1Char('/')) || ::lstat(QFile::encodeName(path).constData(), &fileStat) != 0
+            || !S_ISREG(fileStat.st_mode)) {
+            continue;
+        }
+
+        const quint64 size = quint64(fileStat.st_size);
+        if (size < params.minSize || (params.maxSize > 0 && size > params.maxSize)) {
+            continue;
+        }
+        candidates.append({path, size, quint64(fileStat.st_mtime), QString(),
+                           quint64(fileStat.st_dev), quint64(fileStat.st_ino)});
+    }
+
+    if (params.ignoreHardLinks) {
+        // One path per inode, the first by name, as in a full scan
+        std::sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b) {
+            return a.path < b.path;
+        });
+        QSet<std::pair<quint64, quint64>> inodes;
+        candidates.removeIf([&inodes](const DuplicateFinder::DuplicateEntry &entry) {
+            const std::pair<quint64, quint64> inode{entry.device, entry.inode};
+            if (inodes.contains(inode)) {
+                return true;
+            }
+            inodes.insert(inode);
+            return false;
+        });
+    }
+    for (const DuplicateFinder::DuplicateEntry &entry : std::as_const(candidates)) {
+        ++sizeCounts[entry.size];
+    }
+
+    QList<DuplicateFinder::DuplicateEntry> current;
+    char hash[CZKAWKA_HASH_MAX_LEN + 1];
+    for (DuplicateFinder::DuplicateEntry &entry : candidates) {
+        if (!groupSizes.contains(entry.size) && sizeCounts.value(entry.size) < 2) {
+            continue;
+        }
+
+        const size_t length = czkawka_hash_file(QFile::encodeName(entry.path).constData(),
+                                                static_cast<CHashType>(params.hashType),
+                                                stopFlag, hash, sizeof(hash));
+        if (*stopFlag) {
+            break;
+        }
+        if (length > 0) {
+            entry.hash = QString::fromLatin1(hash, qsizetype(length));
+            current.append(entry);
+        }
+    }
+    return current;
+}
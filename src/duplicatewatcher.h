@@ -0,0 +1,96 @@
+#ifndef DUPLICATEWATCHER_H
+#define DUPLICATEWATCHER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QTimer>
+#include "duplicatefinder.h"
+
+#include <atomic>
+
+class QSocketNotifier;
+
+// Keeps the results of a finished hash scan current by watching its directories.
+//
+// Every scanned directory gets an inotify watch, new subdirectories included
+// when the scan was recursive. Changes are coalesced per path and flushed
+// once the tree has been quiet for QuietPeriodMs, or MaxDelayMs after the
+// first pending change while writes go on, but never sooner than
+// MinIntervalMs after the previous flush. Flushed files are hashed on a
+// single worker thread, one flush at a time, so a burst of writes costs at
+// most one hash per file. Only files whose size matches a current group or
+// another changed file are hashed; nothing else can be a duplicate. fanotify
+// would not need a watch per directory, but requires CAP_SYS_ADMIN.
+class DuplicateWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int QuietPeriodMs = 500;
+    static constexpr int MaxDelayMs = 5000;
+    static constexpr int MinIntervalMs = 2000;
+    // Beyond this many pending changes a rescan is cheaper than following them
+    static constexpr int MaxPendingPaths = 10000;
+
+    explicit DuplicateWatcher(QObject *parent = nullptr);
+    ~DuplicateWatcher();
+
+    // Watches params.includePaths with the exclusions, size limits, recursion
+    // and hash type of the scan. Returns false when inotify is unavailable.
+    bool start(const DuplicateFinder::ScanParameters &params);
+    void stop();
+    bool isActive() const;
+
+    // Sizes of the groups currently shown; updated after every change
+    void setGroupSizes(const QSet<quint64> &sizes);
+
+Q_SIGNALS:
+    // changedPaths holds every changed file and, with a trailing '/', every
+    // directory that left the tree. current holds those changed files that
+    // exist and may be duplicates, with their new size, time, hash and
+    // inode; with ignoreHardLinks only the first path of each inode is kept.
+    void filesChanged(const QStringList &changedPaths, const QList<DuplicateFinder::DuplicateEntry> &current);
+    // Some changes were not followed; the results may be stale until the next scan
+    void changesMissed(const QString &reason);
+
+private:
+    void watchTree(const QString &path, bool reportFiles);
+    void unwatchTree(const QString &path);
+    void readEvents();
+    void addPending(const QString &path, bool removedDirectory = false);
+    bool isExcluded(const QString &path) const;
+    void schedule();
+    void flush();
+    void onHashed(quint64 generation, const QStringList &changedPaths,
+                  const QList<DuplicateFinder::DuplicateEntry> &current);
+
+    // Runs on the worker thread
+    static QList<DuplicateFinder::DuplicateEntry> hashChanged(const QStringList &paths, const QSet<quint64> &groupSizes,
+                                                              const DuplicateFinder::ScanParameters &params,
+                                                              const std::atomic<bool> *stopFlag);
+
+    DuplicateFinder::ScanParameters m_params;
+    QStringList m_excluded;
+    QSet<quint64> m_groupSizes;
+    int m_fd = -1;
+    QSocketNotifier *m_notifier = nullptr;
+    QHash<int, QString> m_directories; // Watch descriptor -> directory
+    QSet<QString> m_pending;
+    QSet<QString> m_removedDirectories;
+    QElapsedTimer m_firstPending;
+    QElapsedTimer m_lastFlush;
+    QTimer m_flushTimer;
+    bool m_hashing = false;
+    bool m_limitReported = false;
+    quint64 m_generation = 0; // Drops results of passes started before stop()
+    // Handed to every pass started since start() and set by stop(), so a
+    // pass of an earlier start() never sees it cleared
+    QSharedPointer<std::atomic_bool> m_cancel;
+    QThreadPool m_pool;
+};
+
+#endif // DUPLICATEWATCHER_H
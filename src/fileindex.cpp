@@ -0,0 +1,129 @@
+#include "fileindex.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+constexpr quint32 IndexMagic = 0x44444b49; // "DDKI"
+constexpr quint32 IndexVersion = 1;
+}
+
+FileIndex::FileIndex(const QString &root, int hashType)
+    : m_root(root)
+    , m_hashType(hashType)
+{
+}
+
+QString FileIndex::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/index");
+}
+
+QString FileIndex::fileName(const QString &directory) const
+{
+    // Roots are arbitrary paths; a digest makes a flat, safe file name
+    const QByteArray digest = QCryptographicHash::hash(m_root.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return directory + QLatin1Char('/') + QString::fromLatin1(digest)
+        + QLatin1Char('-') + QString::number(m_hashType) + QStringLiteral(".index");
+}
+
+bool FileIndex::load(const QString &directory)
+{
+    m_entries.clear();
+
+    QFile file(fileName(directory));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 hashType = -1;
+    QString root;
+    quint64 count = 0;
+    in >> magic >> version >> hashType >> root >> count;
+    if (in.status() != QDataStream::Ok || magic != IndexMagic || version != IndexVersion
+        || hashType != m_hashType || root != m_root) {
+        return false;
+    }
+
+    m_entries.reserve(qsizetype(qMin<quint64>(count, 1 << 24)));
+    for (quint64 i = 0; i < count; ++i) {
+        QString path;
+        Entry entry;
+        in >> path >> entry.inode >> entry.size >> entry.modifiedDate >> entry.hash;
+        if (in.status() != QDataStream::Ok) {
+            // A truncated index is worth nothing, every file is read again
+            qWarning() << "Discarding damaged file index" << file.fileName();
+            m_entries.clear();
+            return false;
+        }
+        m_entries.insert(path, entry);
+    }
+    return true;
+}
+
+bool FileIndex::save(const QString &directory) const
+{
+    if (!QDir().mkpath(directory)) {
+        return false;
+    }
+
+    QSaveFile file(fileName(directory));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write file index" << file.fileName() << file.errorString();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << IndexMagic << IndexVersion << qint32(m_hashType) << m_root << quint64(m_entries.size());
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        const Entry &entry = it.value();
+        out << it.key() << entry.inode << entry.size << entry.modifiedDate << entry.hash;
+    }
+
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+QString FileIndex::hashFor(const QString &path, const Entry &current) const
+{
+    const auto it = m_entries.constFind(path);
+    if (it == m_entries.cend()) {
+        return QString();
+    }
+
+    // A replaced file gets a new inode even when size and mtime are restored
+    const Entry &known = it.value();
+    if (known.inode != current.inode || known.size != current.size || known.modifiedDate != current.modifiedDate) {
+        return QString();
+    }
+    return known.hash;
+}
+
+void FileIndex::insert(const QString &path, const Entry &entry)
+{
+    m_entries.insert(path, entry);
+}
+
+void FileIndex::clear()
+{
+    m_entries.clear();
+}
+
+int FileIndex::size() const
+{
+    return m_entries.size();
+}
+
+QString FileIndex::root() const
+{
+    return m_root;
+}
@@ -0,0 +1,51 @@
+#ifndef FILEINDEX_H
+#define FILEINDEX_H
+
+#include <QHash>
+#include <QString>
+
+// What the last incremental scan knew about the files under one root.
+//
+// A file whose path, inode, size and modification time are unchanged since
+// it was indexed keeps its content hash, so a rescan only reads files that
+// are new or changed. The device is left out on purpose: network and btrfs
+// mounts may report another st_dev after a remount. One index file per root
+// and hash type lives in the index directory; a missing or unreadable index
+// simply starts empty.
+class FileIndex
+{
+public:
+    struct Entry {
+        quint64 inode = 0;
+        quint64 size = 0;
+        quint64 modifiedDate = 0;   // Seconds since the epoch
+        QString hash;
+    };
+
+    FileIndex(const QString &root, int hashType);
+
+    // Under the application's cache location
+    static QString defaultDirectory();
+
+    // Replaces the entries with the stored index of this root, if any
+    bool load(const QString &directory);
+    // Written to a temporary file and renamed, a crash never leaves a torn index
+    bool save(const QString &directory) const;
+
+    // The hash of path if the entry still describes the file, else empty
+    QString hashFor(const QString &path, const Entry &current) const;
+    void insert(const QString &path, const Entry &entry);
+    void clear();
+
+    int size() const;
+    QString root() const;
+
+private:
+    QString fileName(const QString &directory) const;
+
+    QString m_root;
+    int m_hashType;
+    QHash<QString, Entry> m_entries;
+};
+
+#endif // FILEINDEX_H
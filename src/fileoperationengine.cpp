@@ -0,0 +1,413 @@
+#include "fileoperationengine.h"
+#include "dedupreplacer.h"
+#include "trace.h"
+#include <QFile>
+#include <QThread>
+#include <KIO/CopyJob>
+
+#include <algorithm>
+#include <cerrno>
+#include <numeric>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+// Keeps progress signals to a rate the UI can repaint
+constexpr qint64 ProgressIntervalMs = 100;
+
+// Syscall workers are mostly waiting on the disk, more threads only add seeks
+constexpr int MaxSyscallThreads = 4;
+}
+
+int FileOperationEngine::Report::count(Outcome outcome) const
+{
+    return int(std::count_if(files.cbegin(), files.cend(), [outcome](const FileResult &file) {
+        return file.outcome == outcome;
+    }));
+}
+
+FileOperationEngine::FileOperationEngine(QObject *parent)
+    : QObject(parent)
+{
+    m_pool.setMaxThreadCount(qMin(MaxSyscallThreads, QThread::idealThreadCount()));
+}
+
+FileOperationEngine::~FileOperationEngine()
+{
+    m_cancelled = true;
+    if (m_job) {
+        m_job->disconnect(this);
+        m_job->kill(KJob::Quietly);
+    }
+    m_pool.waitForDone();
+}
+
+bool FileOperationEngine::isRunning() const
+{
+    return m_running;
+}
+
+void FileOperationEngine::setVerifyContents(bool verify)
+{
+    m_verify = verify;
+}
+
+bool FileOperationEngine::verifyContents() const
+{
+    return m_verify;
+}
+
+void FileOperationEngine::start(Operation operation, const QList<Task> &tasks)
+{
+    Trace::Span span("FileOperationEngine::start");
+    if (m_running) {
+        return;
+    }
+
+    m_operation = operation;
+    m_tasks = tasks;
+    m_report = Report();
+    m_report.operation = operation;
+    m_report.files.resize(tasks.size());
+    for (int i = 0; i < tasks.size(); ++i) {
+        m_report.files[i].path = tasks[i].path;
+    }
+    m_queue.resize(tasks.size());
+    std::iota(m_queue.begin(), m_queue.end(), 0);
+    m_cancelled = false;
+    m_running = true;
+
+    if (tasks.isEmpty()) {
+        // Still finish asynchronously, like every other operation
+        QMetaObject::invokeMethod(this, &FileOperationEngine::finish, Qt::QueuedConnection);
+        return;
+    }
+
+    if (m_verify) {
+        startVerification();
+    } else {
+        startApplying();
+    }
+}
+
+void FileOperationEngine::cancel()
+{
+    if (!m_running) {
+        return;
+    }
+
+    m_cancelled = true;
+    if (m_job) {
+        m_job->kill(KJob::EmitResult);
+    }
+}
+
+void FileOperationEngine::startVerification()
+{
+    // One job per reference file, so each reference is read once per job
+    QList<QList<int>> groups;
+    QHash<QString, int> groupIndex;
+    for (int task = 0; task < m_tasks.size(); ++task) {
+        auto it = groupIndex.constFind(m_tasks[task].reference);
+        if (it == groupIndex.constEnd()) {
+            it = groupIndex.insert(m_tasks[task].reference, groups.size());
+            groups.append(QList<int>());
+        }
+        groups[it.value()].append(task);
+    }
+
+    m_done = 0;
+    m_progressTimer.start();
+    Q_EMIT stageChanged(Stage::Verifying);
+
+    for (const QList<int> &group : std::as_const(groups)) {
+        for (int first = 0; first < group.size(); first += BatchSize) {
+            const QList<int> batch = group.mid(first, BatchSize);
+            const QString reference = m_tasks[batch.first()].reference;
+            QList<DuplicateVerifier::File> files;
+            files.reserve(batch.size());
+            for (int task : batch) {
+                files.append({m_tasks[task].path, m_tasks[task].size, m_tasks[task].modifiedDate});
+            }
+
+            m_pool.start([this, batch, reference, files]() {
+                Trace::Span span("FileOperationEngine: verify batch");
+                const QList<DuplicateVerifier::Check> checks = DuplicateVerifier::verify(reference, files, &m_cancelled);
+                QMetaObject::invokeMethod(this, [this, batch, checks]() {
+                    onVerifyDone(batch, checks);
+                }, Qt::QueuedConnection);
+            });
+        }
+    }
+}
+
+void FileOperationEngine::onVerifyDone(const QList<int> &tasks, const QList<DuplicateVerifier::Check> &checks)
+{
+    Trace::Span span("FileOperationEngine::onVerifyDone");
+    for (int i = 0; i < checks.size(); ++i) {
+        FileResult &file = m_report.files[tasks[i]];
+        switch (checks[i].result) {
+        case DuplicateVerifier::Result::Verified:
+        case DuplicateVerifier::Result::Cancelled:
+            // Still undecided, keeps the Cancelled outcome
+            continue;
+        case DuplicateVerifier::Result::Changed:
+        case DuplicateVerifier::Result::Different:
+            file.outcome = Outcome::Changed;
+            break;
+        case DuplicateVerifier::Result::Missing:
+            file.outcome = Outcome::Missing;
+            break;
+        case DuplicateVerifier::Result::Failed:
+            file.outcome = Outcome::Failed;
+            break;
+        }
+        file.error = checks[i].error;
+    }
+    recordDone(checks.size());
+
+    if (m_done < m_queue.size()) {
+        return;
+    }
+    if (m_cancelled) {
+        finish();
+        return;
+    }
+
+    // Only verified files are still undecided
+    QList<int> verified;
+    for (int task : std::as_const(m_queue)) {
+        if (m_report.files[task].outcome == Outcome::Cancelled) {
+            verified.append(task);
+        }
+    }
+    m_queue = verified;
+    startApplying();
+}
+
+void FileOperationEngine::startApplying()
+{
+    m_done = 0;
+    m_nextTask = 0;
+    m_retryQueue.clear();
+    m_progressTimer.start();
+    Q_EMIT stageChanged(Stage::Applying);
+
+    if (m_queue.isEmpty()) {
+        finish();
+    } else if (m_operation == Operation::Trash || m_operation == Operation::Move) {
+        startNextJob();
+    } else {
+        runSyscallBatches();
+    }
+}
+
+void FileOperationEngine::startNextJob()
+{
+    Trace::Span span("FileOperationEngine::startNextJob");
+    if (m_cancelled || (m_retryQueue.isEmpty() && m_nextTask >= m_queue.size())) {
+        finish();
+        return;
+    }
+
+    // Failed batches are retried one file at a time before new batches start
+    QList<int> batch;
+    if (!m_retryQueue.isEmpty()) {
+        batch.append(m_retryQueue.takeFirst());
+    } else {
+        const QString &target = m_tasks[m_queue[m_nextTask]].target;
+        while (m_nextTask < m_queue.size() && batch.size() < BatchSize
+               && (m_operation != Operation::Move || m_tasks[m_queue[m_nextTask]].target == target)) {
+            batch.append(m_queue[m_nextTask++]);
+        }
+    }
+
+    QList<QUrl> urls;
+    urls.reserve(batch.size());
+    m_jobTasks.clear();
+    for (int task : batch) {
+        const QUrl url = QUrl::fromLocalFile(m_tasks[task].path);
+        urls.append(url);
+        m_jobTasks.insert(url, task);
+    }
+
+    KIO::CopyJob *job = nullptr;
+    if (m_operation == Operation::Trash) {
+        job = KIO::trash(urls, KIO::HideProgressInfo);
+    } else {
+        job = KIO::move(urls, QUrl::fromLocalFile(m_tasks[batch.first()].target), KIO::HideProgressInfo);
+    }
+    // No dialogs: conflicts and errors end the job and are reported per file
+    job->setUiDelegate(nullptr);
+
+    connect(job, &KIO::CopyJob::copyingDone, this,
+            [this](KIO::Job *, const QUrl &from, const QUrl &, const QDateTime &, bool, bool) {
+        const auto it = m_jobTasks.constFind(from);
+        if (it != m_jobTasks.constEnd()) {
+            m_report.files[it.value()].outcome = Outcome::Done;
+            m_jobTasks.erase(it);
+            recordDone(1);
+        }
+    });
+    connect(job, &KJob::result, this, &FileOperationEngine::onJobResult);
+
+    m_job = job;
+}
+
+void FileOperationEngine::onJobResult(KJob *job)
+{
+    Trace::Span span("FileOperationEngine::onJobResult");
+    m_job = nullptr;
+
+    if (job->error() == 0) {
+        // Some workers finish without reporting every file
+        for (int task : std::as_const(m_jobTasks)) {
+            m_report.files[task].outcome = Outcome::Done;
+        }
+        recordDone(m_jobTasks.size());
+    } else if (m_cancelled) {
+        // Unfinished files of the batch keep their Cancelled outcome
+        recordDone(m_jobTasks.size());
+    } else if (m_jobTasks.size() > 1) {
+        QList<int> remaining = m_jobTasks.values();
+        std::sort(remaining.begin(), remaining.end());
+        m_retryQueue = remaining + m_retryQueue;
+    } else {
+        for (int task : std::as_const(m_jobTasks)) {
+            FileResult &file = m_report.files[task];
+            file.outcome = job->error() == KIO::ERR_DOES_NOT_EXIST ? Outcome::Missing : Outcome::Failed;
+            file.error = job->errorString();
+        }
+        recordDone(m_jobTasks.size());
+    }
+
+    m_jobTasks.clear();
+    startNextJob();
+}
+
+void FileOperationEngine::runSyscallBatches()
+{
+    Trace::Span span("FileOperationEngine::runSyscallBatches");
+    // Deletes are split in task order. Link replacements create and rename
+    // entries in the duplicate's directory, so each batch stays within one
+    // directory and concurrent workers mostly lock different directories.
+    QList<QList<int>> directories;
+    if (m_operation == Operation::Delete) {
+        directories.append(m_queue);
+    } else {
+        QHash<QStringView, int> directoryIndex;
+        for (int task : std::as_const(m_queue)) {
+            const QString &path = m_tasks[task].path;
+            const QStringView directory = QStringView(path).left(qMax<qsizetype>(path.lastIndexOf(QLatin1Char('/')), 0));
+            auto it = directoryIndex.constFind(directory);
+            if (it == directoryIndex.constEnd()) {
+                it = directoryIndex.insert(directory, directories.size());
+                directories.append(QList<int>());
+            }
+            directories[it.value()].append(task);
+        }
+    }
+
+    const Operation operation = m_operation;
+    for (const QList<int> &directory : std::as_const(directories)) {
+        for (int first = 0; first < directory.size(); first += BatchSize) {
+            const QList<int> batch = directory.mid(first, BatchSize);
+            QList<Task> tasks;
+            tasks.reserve(batch.size());
+            for (int task : batch) {
+                tasks.append(m_tasks[task]);
+            }
+
+            m_pool.start([this, operation, batch, tasks]() {
+                Trace::Span span("FileOperationEngine: apply batch");
+                QList<FileResult> results;
+                results.reserve(tasks.size());
+                for (const Task &task : tasks) {
+                    if (m_cancelled) {
+                        FileResult cancelled;
+                        cancelled.path = task.path;
+                        results.append(cancelled);
+                    } else {
+                        results.append(runSyscall(operation, task));
+                    }
+                }
+                QMetaObject::invokeMethod(this, [this, batch, results]() {
+                    onBatchDone(batch, results);
+                }, Qt::QueuedConnection);
+            });
+        }
+    }
+}
+
+void FileOperationEngine::onBatchDone(const QList<int> &tasks, const QList<FileResult> &results)
+{
+    Trace::Span span("FileOperationEngine::onBatchDone");
+    for (int i = 0; i < results.size(); ++i) {
+        m_report.files[tasks[i]] = results[i];
+    }
+    recordDone(results.size());
+
+    if (m_done == m_queue.size()) {
+        finish();
+    }
+}
+
+void FileOperationEngine::recordDone(int count)
+{
+    m_done += count;
+    if (m_progressTimer.elapsed() >= ProgressIntervalMs || m_done == m_queue.size()) {
+        m_progressTimer.restart();
+        Q_EMIT progress(m_done, m_queue.size());
+    }
+}
+
+void FileOperationEngine::finish()
+{
+    Trace::Span span("FileOperationEngine::finish");
+    m_running = false;
+    m_report.cancelled = m_cancelled;
+    m_tasks.clear();
+    m_queue.clear();
+
+    const Report report = std::move(m_report);
+    m_report = Report();
+    Q_EMIT finished(report);
+}
+
+FileOperationEngine::FileResult FileOperationEngine::runSyscall(Operation operation, const Task &task)
+{
+    FileResult result;
+    result.path = task.path;
+
+    if (operation == Operation::Delete) {
+        if (::unlink(QFile::encodeName(task.path).constData()) == 0) {
+            result.outcome = Outcome::Done;
+        } else {
+            const int error = errno;
+            result.outcome = error == ENOENT ? Outcome::Missing : Outcome::Failed;
+            result.error = qt_error_string(error);
+        }
+        return result;
+    }
+
+    DedupReplacer::Mode mode = DedupReplacer::Mode::Hardlink;
+    if (operation == Operation::Symlink) {
+        mode = DedupReplacer::Mode::Symlink;
+    } else if (operation == Operation::Reflink) {
+        mode = DedupReplacer::Mode::Reflink;
+    }
+
+    switch (DedupReplacer::replace(mode, task.path, task.target, &result.error)) {
+    case DedupReplacer::Result::Replaced:
+    case DedupReplacer::Result::AlreadyLinked:
+        result.outcome = Outcome::Done;
+        break;
+    case DedupReplacer::Result::Missing:
+        result.outcome = Outcome::Missing;
+        break;
+    case DedupReplacer::Result::Failed:
+        result.outcome = Outcome::Failed;
+        break;
+    }
+    return result;
+}
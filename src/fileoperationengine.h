@@ -0,0 +1,136 @@
+#ifndef FILEOPERATIONENGINE_H
+#define FILEOPERATIONENGINE_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <QUrl>
+#include <atomic>
+#include "duplicateverifier.h"
+
+class KJob;
+
+// Applies one operation to many files without blocking the UI thread.
+//
+// Trash and move go through multi-URL KIO jobs of up to BatchSize files, run
+// asynchronously on the thread that owns the engine. When a batch fails, its
+// unfinished files are retried one by one so every error is attributed to a
+// single file. Delete and link operations use direct syscalls on a bounded
+// private thread pool; links are replaced atomically through DedupReplacer and
+// batched per directory, so workers rarely contend for the same directory.
+// With content verification enabled, every file is first re-compared with
+// its reference through DuplicateVerifier, one group per pool job, and files
+// that are no longer duplicates are left untouched. Progress is throttled and
+// restarts with each stage; the outcome of every file is reported once the
+// whole operation has finished.
+class FileOperationEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Operation {
+        Trash,
+        Delete,
+        Move,     // Task::target is the destination directory
+        Hardlink, // Task::target is the file to link to
+        Symlink,  // Task::target is the file to link to
+        Reflink,  // Task::target is the file to clone
+    };
+    Q_ENUM(Operation)
+
+    enum class Outcome {
+        Done,
+        Failed,
+        Missing,   // The file no longer existed
+        Changed,   // Verification found the file changed or no longer a duplicate
+        Cancelled,
+    };
+    Q_ENUM(Outcome)
+
+    enum class Stage {
+        Verifying,
+        Applying,
+    };
+    Q_ENUM(Stage)
+
+    struct Task {
+        QString path;
+        QString target;
+        // Only used when verifying contents
+        QString reference;        // File path must still be identical to, if any
+        quint64 size = 0;         // As recorded by the scan
+        quint64 modifiedDate = 0;
+    };
+
+    struct FileResult {
+        QString path;
+        Outcome outcome = Outcome::Cancelled;
+        QString error;
+    };
+
+    struct Report {
+        Operation operation = Operation::Delete;
+        QList<FileResult> files; // In task order
+        bool cancelled = false;
+
+        int count(Outcome outcome) const;
+    };
+
+    static constexpr int BatchSize = 256;
+
+    explicit FileOperationEngine(QObject *parent = nullptr);
+    ~FileOperationEngine();
+
+    bool isRunning() const;
+
+    // Applies to operations started afterwards
+    void setVerifyContents(bool verify);
+    bool verifyContents() const;
+
+    // Ignored while another operation is running
+    void start(Operation operation, const QList<Task> &tasks);
+    // Unstarted files are reported as cancelled; running batches finish first
+    void cancel();
+
+Q_SIGNALS:
+    void stageChanged(FileOperationEngine::Stage stage);
+    void progress(int done, int total);
+    void finished(const FileOperationEngine::Report &report);
+
+private:
+    void startVerification();
+    void onVerifyDone(const QList<int> &tasks, const QList<DuplicateVerifier::Check> &checks);
+    void startApplying();
+    void startNextJob();
+    void onJobResult(KJob *job);
+    void runSyscallBatches();
+    void onBatchDone(const QList<int> &tasks, const QList<FileResult> &results);
+    void recordDone(int count);
+    void finish();
+
+    static FileResult runSyscall(Operation operation, const Task &task);
+
+    Operation m_operation = Operation::Delete;
+    QList<Task> m_tasks;
+    Report m_report;
+    QList<int> m_queue; // Tasks of the current stage
+    int m_done = 0;
+    bool m_running = false;
+    bool m_verify = false;
+    std::atomic<bool> m_cancelled{false};
+    QElapsedTimer m_progressTimer;
+
+    // KIO batches
+    int m_nextTask = 0;         // Position in m_queue
+    QList<int> m_retryQueue;    // Tasks of failed batches, retried alone
+    QHash<QUrl, int> m_jobTasks; // Source URL -> task of the running job
+    KJob *m_job = nullptr;
+
+    // Syscall batches
+    QThreadPool m_pool;
+};
+
+#endif // FILEOPERATIONENGINE_H
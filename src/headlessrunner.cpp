@@ -0,0 +1,190 @@
+#include "headlessrunner.h"
+#include "duplicateresults.h"
+#include <QDebug>
+
+#include <cstdio>
+
+namespace {
+void appendJsonString(QByteArray &out, const QString &value)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    out += '"';
+    const QByteArray utf8 = value.toUtf8();
+    for (const char c : utf8) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (uchar(c) < 0x20) {
+                out += "\\u00";
+                out += hexDigits[uchar(c) >> 4];
+                out += hexDigits[uchar(c) & 0xf];
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+// Quotes a field only when it holds a separator, quote or line break (RFC 4180)
+void appendCsvField(QByteArray &out, const QString &value)
+{
+    const QByteArray utf8 = value.toUtf8();
+    if (utf8.indexOf(',') < 0 && utf8.indexOf('"') < 0 && utf8.indexOf('\n') < 0 && utf8.indexOf('\r') < 0) {
+        out += utf8;
+        return;
+    }
+
+    out += '"';
+    for (const char c : utf8) {
+        if (c == '"') {
+            out += '"';
+        }
+        out += c;
+    }
+    out += '"';
+}
+}
+
+HeadlessRunner::HeadlessRunner(QObject *parent)
+    : QObject(parent)
+    , m_finder(new DuplicateFinder(this))
+{
+    // Records are written as they arrive, nothing needs the batches afterwards
+    m_finder->setKeepResults(false);
+
+    connect(m_finder, &DuplicateFinder::groupsAvailable, this, &HeadlessRunner::writeBatch);
+    connect(m_finder, &DuplicateFinder::resultsReady, this, &HeadlessRunner::onResultsReady);
+    connect(m_finder, &DuplicateFinder::scanFinished, this, &HeadlessRunner::onScanFinished);
+}
+
+bool HeadlessRunner::start(const DuplicateFinder::ScanParameters &params, Format format,
+                           const QString &outputPath, QString *error)
+{
+    bool opened = false;
+    if (outputPath.isEmpty() || outputPath == QLatin1String("-")) {
+        opened = m_output.open(stdout, QIODevice::WriteOnly, QFileDevice::DontCloseHandle);
+    } else {
+        m_output.setFileName(outputPath);
+        opened = m_output.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+    if (!opened) {
+        if (error) {
+            *error = m_output.errorString();
+        }
+        return false;
+    }
+
+    m_format = format;
+    m_groupsWritten = 0;
+    m_writeFailed = false;
+    if (format == Format::Csv) {
+        m_writeFailed = m_output.write(csvHeader()) < 0;
+    }
+
+    m_finder->startScan(params);
+    return true;
+}
+
+QByteArray HeadlessRunner::csvHeader()
+{
+    return QByteArrayLiteral("group,hash,path,size,modified\n");
+}
+
+QByteArray HeadlessRunner::formatBatch(const DuplicateResults &batch, int firstGroup, Format format)
+{
+    QByteArray out;
+    out.reserve(batch.entryCount() * 128);
+
+    for (int group = 0; group < batch.groupCount(); ++group) {
+        const QByteArray groupNumber = QByteArray::number(firstGroup + group);
+        const QString hash = batch.groupHash(group);
+        const int begin = batch.groupBegin(group);
+        const int end = begin + batch.groupSize(group);
+
+        for (int entry = begin; entry < end; ++entry) {
+            if (format == Format::JsonLines) {
+                out += "{\"group\":";
+                out += groupNumber;
+                out += ",\"hash\":";
+                appendJsonString(out, hash);
+                out += ",\"path\":";
+                appendJsonString(out, batch.path(entry));
+                out += ",\"size\":";
+                out += QByteArray::number(batch.size(entry));
+                out += ",\"modified\":";
+                out += QByteArray::number(batch.modifiedDate(entry));
+                out += "}\n";
+            } else {
+                out += groupNumber;
+                out += ',';
+                appendCsvField(out, hash);
+                out += ',';
+                appendCsvField(out, batch.path(entry));
+                out += ',';
+                out += QByteArray::number(batch.size(entry));
+                out += ',';
+                out += QByteArray::number(batch.modifiedDate(entry));
+                out += '\n';
+            }
+        }
+    }
+    return out;
+}
+
+void HeadlessRunner::writeBatch(const DuplicateResultsPtr &batch)
+{
+    if (m_writeFailed) {
+        return;
+    }
+
+    // One write per batch keeps syscalls rare while memory stays bounded
+    const QByteArray records = formatBatch(*batch, m_groupsWritten, m_format);
+    m_groupsWritten += batch->groupCount();
+    if (m_output.write(records) != records.size() || !m_output.flush()) {
+        qWarning() << "Failed to write results:" << m_output.errorString();
+        m_writeFailed = true;
+        m_finder->stopScan();
+    }
+}
+
+void HeadlessRunner::onResultsReady(int groupCount, quint64 wastedSpace, const DuplicateFinder::ScanStatistics &statistics)
+{
+    if (!m_output.flush()) {
+        m_writeFailed = true;
+    }
+    m_output.close();
+
+    // Goes to stderr, stdout may carry the records
+    qInfo("%d duplicate groups, %llu bytes wasted", groupCount, static_cast<unsigned long long>(wastedSpace));
+
+    const DuplicateFinder::CacheStats &cache = statistics.cache;
+    if (cache.candidates > 0) {
+        qInfo("cache: %llu hits, %llu misses, %llu bytes hashed, about %llu bytes saved",
+              static_cast<unsigned long long>(cache.hits), static_cast<unsigned long long>(cache.misses),
+              static_cast<unsigned long long>(cache.bytesHashed), static_cast<unsigned long long>(cache.bytesSaved));
+    }
+
+    for (const DuplicateFinder::StageStatistics &stage : statistics.stages) {
+        qInfo("stage %s: %.1f ms, %llu files, %llu bytes, %.0f files/s, %.1f MB/s",
+              qPrintable(DuplicateFinder::stageName(stage.stage)), stage.wallTimeUs / 1000.0,
+              static_cast<unsigned long long>(stage.files), static_cast<unsigned long long>(stage.bytes),
+              stage.filesPerSecond(), stage.bytesPerSecond() / (1024.0 * 1024.0));
+    }
+    qInfo("total: %.1f ms, %.1f ms writing results",
+          statistics.totalTimeUs / 1000.0, statistics.receiverTimeUs / 1000.0);
+}
+
+void HeadlessRunner::onScanFinished(bool success)
+{
+    // An empty output must not pass for "no duplicates" when the scan never completed
+    if (!success) {
+        qWarning() << "Scan failed or was stopped, the results are incomplete";
+    }
+    Q_EMIT finished(success && !m_writeFailed ? 0 : 1);
+}
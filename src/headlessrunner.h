@@ -0,0 +1,53 @@
+#ifndef HEADLESSRUNNER_H
+#define HEADLESSRUNNER_H
+
+#include <QFile>
+#include <QObject>
+#include "duplicatefinder.h"
+
+// Runs one scan without any widgets and streams the duplicates it finds.
+//
+// Every file is written as one record as soon as its batch arrives from
+// DuplicateFinder, which does not keep the batches, so memory stays bounded
+// by the largest batch. Records carry the group's index in scan order:
+// JSON Lines objects {"group", "hash", "path", "size", "modified"}, or CSV
+// rows with the same columns after a header line.
+class HeadlessRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Format {
+        JsonLines,
+        Csv,
+    };
+
+    explicit HeadlessRunner(QObject *parent = nullptr);
+
+    // outputPath "-" or empty writes to stdout. Returns false with error set
+    // when the output cannot be opened; finished() is then never emitted.
+    bool start(const DuplicateFinder::ScanParameters &params, Format format,
+               const QString &outputPath, QString *error);
+
+    // Records for every file of batch, numbering its groups from firstGroup
+    static QByteArray formatBatch(const DuplicateResults &batch, int firstGroup, Format format);
+    static QByteArray csvHeader();
+
+Q_SIGNALS:
+    // 0 on success, 1 when the scan failed or was stopped, or writing the
+    // output failed; the output is incomplete then
+    void finished(int exitCode);
+
+private:
+    void writeBatch(const DuplicateResultsPtr &batch);
+    void onResultsReady(int groupCount, quint64 wastedSpace, const DuplicateFinder::ScanStatistics &statistics);
+    void onScanFinished(bool success);
+
+    DuplicateFinder *m_finder;
+    QFile m_output;
+    Format m_format = Format::JsonLines;
+    int m_groupsWritten = 0;
+    bool m_writeFailed = false;
+};
+
+#endif // HEADLESSRUNNER_H
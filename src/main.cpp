@@ -1,10 +1,38 @@
 #include <QApplication>
 #include <QCommandLineParser>
+#include <QFile>
 #include <KAboutData>
 #include <KLocalizedString>
 #include "mainwindow.h"
+#include "trace.h"
 
-int main(int argc, char *argv[])
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+const char HeadlessFlag[] = "--headless";
+const char HeadlessExecutable[] = "deduplikate-cli";
+
+// Replaces this process with deduplikate-cli from the same directory, else
+// from PATH, and only returns when neither can be started
+int execHeadless(char *argv[])
+{
+    const QByteArray self = QFile::encodeName(QFile::symLinkTarget(QStringLiteral("/proc/self/exe")));
+    const QByteArray sibling = self.left(self.lastIndexOf('/') + 1) + HeadlessExecutable;
+
+    argv[0] = const_cast<char *>(HeadlessExecutable);
+    if (!self.isEmpty()) {
+        ::execv(sibling.constData(), argv);
+    }
+    ::execvp(HeadlessExecutable, argv);
+
+    std::fprintf(stderr, "Cannot start %s: %s\n", HeadlessExecutable, std::strerror(errno));
+    return 1;
+}
+
+int runGui(int argc, char *argv[])
 {
     QApplication app(argc, argv);
 
@@ -34,6 +62,8 @@ int main(int argc, char *argv[])
 
     QCommandLineParser parser;
     aboutData.setupCommandLine(&parser);
+    parser.addOption(QCommandLineOption(QStringLiteral("headless"),
+        i18n("Scan without a user interface; see --headless --help.")));
     parser.process(app);
     aboutData.processCommandLine(&parser);
 
@@ -42,3 +72,20 @@ int main(int argc, char *argv[])
 
     return app.exec();
 }
+}
+
+int main(int argc, char *argv[])
+{
+    // Decided before any application object exists: the process becomes
+    // deduplikate-cli, which never loads the GUI libraries
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], HeadlessFlag) == 0) {
+            return execHeadless(argv);
+        }
+    }
+
+    Trace::startFromEnvironment();
+    const int result = runGui(argc, argv);
+    Trace::finish();
+    return result;
+}
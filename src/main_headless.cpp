@@ -0,0 +1,154 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFileInfo>
+#include <KLocalizedString>
+#include "headlessrunner.h"
+#include "trace.h"
+
+// deduplikate-cli links only the scan engine and KI18n, so command line
+// scans never load the widget, KIO or XmlGui libraries of the GUI.
+
+namespace {
+// Scans from the command line; only QtCore is initialized, no widget is created
+int runHeadless(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("deduplikate"));
+    QCoreApplication::setApplicationVersion(QStringLiteral("1.0.0"));
+    KLocalizedString::setApplicationDomain("deduplikate");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(i18n("Find duplicate files and print them as JSON Lines or CSV"));
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument(QStringLiteral("directories"), i18n("Directories to scan."),
+                                 QStringLiteral("directories..."));
+
+    const QCommandLineOption headlessOption(QStringLiteral("headless"), i18n("Run without a user interface."));
+    const QCommandLineOption excludeOption(QStringLiteral("exclude"),
+        i18n("Directory to skip, may be given several times."), i18n("directory"));
+    const QCommandLineOption methodOption(QStringLiteral("method"),
+        i18n("Check method: hash, name, size or size-name."), i18n("method"), QStringLiteral("hash"));
+    const QCommandLineOption hashOption(QStringLiteral("hash"),
+        i18n("Hash type: blake3, crc32 or xxh3."), i18n("type"), QStringLiteral("blake3"));
+    const QCommandLineOption minSizeOption(QStringLiteral("min-size"),
+        i18n("Ignore files smaller than this many bytes."), i18n("bytes"), QStringLiteral("1024"));
+    const QCommandLineOption maxSizeOption(QStringLiteral("max-size"),
+        i18n("Ignore files larger than this many bytes, 0 for no limit."), i18n("bytes"), QStringLiteral("0"));
+    const QCommandLineOption noRecursiveOption(QStringLiteral("no-recursive"), i18n("Do not descend into subdirectories."));
+    const QCommandLineOption noCacheOption(QStringLiteral("no-cache"), i18n("Do not read or update the hash cache."));
+    const QCommandLineOption cacheMinSizeOption(QStringLiteral("cache-min-size"),
+        i18n("Only cache hashes of files of at least this many bytes."), i18n("bytes"), QStringLiteral("1048576"));
+    const QCommandLineOption prehashCacheMinSizeOption(QStringLiteral("prehash-cache-min-size"),
+        i18n("Only cache prehashes of files of at least this many bytes."), i18n("bytes"), QStringLiteral("1048576"));
+    const QCommandLineOption cacheDirOption(QStringLiteral("cache-dir"),
+        i18n("Keep the hash cache in directory."), i18n("directory"));
+    const QCommandLineOption incrementalOption(QStringLiteral("incremental"),
+        i18n("Only hash files that changed since the last incremental scan of the same directories."));
+    const QCommandLineOption indexDirOption(QStringLiteral("index-dir"),
+        i18n("Keep the incremental scan index in directory."), i18n("directory"));
+    const QCommandLineOption hardLinksOption(QStringLiteral("include-hard-links"),
+        i18n("Report hard links to the same file as duplicates."));
+    const QCommandLineOption threadsOption(QStringLiteral("threads"),
+        i18n("Scan with at most this many worker threads, 0 for one per core."), i18n("count"), QStringLiteral("0"));
+    const QCommandLineOption ioThreadsOption(QStringLiteral("io-threads"),
+        i18n("Read at most this many files at once, 0 for no limit."), i18n("count"), QStringLiteral("0"));
+    const QCommandLineOption backgroundOption(QStringLiteral("background"),
+        i18n("Scan at the lowest CPU and I/O priority."));
+    const QCommandLineOption formatOption(QStringLiteral("format"),
+        i18n("Output format: jsonl or csv."), i18n("format"), QStringLiteral("jsonl"));
+    const QCommandLineOption outputOption({QStringLiteral("o"), QStringLiteral("output")},
+        i18n("Write results to file instead of standard output."), i18n("file"), QStringLiteral("-"));
+
+    parser.addOptions({headlessOption, excludeOption, methodOption, hashOption, minSizeOption, maxSizeOption,
+                       noRecursiveOption, noCacheOption, cacheMinSizeOption, prehashCacheMinSizeOption,
+                       cacheDirOption, incrementalOption, indexDirOption, hardLinksOption, threadsOption,
+                       ioThreadsOption, backgroundOption, formatOption, outputOption});
+    parser.process(app);
+
+    auto usageError = [](const QString &message) {
+        qCritical().noquote() << message;
+        return 2;
+    };
+
+    static const QStringList methods = {QStringLiteral("hash"), QStringLiteral("name"),
+                                        QStringLiteral("size"), QStringLiteral("size-name")};
+    static const QStringList hashTypes = {QStringLiteral("blake3"), QStringLiteral("crc32"), QStringLiteral("xxh3")};
+
+    // Values follow ScanParameters::checkMethod and ScanParameters::hashType
+    DuplicateFinder::ScanParameters params;
+    params.checkMethod = methods.indexOf(parser.value(methodOption));
+    params.hashType = hashTypes.indexOf(parser.value(hashOption));
+    params.recursive = !parser.isSet(noRecursiveOption);
+    params.ignoreHardLinks = !parser.isSet(hardLinksOption);
+    params.useCache = !parser.isSet(noCacheOption);
+    params.includePaths = parser.positionalArguments();
+    params.excludePaths = parser.values(excludeOption);
+    params.cacheDirectory = parser.value(cacheDirOption);
+    params.incremental = parser.isSet(incrementalOption);
+    params.indexDirectory = parser.value(indexDirOption);
+    params.background = parser.isSet(backgroundOption);
+
+    bool minSizeOk = false;
+    bool maxSizeOk = false;
+    bool cacheSizeOk = false;
+    bool prehashCacheSizeOk = false;
+    params.minSize = parser.value(minSizeOption).toULongLong(&minSizeOk);
+    params.maxSize = parser.value(maxSizeOption).toULongLong(&maxSizeOk);
+    params.minimalCacheFileSize = parser.value(cacheMinSizeOption).toULongLong(&cacheSizeOk);
+    params.minimalPrehashCacheFileSize = parser.value(prehashCacheMinSizeOption).toULongLong(&prehashCacheSizeOk);
+
+    bool threadsOk = false;
+    bool ioThreadsOk = false;
+    params.cpuThreads = parser.value(threadsOption).toInt(&threadsOk);
+    params.ioThreads = parser.value(ioThreadsOption).toInt(&ioThreadsOk);
+
+    if (params.includePaths.isEmpty()) {
+        return usageError(i18n("No directories to scan."));
+    }
+    for (const QString &path : std::as_const(params.includePaths)) {
+        if (!QFileInfo(path).isDir()) {
+            return usageError(i18n("Not a directory: %1", path));
+        }
+    }
+    if (params.checkMethod < 0) {
+        return usageError(i18n("Unknown check method: %1", parser.value(methodOption)));
+    }
+    if (params.hashType < 0) {
+        return usageError(i18n("Unknown hash type: %1", parser.value(hashOption)));
+    }
+    if (!minSizeOk || !maxSizeOk || !cacheSizeOk || !prehashCacheSizeOk) {
+        return usageError(i18n("Sizes must be given in bytes."));
+    }
+    if (!threadsOk || !ioThreadsOk || params.cpuThreads < 0 || params.ioThreads < 0) {
+        return usageError(i18n("Thread counts must be 0 or more."));
+    }
+
+    HeadlessRunner::Format format = HeadlessRunner::Format::JsonLines;
+    if (parser.value(formatOption) == QLatin1String("csv")) {
+        format = HeadlessRunner::Format::Csv;
+    } else if (parser.value(formatOption) != QLatin1String("jsonl")) {
+        return usageError(i18n("Unknown output format: %1", parser.value(formatOption)));
+    }
+
+    HeadlessRunner runner;
+    QObject::connect(&runner, &HeadlessRunner::finished, &app, &QCoreApplication::exit);
+
+    QString error;
+    if (!runner.start(params, format, parser.value(outputOption), &error)) {
+        qCritical().noquote() << i18n("Cannot open output: %1", error);
+        return 1;
+    }
+
+    return app.exec();
+}
+}
+
+int main(int argc, char *argv[])
+{
+    Trace::startFromEnvironment();
+    const int result = runHeadless(argc, argv);
+    Trace::finish();
+    return result;
+}
@@ -1,6 +1,11 @@
 #include "mainwindow.h"
 #include "duplicatefinder.h"
 #include "duplicatemodel.h"
+#include "duplicateresults.h"
+#include "duplicatewatcher.h"
+#include "fileoperationengine.h"
+#include "reductionplan.h"
+#include "trace.h"
 
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -11,18 +16,20 @@
 #include <QAction>
 #include <QGroupBox>
 #include <QFormLayout>
-#include <QFileInfo>
+#include <QInputDialog>
+#include <QHeaderView>
 #include <QUrl>
 #include <QPushButton>
-#include <QApplication>
+#include <QLocale>
 #include <KLocalizedString>
-#include <KIO/DeleteJob>
-#include <KIO/CopyJob>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , m_resultsModel(nullptr)
     , m_duplicateFinder(nullptr)
+    , m_watcher(nullptr)
+    , m_hasResults(false)
+    , m_fileOperations(nullptr)
     , m_scanning(false)
     , m_currentTool(0)
 {
@@ -37,9 +44,27 @@ MainWindow::MainWindow(QWidget *parent)
             this, &MainWindow::onScanProgress);
     connect(m_duplicateFinder, &DuplicateFinder::scanFinished,
             this, &MainWindow::onScanFinished);
+    connect(m_duplicateFinder, &DuplicateFinder::groupsAvailable,
+            m_resultsModel, &DuplicateModel::appendGroups);
     connect(m_duplicateFinder, &DuplicateFinder::resultsReady,
             this, &MainWindow::onResultsReady);
 
+    m_watcher = new DuplicateWatcher(this);
+
+    connect(m_watcher, &DuplicateWatcher::filesChanged,
+            this, &MainWindow::onWatchedFilesChanged);
+    connect(m_watcher, &DuplicateWatcher::changesMissed,
+            this, &MainWindow::onChangesMissed);
+
+    m_fileOperations = new FileOperationEngine(this);
+
+    connect(m_fileOperations, &FileOperationEngine::stageChanged,
+            this, &MainWindow::onFileOperationStageChanged);
+    connect(m_fileOperations, &FileOperationEngine::progress,
+            this, &MainWindow::onFileOperationProgress);
+    connect(m_fileOperations, &FileOperationEngine::finished,
+            this, &MainWindow::onFileOperationFinished);
+
     setWindowTitle(i18n("Deduplikate - Duplicate File Finder"));
     resize(1200, 700);
 }
@@ -81,6 +106,14 @@ void MainWindow::setupMenuBar()
     quitAction->setShortcut(QKeySequence::Quit);
     connect(quitAction, &QAction::triggered, this, &QMainWindow::close);
 
+    QMenu *viewMenu = menuBar()->addMenu(i18n("&View"));
+
+    QAction *expandVisibleAction = viewMenu->addAction(i18n("&Expand Visible Groups"));
+    connect(expandVisibleAction, &QAction::triggered, this, &MainWindow::expandVisibleGroups);
+
+    QAction *collapseAllAction = viewMenu->addAction(i18n("&Collapse All Groups"));
+    connect(collapseAllAction, &QAction::triggered, m_resultsView, &QTreeView::collapseAll);
+
     QMenu *helpMenu = menuBar()->addMenu(i18n("&Help"));
 
     QAction *aboutAction = helpMenu->addAction(i18n("&About"));
@@ -164,6 +197,23 @@ void MainWindow::createRightPanel()
     m_useCacheCheck->setChecked(true);
     optionsLayout->addWidget(m_useCacheCheck);
 
+    m_incrementalCheck = new QCheckBox(i18n("Incremental rescans"));
+    m_incrementalCheck->setToolTip(i18n("Remember every hashed file and on the next scan only read files that "
+                                        "are new or changed. Applies to the Hash method."));
+    optionsLayout->addWidget(m_incrementalCheck);
+
+    m_watchCheck = new QCheckBox(i18n("Watch for changes"));
+    m_watchCheck->setToolTip(i18n("After a scan with the Hash method, follow changes in the scanned directories "
+                                  "and update the results without a rescan"));
+    connect(m_watchCheck, &QCheckBox::toggled, this, &MainWindow::onWatchToggled);
+    optionsLayout->addWidget(m_watchCheck);
+
+    m_verifyCheck = new QCheckBox(i18n("Verify contents before changing files"));
+    m_verifyCheck->setToolTip(i18n("Compare every selected file byte by byte with the file kept in its group "
+                                   "and skip files that changed since the scan"));
+    m_verifyCheck->setChecked(true);
+    optionsLayout->addWidget(m_verifyCheck);
+
     QHBoxLayout *minSizeLayout = new QHBoxLayout();
     minSizeLayout->addWidget(new QLabel(i18n("Min size (KB):")));
     m_minSizeSpin = new QSpinBox();
@@ -182,6 +232,64 @@ void MainWindow::createRightPanel()
 
     settingsLayout->addWidget(optionsGroup);
 
+    m_cacheGroup = new QGroupBox(i18n("Cache"));
+    QFormLayout *cacheLayout = new QFormLayout(m_cacheGroup);
+
+    // Below these sizes hashing is cheaper than a cache lookup is worth storing
+    m_cacheMinSizeSpin = new QSpinBox();
+    m_cacheMinSizeSpin->setRange(0, 10000000);
+    m_cacheMinSizeSpin->setValue(1024);
+    m_cacheMinSizeSpin->setToolTip(i18n("Smaller files are hashed again on every scan"));
+    cacheLayout->addRow(i18n("Cache hashes from (KB):"), m_cacheMinSizeSpin);
+
+    m_prehashCacheMinSizeSpin = new QSpinBox();
+    m_prehashCacheMinSizeSpin->setRange(0, 10000000);
+    m_prehashCacheMinSizeSpin->setValue(1024);
+    cacheLayout->addRow(i18n("Cache prehashes from (KB):"), m_prehashCacheMinSizeSpin);
+
+    QHBoxLayout *cacheDirLayout = new QHBoxLayout();
+    m_cacheDirEdit = new QLineEdit();
+    m_cacheDirEdit->setPlaceholderText(i18n("Default"));
+    m_cacheDirEdit->setToolTip(i18n("Can only be changed before the first scan that uses the cache"));
+    m_cacheDirButton = new QPushButton(i18n("Browse..."));
+    cacheDirLayout->addWidget(m_cacheDirEdit);
+    cacheDirLayout->addWidget(m_cacheDirButton);
+    cacheLayout->addRow(i18n("Location:"), cacheDirLayout);
+
+    settingsLayout->addWidget(m_cacheGroup);
+
+    connect(m_useCacheCheck, &QCheckBox::toggled, m_cacheGroup, &QGroupBox::setEnabled);
+    connect(m_cacheDirButton, &QPushButton::clicked, this, [this]() {
+        QString dir = QFileDialog::getExistingDirectory(this, i18n("Select Cache Directory"), m_cacheDirEdit->text());
+        if (!dir.isEmpty()) {
+            m_cacheDirEdit->setText(dir);
+        }
+    });
+
+    QGroupBox *performanceGroup = new QGroupBox(i18n("Performance"));
+    QFormLayout *performanceLayout = new QFormLayout(performanceGroup);
+
+    m_priorityCombo = new QComboBox();
+    m_priorityCombo->addItem(i18n("Normal"), false);
+    m_priorityCombo->addItem(i18n("Background"), true);
+    m_priorityCombo->setToolTip(i18n("In the background, the scan only uses processor time and disk access "
+                                     "that other programs leave"));
+    performanceLayout->addRow(i18n("Priority:"), m_priorityCombo);
+
+    m_cpuThreadsSpin = new QSpinBox();
+    m_cpuThreadsSpin->setRange(0, 256);
+    m_cpuThreadsSpin->setSpecialValueText(i18n("One per core"));
+    performanceLayout->addRow(i18n("Worker threads:"), m_cpuThreadsSpin);
+
+    // Hard disks seek less with fewer files read at once
+    m_ioThreadsSpin = new QSpinBox();
+    m_ioThreadsSpin->setRange(0, 256);
+    m_ioThreadsSpin->setSpecialValueText(i18n("No limit"));
+    m_ioThreadsSpin->setToolTip(i18n("Use 1 or 2 for hard disks, where concurrent reads mostly add seeking"));
+    performanceLayout->addRow(i18n("Files read at once:"), m_ioThreadsSpin);
+
+    settingsLayout->addWidget(performanceGroup);
+
     QGroupBox *pathsGroup = new QGroupBox(i18n("Directories"));
     QVBoxLayout *pathsLayout = new QVBoxLayout(pathsGroup);
 
@@ -256,9 +364,31 @@ void MainWindow::createBottomPanel()
     m_hardlinkButton->setEnabled(false);
     m_symlinkButton = new QPushButton(QIcon::fromTheme(QStringLiteral("emblem-symbolic-link")), i18n("Symlink"));
     m_symlinkButton->setEnabled(false);
+    m_reflinkButton = new QPushButton(QIcon::fromTheme(QStringLiteral("edit-copy")), i18n("Reflink"));
+    m_reflinkButton->setToolTip(i18n("Replace duplicates with copy-on-write clones (Btrfs, XFS)"));
+    m_reflinkButton->setEnabled(false);
     m_selectAllButton = new QPushButton(i18n("Select All"));
     m_selectNoneButton = new QPushButton(i18n("Select None"));
     m_invertSelectionButton = new QPushButton(i18n("Invert Selection"));
+    m_autoSelectButton = new QPushButton(QIcon::fromTheme(QStringLiteral("edit-select")), i18n("Auto Select"));
+
+    // Each rule checks every file but the one it keeps in each group
+    QMenu *autoSelectMenu = new QMenu(m_autoSelectButton);
+    connect(autoSelectMenu->addAction(i18n("Keep Newest")), &QAction::triggered, this, [this]() {
+        m_resultsModel->autoSelect(DuplicateModel::KeepRule::Newest);
+    });
+    connect(autoSelectMenu->addAction(i18n("Keep Oldest")), &QAction::triggered, this, [this]() {
+        m_resultsModel->autoSelect(DuplicateModel::KeepRule::Oldest);
+    });
+    connect(autoSelectMenu->addAction(i18n("Keep Shortest Path")), &QAction::triggered, this, [this]() {
+        m_resultsModel->autoSelect(DuplicateModel::KeepRule::ShortestPath);
+    });
+    autoSelectMenu->addSeparator();
+    connect(autoSelectMenu->addAction(i18n("Keep Files in Directory...")), &QAction::triggered,
+            this, &MainWindow::onAutoSelectDirectory);
+    connect(autoSelectMenu->addAction(i18n("Keep Files Matching Pattern...")), &QAction::triggered,
+            this, &MainWindow::onAutoSelectPattern);
+    m_autoSelectButton->setMenu(autoSelectMenu);
 
     buttonsLayout->addWidget(m_scanButton);
     buttonsLayout->addWidget(m_stopButton);
@@ -266,11 +396,13 @@ void MainWindow::createBottomPanel()
     buttonsLayout->addWidget(m_selectAllButton);
     buttonsLayout->addWidget(m_selectNoneButton);
     buttonsLayout->addWidget(m_invertSelectionButton);
+    buttonsLayout->addWidget(m_autoSelectButton);
     buttonsLayout->addStretch();
     buttonsLayout->addWidget(m_deleteButton);
     buttonsLayout->addWidget(m_moveButton);
     buttonsLayout->addWidget(m_hardlinkButton);
     buttonsLayout->addWidget(m_symlinkButton);
+    buttonsLayout->addWidget(m_reflinkButton);
 
     layout->addLayout(buttonsLayout);
 
@@ -279,10 +411,12 @@ void MainWindow::createBottomPanel()
     m_progressBar->setVisible(false);
     m_statusLabel = new QLabel(i18n("Ready"));
     m_resultsLabel = new QLabel();
+    m_selectionLabel = new QLabel();
 
     statusLayout->addWidget(m_statusLabel);
     statusLayout->addWidget(m_progressBar);
     statusLayout->addStretch();
+    statusLayout->addWidget(m_selectionLabel);
     statusLayout->addWidget(m_resultsLabel);
 
     layout->addLayout(statusLayout);
@@ -295,9 +429,11 @@ void MainWindow::createBottomPanel()
     connect(m_moveButton, &QPushButton::clicked, this, &MainWindow::onMoveClicked);
     connect(m_hardlinkButton, &QPushButton::clicked, this, &MainWindow::onHardlinkClicked);
     connect(m_symlinkButton, &QPushButton::clicked, this, &MainWindow::onSymlinkClicked);
+    connect(m_reflinkButton, &QPushButton::clicked, this, &MainWindow::onReflinkClicked);
     connect(m_selectAllButton, &QPushButton::clicked, this, &MainWindow::onSelectAllClicked);
     connect(m_selectNoneButton, &QPushButton::clicked, this, &MainWindow::onSelectNoneClicked);
     connect(m_invertSelectionButton, &QPushButton::clicked, this, &MainWindow::onInvertSelectionClicked);
+    connect(m_resultsModel, &DuplicateModel::selectionChanged, this, &MainWindow::updateSelectionStatus);
 }
 
 void MainWindow::onToolSelected(int index)
@@ -325,6 +461,13 @@ void MainWindow::onScanClicked()
     params.recursive = m_recursiveCheck->isChecked();
     params.ignoreHardLinks = m_ignoreHardLinksCheck->isChecked();
     params.useCache = m_useCacheCheck->isChecked();
+    params.incremental = m_incrementalCheck->isChecked();
+    params.minimalCacheFileSize = static_cast<quint64>(m_cacheMinSizeSpin->value()) * 1024;
+    params.minimalPrehashCacheFileSize = static_cast<quint64>(m_prehashCacheMinSizeSpin->value()) * 1024;
+    params.cacheDirectory = m_cacheDirEdit->text().trimmed();
+    params.cpuThreads = m_cpuThreadsSpin->value();
+    params.ioThreads = m_ioThreadsSpin->value();
+    params.background = m_priorityCombo->currentData().toBool();
     params.minSize = static_cast<quint64>(m_minSizeSpin->value()) * 1024;
     params.maxSize = m_maxSizeSpin->value() > 0
         ? static_cast<quint64>(m_maxSizeSpin->value()) * 1024 * 1024
@@ -338,49 +481,39 @@ void MainWindow::onScanClicked()
         params.excludePaths.append(m_excludePathsList->item(i)->text());
     }
 
+    m_watcher->stop();
+    m_hasResults = false;
+    m_lastScanParams = params;
     m_resultsModel->clear();
+    m_resultsLabel->setToolTip(QString());
     m_duplicateFinder->startScan(params);
 }
 
 void MainWindow::onStopClicked()
 {
-    m_duplicateFinder->stopScan();
+    if (m_fileOperations->isRunning()) {
+        m_fileOperations->cancel();
+    } else {
+        m_duplicateFinder->stopScan();
+    }
 }
 
 void MainWindow::onDeleteClicked()
 {
-    QList<QString> selectedFiles = m_resultsModel->getSelectedFiles();
+    const qsizetype selectedCount = m_resultsModel->selectedCount();
 
-    if (selectedFiles.isEmpty()) {
+    if (selectedCount == 0) {
         QMessageBox::information(this, i18n("No Selection"),
             i18n("Please select files to delete."));
         return;
     }
 
-    // Calculate total size
-    quint64 totalSize = 0;
-    for (const QString &filePath : selectedFiles) {
-        QFileInfo info(filePath);
-        if (info.exists()) {
-            totalSize += info.size();
-        }
-    }
-
-    QString sizeStr;
-    if (totalSize > 1024 * 1024 * 1024) {
-        sizeStr = QString::number(totalSize / (1024.0 * 1024.0 * 1024.0), 'f', 2) + QLatin1String(" GB");
-    } else if (totalSize > 1024 * 1024) {
-        sizeStr = QString::number(totalSize / (1024.0 * 1024.0), 'f', 2) + QLatin1String(" MB");
-    } else if (totalSize > 1024) {
-        sizeStr = QString::number(totalSize / 1024.0, 'f', 2) + QLatin1String(" KB");
-    } else {
-        sizeStr = QString::number(totalSize) + QLatin1String(" bytes");
-    }
+    QString sizeStr = formatSize(m_resultsModel->selectedSize());
 
     QMessageBox msgBox(this);
     msgBox.setIcon(QMessageBox::Warning);
     msgBox.setWindowTitle(i18n("Confirm Deletion"));
-    msgBox.setText(i18n("Delete %1 selected files (%2)?", selectedFiles.count(), sizeStr));
+    msgBox.setText(i18n("Delete %1 selected files (%2)?", selectedCount, sizeStr));
     msgBox.setInformativeText(i18n("This action cannot be undone if you choose permanent deletion."));
 
     QPushButton *trashButton = msgBox.addButton(i18n("Move to Trash"), QMessageBox::AcceptRole);
@@ -395,82 +528,16 @@ void MainWindow::onDeleteClicked()
     }
 
     bool moveToTrash = (msgBox.clickedButton() == trashButton);
-    int successCount = 0;
-    int failCount = 0;
-    QStringList failedFiles;
-
-    m_statusLabel->setText(i18n("Deleting files..."));
-    m_progressBar->setVisible(true);
-    m_progressBar->setRange(0, selectedFiles.count());
-
-    for (int i = 0; i < selectedFiles.count(); ++i) {
-        const QString &filePath = selectedFiles[i];
-        m_progressBar->setValue(i);
-        qApp->processEvents();
-
-        QFileInfo info(filePath);
-        if (!info.exists()) {
-            continue;
-        }
-
-        bool success = false;
-        if (moveToTrash) {
-            // Use KIO to move to trash
-            QUrl fileUrl = QUrl::fromLocalFile(filePath);
-            KIO::CopyJob *job = KIO::trash(fileUrl, KIO::HideProgressInfo);
-            job->exec();
-            success = (job->error() == 0);
-        } else {
-            // Permanent deletion
-            QFile file(filePath);
-            success = file.remove();
-        }
-
-        if (success) {
-            successCount++;
-        } else {
-            failCount++;
-            failedFiles.append(filePath);
-        }
-    }
-
-    m_progressBar->setVisible(false);
-
-    // Refresh results after deletion
-    if (successCount > 0) {
-        // Trigger a new scan with same parameters, or just remove from model
-        // For now, just clear the results and ask user to rescan
-        m_statusLabel->setText(i18n("Deleted %1 files, %2 failed", successCount, failCount));
 
-        if (failCount > 0) {
-            QString message = i18n("Failed to delete %1 files:\n", failCount);
-            for (int i = 0; i < qMin(5, failedFiles.count()); ++i) {
-                message += failedFiles[i] + QLatin1String("\n");
-            }
-            if (failedFiles.count() > 5) {
-                message += i18n("... and %1 more", failedFiles.count() - 5);
-            }
-            QMessageBox::warning(this, i18n("Deletion Errors"), message);
-        } else {
-            QMessageBox::information(this, i18n("Success"),
-                i18n("Successfully deleted %1 files.", successCount));
-        }
-
-        // Clear results and suggest rescan
-        m_resultsModel->clear();
-        m_resultsLabel->clear();
-        m_deleteButton->setEnabled(false);
-        m_moveButton->setEnabled(false);
-        m_hardlinkButton->setEnabled(false);
-        m_symlinkButton->setEnabled(false);
-    }
+    startFileOperation(moveToTrash ? FileOperationEngine::Operation::Trash : FileOperationEngine::Operation::Delete,
+                       selectionTasks(QString()), i18n("Deleting files..."));
 }
 
 void MainWindow::onMoveClicked()
 {
-    QList<QString> selectedFiles = m_resultsModel->getSelectedFiles();
+    const qsizetype selectedCount = m_resultsModel->selectedCount();
 
-    if (selectedFiles.isEmpty()) {
+    if (selectedCount == 0) {
         QMessageBox::information(this, i18n("No Selection"),
             i18n("Please select files to move."));
         return;
@@ -488,7 +555,7 @@ void MainWindow::onMoveClicked()
     QMessageBox msgBox(this);
     msgBox.setIcon(QMessageBox::Question);
     msgBox.setWindowTitle(i18n("Confirm Move"));
-    msgBox.setText(i18n("Move %1 selected files to %2?", selectedFiles.count(), targetDir));
+    msgBox.setText(i18n("Move %1 selected files to %2?", selectedCount, targetDir));
     msgBox.setStandardButtons(QMessageBox::Yes | QMessageBox::Cancel);
     msgBox.setDefaultButton(QMessageBox::Yes);
 
@@ -496,82 +563,25 @@ void MainWindow::onMoveClicked()
         return;
     }
 
-    int successCount = 0;
-    int failCount = 0;
-    QStringList failedFiles;
-
-    m_statusLabel->setText(i18n("Moving files..."));
-    m_progressBar->setVisible(true);
-    m_progressBar->setRange(0, selectedFiles.count());
-
-    for (int i = 0; i < selectedFiles.count(); ++i) {
-        const QString &filePath = selectedFiles[i];
-        m_progressBar->setValue(i);
-        qApp->processEvents();
-
-        QFileInfo info(filePath);
-        if (!info.exists()) {
-            continue;
-        }
-
-        QUrl sourceUrl = QUrl::fromLocalFile(filePath);
-        QUrl destUrl = QUrl::fromLocalFile(targetDir + QLatin1String("/") + info.fileName());
-
-        KIO::CopyJob *job = KIO::move(sourceUrl, destUrl, KIO::HideProgressInfo);
-        job->exec();
-
-        if (job->error() == 0) {
-            successCount++;
-        } else {
-            failCount++;
-            failedFiles.append(filePath);
-        }
-    }
-
-    m_progressBar->setVisible(false);
-    m_statusLabel->setText(i18n("Moved %1 files, %2 failed", successCount, failCount));
-
-    if (failCount > 0) {
-        QString message = i18n("Failed to move %1 files:\n", failCount);
-        for (int i = 0; i < qMin(5, failedFiles.count()); ++i) {
-            message += failedFiles[i] + QLatin1String("\n");
-        }
-        if (failedFiles.count() > 5) {
-            message += i18n("... and %1 more", failedFiles.count() - 5);
-        }
-        QMessageBox::warning(this, i18n("Move Errors"), message);
-    } else {
-        QMessageBox::information(this, i18n("Success"),
-            i18n("Successfully moved %1 files.", successCount));
-    }
-
-    if (successCount > 0) {
-        m_resultsModel->clear();
-        m_resultsLabel->clear();
-        m_deleteButton->setEnabled(false);
-        m_moveButton->setEnabled(false);
-        m_hardlinkButton->setEnabled(false);
-        m_symlinkButton->setEnabled(false);
-    }
+    startFileOperation(FileOperationEngine::Operation::Move, selectionTasks(targetDir), i18n("Moving files..."));
 }
 
 void MainWindow::onHardlinkClicked()
 {
-    QList<QString> selectedFiles = m_resultsModel->getSelectedFiles();
+    // Pairs each checked duplicate with the file kept in its group
+    const ReductionPlan plan = ReductionPlan::fromModel(*m_resultsModel);
 
-    if (selectedFiles.isEmpty()) {
+    if (plan.isEmpty()) {
         QMessageBox::information(this, i18n("No Selection"),
             i18n("Please select files to hardlink."));
         return;
     }
 
-    // For hardlinking, we need to keep one original and link the others to it
-    // Group by duplicate groups and keep the first file as original
     QMessageBox msgBox(this);
     msgBox.setIcon(QMessageBox::Information);
     msgBox.setWindowTitle(i18n("Hardlink Duplicates"));
     msgBox.setText(i18n("Replace %1 selected duplicates with hardlinks to save space?",
-                        selectedFiles.count()));
+                        plan.replacements().count()));
     msgBox.setInformativeText(i18n("This will replace duplicate files with hardlinks to the same inode.\n"
                                    "The first file in each group will be kept as the original."));
     msgBox.setStandardButtons(QMessageBox::Yes | QMessageBox::Cancel);
@@ -581,97 +591,15 @@ void MainWindow::onHardlinkClicked()
         return;
     }
 
-    int successCount = 0;
-    int failCount = 0;
-    QStringList failedFiles;
-
-    m_statusLabel->setText(i18n("Creating hardlinks..."));
-    m_progressBar->setVisible(true);
-    m_progressBar->setRange(0, selectedFiles.count());
-
-    // Get all groups and process each group separately
-    auto results = m_duplicateFinder->getResults();
-    for (const auto &group : results) {
-        if (group.entries.isEmpty()) continue;
-
-        // Find the first file in this group that's not selected, or use first selected
-        QString originalFile;
-        QList<QString> filesToLink;
-
-        for (const auto &entry : group.entries) {
-            if (selectedFiles.contains(entry.path)) {
-                filesToLink.append(entry.path);
-            } else if (originalFile.isEmpty()) {
-                originalFile = entry.path;
-            }
-        }
-
-        // If all files in group are selected, use the first one as original
-        if (originalFile.isEmpty() && !filesToLink.isEmpty()) {
-            originalFile = filesToLink.takeFirst();
-        }
-
-        if (originalFile.isEmpty() || filesToLink.isEmpty()) {
-            continue;
-        }
-
-        // Create hardlinks
-        for (const QString &filePath : filesToLink) {
-            m_progressBar->setValue(successCount + failCount);
-            qApp->processEvents();
-
-            QFileInfo info(filePath);
-            if (!info.exists()) {
-                continue;
-            }
-
-            // Remove the file first, then create hardlink
-            if (QFile::remove(filePath)) {
-                if (QFile::link(originalFile, filePath)) {
-                    successCount++;
-                } else {
-                    failCount++;
-                    failedFiles.append(filePath + QLatin1String(" (link failed)"));
-                }
-            } else {
-                failCount++;
-                failedFiles.append(filePath + QLatin1String(" (remove failed)"));
-            }
-        }
-    }
-
-    m_progressBar->setVisible(false);
-    m_statusLabel->setText(i18n("Created %1 hardlinks, %2 failed", successCount, failCount));
-
-    if (failCount > 0) {
-        QString message = i18n("Failed to create hardlinks for %1 files:\n", failCount);
-        for (int i = 0; i < qMin(5, failedFiles.count()); ++i) {
-            message += failedFiles[i] + QLatin1String("\n");
-        }
-        if (failedFiles.count() > 5) {
-            message += i18n("... and %1 more", failedFiles.count() - 5);
-        }
-        QMessageBox::warning(this, i18n("Hardlink Errors"), message);
-    } else {
-        QMessageBox::information(this, i18n("Success"),
-            i18n("Successfully created %1 hardlinks.", successCount));
-    }
-
-    if (successCount > 0) {
-        m_resultsModel->clear();
-        m_resultsLabel->clear();
-        m_deleteButton->setEnabled(false);
-        m_moveButton->setEnabled(false);
-        m_hardlinkButton->setEnabled(false);
-        m_symlinkButton->setEnabled(false);
-    }
+    startFileOperation(FileOperationEngine::Operation::Hardlink, linkTasks(plan),
+                       i18n("Creating hardlinks..."));
 }
 
 void MainWindow::onSymlinkClicked()
 {
-    QList<QString> selectedFiles = m_resultsModel->getSelectedFiles();
+    const ReductionPlan plan = ReductionPlan::fromModel(*m_resultsModel);
 
-    if (selectedFiles.isEmpty()) {
+    if (plan.isEmpty()) {
         QMessageBox::information(this, i18n("No Selection"),
             i18n("Please select files to symlink."));
         return;
@@ -681,7 +609,7 @@ void MainWindow::onSymlinkClicked()
     msgBox.setIcon(QMessageBox::Information);
     msgBox.setWindowTitle(i18n("Symlink Duplicates"));
     msgBox.setText(i18n("Replace %1 selected duplicates with symbolic links?",
-                        selectedFiles.count()));
+                        plan.replacements().count()));
     msgBox.setInformativeText(i18n("This will replace duplicate files with symbolic links.\n"
                                    "The first file in each group will be kept as the target."));
     msgBox.setStandardButtons(QMessageBox::Yes | QMessageBox::Cancel);
@@ -691,86 +619,220 @@ void MainWindow::onSymlinkClicked()
         return;
     }
 
-    int successCount = 0;
-    int failCount = 0;
-    QStringList failedFiles;
+    startFileOperation(FileOperationEngine::Operation::Symlink, linkTasks(plan),
+                       i18n("Creating symbolic links..."));
+}
 
-    m_statusLabel->setText(i18n("Creating symbolic links..."));
-    m_progressBar->setVisible(true);
-    m_progressBar->setRange(0, selectedFiles.count());
+void MainWindow::onReflinkClicked()
+{
+    const ReductionPlan plan = ReductionPlan::fromModel(*m_resultsModel);
+
+    if (plan.isEmpty()) {
+        QMessageBox::information(this, i18n("No Selection"),
+            i18n("Please select files to reflink."));
+        return;
+    }
 
-    // Get all groups and process each group separately
-    auto results = m_duplicateFinder->getResults();
-    for (const auto &group : results) {
-        if (group.entries.isEmpty()) continue;
+    QMessageBox msgBox(this);
+    msgBox.setIcon(QMessageBox::Information);
+    msgBox.setWindowTitle(i18n("Reflink Duplicates"));
+    msgBox.setText(i18n("Replace %1 selected duplicates with reflinked copies to save %2?",
+                        plan.replacements().count(), formatSize(plan.reclaimableBytes())));
+    msgBox.setInformativeText(i18n("Each duplicate stays a separate file that shares its data with the original "
+                                   "until either is modified. This requires a filesystem with reflink support "
+                                   "such as Btrfs or XFS."));
+    msgBox.setStandardButtons(QMessageBox::Yes | QMessageBox::Cancel);
+    msgBox.setDefaultButton(QMessageBox::Yes);
+
+    if (msgBox.exec() != QMessageBox::Yes) {
+        return;
+    }
 
-        QString originalFile;
-        QList<QString> filesToLink;
+    startFileOperation(FileOperationEngine::Operation::Reflink, linkTasks(plan),
+                       i18n("Creating reflinks..."));
+}
 
-        for (const auto &entry : group.entries) {
-            if (selectedFiles.contains(entry.path)) {
-                filesToLink.append(entry.path);
-            } else if (originalFile.isEmpty()) {
-                originalFile = entry.path;
+QList<FileOperationEngine::Task> MainWindow::selectionTasks(const QString &target) const
+{
+    // Checked files are verified against the first unchecked file of their
+    // group; a group checked entirely only gets its metadata checked
+    QList<FileOperationEngine::Task> tasks;
+    tasks.reserve(m_resultsModel->selectedCount());
+    for (int groupIdx = 0; groupIdx < m_resultsModel->groupCount(); ++groupIdx) {
+        const DuplicateResults &batch = m_resultsModel->batchOf(groupIdx);
+        const int group = m_resultsModel->batchGroup(groupIdx);
+        const int begin = batch.groupBegin(group);
+        const int size = batch.groupSize(group);
+
+        QString reference;
+        for (int fileIdx = 0; fileIdx < size && reference.isEmpty(); ++fileIdx) {
+            if (!m_resultsModel->isChecked(groupIdx, fileIdx)) {
+                reference = batch.path(begin + fileIdx);
             }
         }
-
-        if (originalFile.isEmpty() && !filesToLink.isEmpty()) {
-            originalFile = filesToLink.takeFirst();
+        for (int fileIdx = 0; fileIdx < size; ++fileIdx) {
+            if (m_resultsModel->isChecked(groupIdx, fileIdx)) {
+                const int entry = begin + fileIdx;
+                tasks.append({batch.path(entry), target, reference, batch.size(entry), batch.modifiedDate(entry)});
+            }
         }
+    }
+    return tasks;
+}
 
-        if (originalFile.isEmpty() || filesToLink.isEmpty()) {
-            continue;
-        }
+QList<FileOperationEngine::Task> MainWindow::linkTasks(const ReductionPlan &plan) const
+{
+    QList<FileOperationEngine::Task> tasks;
+    tasks.reserve(plan.replacements().count());
+    for (const ReductionPlan::Replacement &replacement : plan.replacements()) {
+        tasks.append({replacement.duplicate, replacement.original, replacement.original,
+                      replacement.size, replacement.modifiedDate});
+    }
+    return tasks;
+}
+
+void MainWindow::startFileOperation(FileOperationEngine::Operation operation,
+                                    const QList<FileOperationEngine::Task> &tasks,
+                                    const QString &status)
+{
+    m_fileOperationStatus = status;
+    m_statusLabel->setText(status);
+    m_progressBar->setVisible(true);
+    m_progressBar->setRange(0, tasks.count());
+    m_progressBar->setValue(0);
 
-        for (const QString &filePath : filesToLink) {
-            m_progressBar->setValue(successCount + failCount);
-            qApp->processEvents();
+    // Stop cancels the operation while it runs
+    setFileActionsEnabled(false);
+    m_scanButton->setEnabled(false);
+    m_stopButton->setEnabled(true);
 
-            QFileInfo info(filePath);
-            if (!info.exists()) {
-                continue;
-            }
+    m_fileOperations->setVerifyContents(m_verifyCheck->isChecked());
+    m_fileOperations->start(operation, tasks);
+}
 
-            if (QFile::remove(filePath)) {
-                if (QFile::link(originalFile, filePath)) {
-                    successCount++;
-                } else {
-                    failCount++;
-                    failedFiles.append(filePath + QLatin1String(" (symlink failed)"));
-                }
-            } else {
-                failCount++;
-                failedFiles.append(filePath + QLatin1String(" (remove failed)"));
-            }
-        }
+void MainWindow::onFileOperationStageChanged(FileOperationEngine::Stage stage)
+{
+    if (stage == FileOperationEngine::Stage::Verifying) {
+        m_statusLabel->setText(i18n("Verifying files..."));
+    } else {
+        m_statusLabel->setText(m_fileOperationStatus);
     }
+    m_progressBar->setValue(0);
+}
 
+void MainWindow::onFileOperationProgress(int done, int total)
+{
+    m_progressBar->setRange(0, total);
+    m_progressBar->setValue(done);
+}
+
+void MainWindow::onFileOperationFinished(const FileOperationEngine::Report &report)
+{
+    Trace::Span span("MainWindow::onFileOperationFinished");
     m_progressBar->setVisible(false);
-    m_statusLabel->setText(i18n("Created %1 symbolic links, %2 failed", successCount, failCount));
+    m_scanButton->setEnabled(m_currentTool == 0);
+    m_stopButton->setEnabled(false);
 
-    if (failCount > 0) {
-        QString message = i18n("Failed to create symbolic links for %1 files:\n", failCount);
-        for (int i = 0; i < qMin(5, failedFiles.count()); ++i) {
-            message += failedFiles[i] + QLatin1String("\n");
+    const int successCount = report.count(FileOperationEngine::Outcome::Done);
+    const int failCount = report.count(FileOperationEngine::Outcome::Failed);
+    const int changedCount = report.count(FileOperationEngine::Outcome::Changed);
+
+    QString status;
+    QString errorIntro;
+    QString errorTitle;
+    QString successText;
+    switch (report.operation) {
+    case FileOperationEngine::Operation::Trash:
+    case FileOperationEngine::Operation::Delete:
+        status = i18n("Deleted %1 files, %2 failed", successCount, failCount);
+        errorIntro = i18n("Failed to delete %1 files:\n", failCount);
+        errorTitle = i18n("Deletion Errors");
+        successText = i18n("Successfully deleted %1 files.", successCount);
+        break;
+    case FileOperationEngine::Operation::Move:
+        status = i18n("Moved %1 files, %2 failed", successCount, failCount);
+        errorIntro = i18n("Failed to move %1 files:\n", failCount);
+        errorTitle = i18n("Move Errors");
+        successText = i18n("Successfully moved %1 files.", successCount);
+        break;
+    case FileOperationEngine::Operation::Hardlink:
+        status = i18n("Created %1 hardlinks, %2 failed", successCount, failCount);
+        errorIntro = i18n("Failed to create hardlinks for %1 files:\n", failCount);
+        errorTitle = i18n("Hardlink Errors");
+        successText = i18n("Successfully created %1 hardlinks.", successCount);
+        break;
+    case FileOperationEngine::Operation::Symlink:
+        status = i18n("Created %1 symbolic links, %2 failed", successCount, failCount);
+        errorIntro = i18n("Failed to create symbolic links for %1 files:\n", failCount);
+        errorTitle = i18n("Symlink Errors");
+        successText = i18n("Successfully created %1 symbolic links.", successCount);
+        break;
+    case FileOperationEngine::Operation::Reflink:
+        status = i18n("Created %1 reflinks, %2 failed", successCount, failCount);
+        errorIntro = i18n("Failed to create reflinks for %1 files:\n", failCount);
+        errorTitle = i18n("Reflink Errors");
+        successText = i18n("Successfully created %1 reflinks.", successCount);
+        break;
+    }
+
+    if (changedCount > 0) {
+        status += QLatin1String(" ") + i18n("(%1 changed since the scan)", changedCount);
+    }
+    if (report.cancelled) {
+        status += QLatin1String(" ") + i18n("(cancelled)");
+    }
+    m_statusLabel->setText(status);
+
+    if (failCount > 0 || changedCount > 0) {
+        QString message;
+        if (failCount > 0) {
+            message = errorIntro;
+            int listed = 0;
+            for (const FileOperationEngine::FileResult &file : report.files) {
+                if (file.outcome != FileOperationEngine::Outcome::Failed) {
+                    continue;
+                }
+                if (listed++ == 5) {
+                    message += i18n("... and %1 more", failCount - 5);
+                    break;
+                }
+                message += i18n("%1 (%2)", file.path, file.error) + QLatin1String("\n");
+            }
         }
-        if (failedFiles.count() > 5) {
-            message += i18n("... and %1 more", failedFiles.count() - 5);
+        if (changedCount > 0) {
+            message += i18np("%1 file was left untouched because it is no longer identical to the file kept in its group.",
+                             "%1 files were left untouched because they are no longer identical to the files kept in their groups.",
+                             changedCount);
         }
-        QMessageBox::warning(this, i18n("Symlink Errors"), message);
-    } else {
-        QMessageBox::information(this, i18n("Success"),
-            i18n("Successfully created %1 symbolic links.", successCount));
+        QMessageBox::warning(this, errorTitle, message);
+    } else if (successCount > 0 && !report.cancelled) {
+        QMessageBox::information(this, i18n("Success"), successText);
     }
 
-    if (successCount > 0) {
-        m_resultsModel->clear();
-        m_resultsLabel->clear();
-        m_deleteButton->setEnabled(false);
-        m_moveButton->setEnabled(false);
-        m_hardlinkButton->setEnabled(false);
-        m_symlinkButton->setEnabled(false);
+    // Files that are gone or now links leave their groups; files that failed
+    // or changed since the scan stay for another try
+    QStringList processed;
+    for (const FileOperationEngine::FileResult &file : report.files) {
+        if (file.outcome == FileOperationEngine::Outcome::Done
+            || file.outcome == FileOperationEngine::Outcome::Missing) {
+            processed.append(file.path);
+        }
     }
+    if (!processed.isEmpty()) {
+        m_resultsModel->removeFiles(processed);
+        m_watcher->setGroupSizes(m_resultsModel->groupSizes());
+        updateResultsLabel();
+    }
+    setFileActionsEnabled(m_resultsModel->groupCount() > 0);
+}
+
+void MainWindow::setFileActionsEnabled(bool enabled)
+{
+    m_deleteButton->setEnabled(enabled);
+    m_moveButton->setEnabled(enabled);
+    m_hardlinkButton->setEnabled(enabled);
+    m_symlinkButton->setEnabled(enabled);
+    m_reflinkButton->setEnabled(enabled);
 }
 
 void MainWindow::onSelectAllClicked()
@@ -788,6 +850,43 @@ void MainWindow::onInvertSelectionClicked()
     m_resultsModel->invertSelection();
 }
 
+void MainWindow::onAutoSelectDirectory()
+{
+    QString dir = QFileDialog::getExistingDirectory(this, i18n("Select Directory to Keep"));
+    if (!dir.isEmpty()) {
+        m_resultsModel->autoSelect(DuplicateModel::KeepRule::InDirectory, dir);
+    }
+}
+
+void MainWindow::onAutoSelectPattern()
+{
+    bool ok = false;
+    QString pattern = QInputDialog::getText(this, i18n("Keep Files Matching Pattern"),
+        i18n("Regular expression matched against the full path:"),
+        QLineEdit::Normal, QString(), &ok);
+    if (!ok || pattern.isEmpty()) {
+        return;
+    }
+
+    if (!m_resultsModel->autoSelect(DuplicateModel::KeepRule::MatchingPattern, pattern)) {
+        QMessageBox::warning(this, i18n("Invalid Pattern"),
+            i18n("\"%1\" is not a valid regular expression.", pattern));
+    }
+}
+
+void MainWindow::updateSelectionStatus()
+{
+    // Both figures are maintained by the model, so this stays cheap per click
+    const qsizetype count = m_resultsModel->selectedCount();
+    if (count == 0) {
+        m_selectionLabel->clear();
+        return;
+    }
+
+    m_selectionLabel->setText(i18np("%1 file / %2 selected", "%1 files / %2 selected",
+                                    count, formatSize(m_resultsModel->selectedSize())));
+}
+
 void MainWindow::onScanStarted()
 {
     updateUiState(true);
@@ -796,11 +895,38 @@ void MainWindow::onScanStarted()
     m_progressBar->setRange(0, 0); // Indeterminate
 }
 
-void MainWindow::onScanProgress(int current, int total)
+void MainWindow::onScanProgress(const DuplicateFinder::ScanProgress &progress)
 {
+    QString text = stageDescription(progress.stage);
+    if (progress.stageCount > 0) {
+        text = i18n("Stage %1/%2: %3", progress.stageIndex + 1, progress.stageCount, text);
+    }
+
+    if (progress.entriesToCheck > 0) {
+        text += QLatin1String(" ") + i18n("(%1 of %2)", progress.entriesChecked, progress.entriesToCheck);
+    } else if (progress.entriesChecked > 0) {
+        text += QLatin1String(" ") + i18n("(%1)", progress.entriesChecked);
+    }
+
+    if (progress.bytesToCheck > 0) {
+        text += QLatin1String(" ") + i18n("%1 of %2", formatSize(progress.bytesChecked), formatSize(progress.bytesToCheck));
+    }
+
+    m_statusLabel->setText(text);
+
+    // Prefer byte progress while hashing, fall back to entry counts, else stay indeterminate
+    quint64 done = progress.entriesChecked;
+    quint64 total = progress.entriesToCheck;
+    if (progress.bytesToCheck > 0) {
+        done = progress.bytesChecked;
+        total = progress.bytesToCheck;
+    }
+
     if (total > 0) {
-        m_progressBar->setRange(0, total);
-        m_progressBar->setValue(current);
+        m_progressBar->setRange(0, 1000);
+        m_progressBar->setValue(static_cast<int>(qMin<quint64>(done, total) * 1000 / total));
+    } else {
+        m_progressBar->setRange(0, 0);
     }
 }
 
@@ -809,40 +935,115 @@ void MainWindow::onScanFinished(bool success)
     updateUiState(false);
     m_progressBar->setVisible(false);
 
+    // czkawka keeps the cache where this scan loaded it until restart
+    if (DuplicateFinder::isCacheDirectoryFixed() && m_cacheDirEdit->isEnabled()) {
+        m_cacheDirEdit->setEnabled(false);
+        m_cacheDirButton->setEnabled(false);
+        m_cacheDirEdit->setToolTip(i18n("Fixed until Deduplikate is restarted, a scan already uses the cache here"));
+    }
+
     if (success) {
-        m_statusLabel->setText(i18n("Scan completed"));
+        const qint64 totalTimeMs = m_duplicateFinder->getScanStatistics().totalTimeUs / 1000;
+        m_statusLabel->setText(i18n("Scan completed in %1 s", QLocale().toString(totalTimeMs / 1000.0, 'f', 1)));
     } else {
         m_statusLabel->setText(i18n("Scan stopped or failed"));
     }
 }
 
-void MainWindow::onResultsReady(int groupCount, quint64 wastedSpace)
+void MainWindow::onResultsReady(int groupCount, quint64 wastedSpace, const DuplicateFinder::ScanStatistics &statistics)
+{
+    // The model has already been filled batch by batch through groupsAvailable
+    QString wastedSpaceStr = formatSize(wastedSpace);
+
+    QString resultsText = i18n("Found %1 duplicate groups, wasted space: %2", groupCount, wastedSpaceStr);
+
+    const DuplicateFinder::CacheStats &cacheStats = statistics.cache;
+    if (cacheStats.candidates > 0) {
+        resultsText += QLatin1String(" - ")
+            + i18n("cache: %1 of %2 files reused, about %3 not reread",
+                   cacheStats.hits, cacheStats.candidates, formatSize(cacheStats.bytesSaved));
+    }
+    m_resultsLabel->setText(resultsText);
+    m_resultsLabel->setToolTip(statisticsToolTip(statistics));
+
+    setFileActionsEnabled(groupCount > 0);
+
+    // Groups streamed in during the scan were appended unsorted
+    m_resultsView->sortByColumn(m_resultsView->header()->sortIndicatorSection(),
+                                m_resultsView->header()->sortIndicatorOrder());
+
+    // Expanding everything would lay out every row; only open what is on screen
+    expandVisibleGroups();
+
+    m_hasResults = true;
+    if (m_watchCheck->isChecked()) {
+        startWatching();
+    }
+}
+
+void MainWindow::startWatching()
 {
-    // Populate the model with results
-    m_resultsModel->setResults(m_duplicateFinder->getResults());
+    // Only hashes tell whether a changed file still belongs to its group
+    if (!m_hasResults || m_lastScanParams.checkMethod != 0) {
+        return;
+    }
 
-    QString wastedSpaceStr;
-    if (wastedSpace > 1024 * 1024 * 1024) {
-        wastedSpaceStr = QString::number(wastedSpace / (1024.0 * 1024.0 * 1024.0), 'f', 2) + QLatin1String(" GB");
-    } else if (wastedSpace > 1024 * 1024) {
-        wastedSpaceStr = QString::number(wastedSpace / (1024.0 * 1024.0), 'f', 2) + QLatin1String(" MB");
-    } else if (wastedSpace > 1024) {
-        wastedSpaceStr = QString::number(wastedSpace / 1024.0, 'f', 2) + QLatin1String(" KB");
+    if (m_watcher->start(m_lastScanParams)) {
+        m_watcher->setGroupSizes(m_resultsModel->groupSizes());
     } else {
-        wastedSpaceStr = QString::number(wastedSpace) + QLatin1String(" bytes");
+        m_statusLabel->setText(i18n("Cannot watch the scanned directories for changes"));
+    }
+}
+
+void MainWindow::onWatchToggled(bool checked)
+{
+    if (checked) {
+        startWatching();
+    } else {
+        m_watcher->stop();
+    }
+}
+
+void MainWindow::onWatchedFilesChanged(const QStringList &changedPaths,
+                                       const QList<DuplicateFinder::DuplicateEntry> &current)
+{
+    m_resultsModel->updateFiles(changedPaths, current, m_lastScanParams.ignoreHardLinks);
+    m_watcher->setGroupSizes(m_resultsModel->groupSizes());
+    updateResultsLabel();
+    if (!m_fileOperations->isRunning()) {
+        setFileActionsEnabled(m_resultsModel->groupCount() > 0);
     }
+}
+
+void MainWindow::updateResultsLabel()
+{
+    m_resultsLabel->setText(i18n("%1 duplicate groups left, wasted space: %2",
+                                 m_resultsModel->groupCount(), formatSize(m_resultsModel->wastedSpace())));
+}
 
-    m_resultsLabel->setText(i18n("Found %1 duplicate groups, wasted space: %2",
-                                  groupCount, wastedSpaceStr));
+void MainWindow::onChangesMissed(const QString &reason)
+{
+    m_statusLabel->setText(i18n("%1. Rescan to bring the results up to date.", reason));
+}
 
-    bool hasResults = (groupCount > 0);
-    m_deleteButton->setEnabled(hasResults);
-    m_moveButton->setEnabled(hasResults);
-    m_hardlinkButton->setEnabled(hasResults);
-    m_symlinkButton->setEnabled(hasResults);
+void MainWindow::expandVisibleGroups()
+{
+    // Bounds the work even with a very tall viewport or tiny rows
+    constexpr int MaxExpandedGroups = 200;
 
-    // Expand all groups to show files
-    m_resultsView->expandAll();
+    QModelIndex group = m_resultsView->indexAt(QPoint(0, 0));
+    if (group.parent().isValid()) {
+        group = group.parent();
+    }
+
+    const int viewportHeight = m_resultsView->viewport()->height();
+    for (int expanded = 0; group.isValid() && expanded < MaxExpandedGroups; ++expanded) {
+        if (m_resultsView->visualRect(group).top() > viewportHeight) {
+            break;
+        }
+        m_resultsView->expand(group);
+        group = group.sibling(group.row() + 1, 0);
+    }
 }
 
 void MainWindow::updateUiState(bool scanning)
@@ -853,3 +1054,69 @@ void MainWindow::updateUiState(bool scanning)
     m_settingsPanel->setEnabled(!scanning);
     m_toolList->setEnabled(!scanning);
 }
+
+QString MainWindow::formatSize(quint64 size) const
+{
+    if (size > 1024 * 1024 * 1024) {
+        return QString::number(size / (1024.0 * 1024.0 * 1024.0), 'f', 2) + QLatin1String(" GB");
+    } else if (size > 1024 * 1024) {
+        return QString::number(size / (1024.0 * 1024.0), 'f', 2) + QLatin1String(" MB");
+    } else if (size > 1024) {
+        return QString::number(size / 1024.0, 'f', 2) + QLatin1String(" KB");
+    } else {
+        return QString::number(size) + QLatin1String(" bytes");
+    }
+}
+
+QString MainWindow::stageDescription(DuplicateFinder::ScanStage stage) const
+{
+    switch (stage) {
+    case DuplicateFinder::ScanStage::CollectingFiles:
+        return i18n("Collecting files");
+    case DuplicateFinder::ScanStage::ScanningName:
+        return i18n("Grouping by name");
+    case DuplicateFinder::ScanStage::ScanningSizeName:
+        return i18n("Grouping by size and name");
+    case DuplicateFinder::ScanStage::ScanningSize:
+        return i18n("Grouping by size");
+    case DuplicateFinder::ScanStage::PreHashCacheLoading:
+    case DuplicateFinder::ScanStage::FullHashCacheLoading:
+        return i18n("Loading hash cache");
+    case DuplicateFinder::ScanStage::PreHashing:
+        return i18n("Calculating partial hashes");
+    case DuplicateFinder::ScanStage::PreHashCacheSaving:
+    case DuplicateFinder::ScanStage::FullHashCacheSaving:
+        return i18n("Saving hash cache");
+    case DuplicateFinder::ScanStage::FullHashing:
+        return i18n("Calculating full hashes");
+    case DuplicateFinder::ScanStage::FetchingResults:
+        return i18n("Loading results");
+    case DuplicateFinder::ScanStage::Other:
+        break;
+    }
+    return i18n("Scanning...");
+}
+
+QString MainWindow::statisticsToolTip(const DuplicateFinder::ScanStatistics &statistics) const
+{
+    const QLocale locale;
+    auto milliseconds = [&locale](qint64 us) {
+        return i18n("%1 ms", locale.toString(us / 1000.0, 'f', 1));
+    };
+
+    QString rows = QStringLiteral("<tr><th align=\"left\">%1</th><th>%2</th><th>%3</th><th>%4</th><th>%5</th><th>%6</th></tr>")
+        .arg(i18n("Stage"), i18n("Time"), i18n("Files"), i18n("Data"), i18n("Files/s"), i18n("Data/s"));
+    for (const DuplicateFinder::StageStatistics &stage : statistics.stages) {
+        rows += QStringLiteral("<tr><td>%1</td><td align=\"right\">%2</td><td align=\"right\">%3</td>"
+                               "<td align=\"right\">%4</td><td align=\"right\">%5</td><td align=\"right\">%6</td></tr>")
+            .arg(stageDescription(stage.stage), milliseconds(stage.wallTimeUs), locale.toString(stage.files),
+                 formatSize(stage.bytes), locale.toString(stage.filesPerSecond(), 'f', 0),
+                 formatSize(quint64(stage.bytesPerSecond())));
+    }
+    rows += QStringLiteral("<tr><td>%1</td><td align=\"right\">%2</td></tr>")
+        .arg(i18n("Building the results view"), milliseconds(statistics.receiverTimeUs));
+    rows += QStringLiteral("<tr><th align=\"left\">%1</th><th align=\"right\">%2</th></tr>")
+        .arg(i18n("Total"), milliseconds(statistics.totalTimeUs));
+
+    return QLatin1String("<table>") + rows + QLatin1String("</table>");
+}
@@ -13,9 +13,14 @@
 #include <QProgressBar>
 #include <QLabel>
 #include <QGroupBox>
+#include <QLineEdit>
+
+#include "duplicatefinder.h"
+#include "fileoperationengine.h"
 
-class DuplicateFinder;
 class DuplicateModel;
+class DuplicateWatcher;
+class ReductionPlan;
 
 class MainWindow : public QMainWindow
 {
@@ -33,14 +38,26 @@ private Q_SLOTS:
     void onMoveClicked();
     void onHardlinkClicked();
     void onSymlinkClicked();
+    void onReflinkClicked();
     void onSelectAllClicked();
     void onSelectNoneClicked();
     void onInvertSelectionClicked();
+    void expandVisibleGroups();
+    void updateSelectionStatus();
+    void onAutoSelectDirectory();
+    void onAutoSelectPattern();
 
     void onScanStarted();
-    void onScanProgress(int current, int total);
+    void onScanProgress(const DuplicateFinder::ScanProgress &progress);
     void onScanFinished(bool success);
-    void onResultsReady(int groupCount, quint64 wastedSpace);
+    void onResultsReady(int groupCount, quint64 wastedSpace, const DuplicateFinder::ScanStatistics &statistics);
+    void onWatchToggled(bool checked);
+    void onWatchedFilesChanged(const QStringList &changedPaths, const QList<DuplicateFinder::DuplicateEntry> &current);
+    void onChangesMissed(const QString &reason);
+
+    void onFileOperationStageChanged(FileOperationEngine::Stage stage);
+    void onFileOperationProgress(int done, int total);
+    void onFileOperationFinished(const FileOperationEngine::Report &report);
 
 private:
     void setupUi();
@@ -50,6 +67,17 @@ private:
     void createRightPanel();
     void createBottomPanel();
     void updateUiState(bool scanning);
+    void setFileActionsEnabled(bool enabled);
+    void startWatching();
+    void updateResultsLabel();
+    QList<FileOperationEngine::Task> selectionTasks(const QString &target) const;
+    QList<FileOperationEngine::Task> linkTasks(const ReductionPlan &plan) const;
+    void startFileOperation(FileOperationEngine::Operation operation,
+                            const QList<FileOperationEngine::Task> &tasks,
+                            const QString &status);
+    QString formatSize(quint64 size) const;
+    QString stageDescription(DuplicateFinder::ScanStage stage) const;
+    QString statisticsToolTip(const DuplicateFinder::ScanStatistics &statistics) const;
 
     // UI Components
     QSplitter *m_mainSplitter;
@@ -69,6 +97,17 @@ private:
     QCheckBox *m_recursiveCheck;
     QCheckBox *m_ignoreHardLinksCheck;
     QCheckBox *m_useCacheCheck;
+    QCheckBox *m_incrementalCheck;
+    QCheckBox *m_watchCheck;
+    QCheckBox *m_verifyCheck;
+    QGroupBox *m_cacheGroup;
+    QSpinBox *m_cacheMinSizeSpin;
+    QSpinBox *m_prehashCacheMinSizeSpin;
+    QLineEdit *m_cacheDirEdit;
+    QPushButton *m_cacheDirButton;
+    QComboBox *m_priorityCombo;
+    QSpinBox *m_cpuThreadsSpin;
+    QSpinBox *m_ioThreadsSpin;
     QSpinBox *m_minSizeSpin;
     QSpinBox *m_maxSizeSpin;
     QListWidget *m_includePathsList;
@@ -86,15 +125,23 @@ private:
     QPushButton *m_moveButton;
     QPushButton *m_hardlinkButton;
     QPushButton *m_symlinkButton;
+    QPushButton *m_reflinkButton;
     QPushButton *m_selectAllButton;
     QPushButton *m_selectNoneButton;
     QPushButton *m_invertSelectionButton;
+    QPushButton *m_autoSelectButton;
     QProgressBar *m_progressBar;
     QLabel *m_statusLabel;
     QLabel *m_resultsLabel;
+    QLabel *m_selectionLabel;
 
     // Business logic
     DuplicateFinder *m_duplicateFinder;
+    DuplicateWatcher *m_watcher;
+    DuplicateFinder::ScanParameters m_lastScanParams;
+    bool m_hasResults; // The model holds the complete results of m_lastScanParams
+    FileOperationEngine *m_fileOperations;
+    QString m_fileOperationStatus;
 
     // State
     bool m_scanning;
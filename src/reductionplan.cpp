@@ -0,0 +1,64 @@
+#include "reductionplan.h"
+#include "duplicatemodel.h"
+
+#include <utility>
+
+template<typename IsSelected>
+void ReductionPlan::addGroup(const DuplicateResults &batch, int group, IsSelected isSelected)
+{
+    const int begin = batch.groupBegin(group);
+    const int size = batch.groupSize(group);
+
+    QList<int> selected;
+    int original = -1;
+    for (int fileIdx = 0; fileIdx < size; ++fileIdx) {
+        if (isSelected(fileIdx)) {
+            selected.append(fileIdx);
+        } else if (original < 0) {
+            original = fileIdx;
+        }
+    }
+
+    // If every file is selected, keep the first one
+    if (original < 0 && !selected.isEmpty()) {
+        original = selected.takeFirst();
+    }
+
+    if (original < 0 || selected.isEmpty()) {
+        return;
+    }
+
+    const QString originalPath = batch.path(begin + original);
+    for (int fileIdx : std::as_const(selected)) {
+        const quint64 fileSize = batch.size(begin + fileIdx);
+        m_replacements.append({batch.path(begin + fileIdx), originalPath, fileSize,
+                               batch.modifiedDate(begin + fileIdx)});
+        m_reclaimableBytes += fileSize;
+    }
+}
+
+ReductionPlan ReductionPlan::fromModel(const DuplicateModel &model)
+{
+    ReductionPlan plan;
+    for (int groupIdx = 0; groupIdx < model.groupCount(); ++groupIdx) {
+        plan.addGroup(model.batchOf(groupIdx), model.batchGroup(groupIdx), [&](int fileIdx) {
+            return model.isChecked(groupIdx, fileIdx);
+        });
+    }
+    return plan;
+}
+
+const QList<ReductionPlan::Replacement> &ReductionPlan::replacements() const
+{
+    return m_replacements;
+}
+
+bool ReductionPlan::isEmpty() const
+{
+    return m_replacements.isEmpty();
+}
+
+quint64 ReductionPlan::reclaimableBytes() const
+{
+    return m_reclaimableBytes;
+}
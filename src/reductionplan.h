@@ -0,0 +1,42 @@
+#ifndef REDUCTIONPLAN_H
+#define REDUCTIONPLAN_H
+
+#include <QList>
+#include <QString>
+#include "duplicateresults.h"
+
+class DuplicateModel;
+
+// Decides, group by group, which checked duplicates get replaced and which
+// file each of them is replaced with.
+//
+// In every group the first unchecked file is kept as the original; if every
+// file is checked, the first one is kept instead. Planning is linear in the
+// number of files.
+class ReductionPlan
+{
+public:
+    struct Replacement {
+        QString duplicate;
+        QString original;
+        quint64 size = 0;
+        quint64 modifiedDate = 0; // Of the duplicate, as recorded by the scan
+    };
+
+    // Reads check state straight from the model
+    static ReductionPlan fromModel(const DuplicateModel &model);
+
+    const QList<Replacement> &replacements() const;
+    bool isEmpty() const;
+    quint64 reclaimableBytes() const;
+
+private:
+    // Appends the replacements of one group; isSelected(fileIdx) is queried once per file
+    template<typename IsSelected>
+    void addGroup(const DuplicateResults &batch, int group, IsSelected isSelected);
+
+    QList<Replacement> m_replacements;
+    quint64 m_reclaimableBytes = 0;
+};
+
+#endif // REDUCTIONPLAN_H
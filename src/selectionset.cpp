@@ -0,0 +1,84 @@
+#include "selectionset.h"
+
+qsizetype SelectionSet::size() const
+{
+    return m_size;
+}
+
+qsizetype SelectionSet::count() const
+{
+    return m_default ? m_size - m_exceptions : m_exceptions;
+}
+
+void SelectionSet::grow(qsizetype count)
+{
+    const qsizetype first = m_size;
+    m_size += count;
+    const qsizetype words = (m_size + 63) / 64;
+    m_words.resize(words);
+    m_wordGenerations.resize(words);
+
+    // New files start unchecked even when everything else is checked
+    if (m_default) {
+        for (qsizetype bit = first; bit < m_size; ++bit) {
+            toggle(bit);
+        }
+    }
+}
+
+void SelectionSet::clear()
+{
+    m_words.clear();
+    m_wordGenerations.clear();
+    m_generation = 1;
+    m_default = false;
+    m_size = 0;
+    m_exceptions = 0;
+}
+
+bool SelectionSet::test(qsizetype bit) const
+{
+    const qsizetype word = bit >> 6;
+    const bool exception = m_wordGenerations[word] == m_generation
+        && (m_words[word] >> (bit & 63)) & 1;
+    return m_default != exception;
+}
+
+bool SelectionSet::set(qsizetype bit, bool value)
+{
+    if (test(bit) == value) {
+        return false;
+    }
+    toggle(bit);
+    return true;
+}
+
+void SelectionSet::setAll(bool value)
+{
+    m_default = value;
+    m_exceptions = 0;
+
+    // Words stamped with an old generation read as zero
+    if (++m_generation == 0) {
+        m_wordGenerations.fill(0);
+        m_generation = 1;
+    }
+}
+
+void SelectionSet::invert()
+{
+    m_default = !m_default;
+}
+
+void SelectionSet::toggle(qsizetype bit)
+{
+    const qsizetype word = bit >> 6;
+    if (m_wordGenerations[word] != m_generation) {
+        m_words[word] = 0;
+        m_wordGenerations[word] = m_generation;
+    }
+
+    const quint64 mask = quint64(1) << (bit & 63);
+    m_words[word] ^= mask;
+    m_exceptions += (m_words[word] & mask) ? 1 : -1;
+}
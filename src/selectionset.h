@@ -0,0 +1,42 @@
+#ifndef SELECTIONSET_H
+#define SELECTIONSET_H
+
+#include <QList>
+#include <QtGlobal>
+
+// Check state for a flat range of files.
+//
+// Every file has a default state shared by all files plus an exception bit.
+// Exception bits live in 64-bit words that are only valid while their
+// generation matches the set's generation, so setAll() and invert() are O(1):
+// they flip the default and, for setAll(), bump the generation to drop every
+// exception at once.
+class SelectionSet
+{
+public:
+    qsizetype size() const;
+    qsizetype count() const;
+
+    // Appends unset bits
+    void grow(qsizetype count);
+    void clear();
+
+    bool test(qsizetype bit) const;
+    // Returns whether the bit changed
+    bool set(qsizetype bit, bool value);
+
+    void setAll(bool value);
+    void invert();
+
+private:
+    void toggle(qsizetype bit);
+
+    QList<quint64> m_words;
+    QList<quint32> m_wordGenerations;
+    quint32 m_generation = 1;
+    bool m_default = false;
+    qsizetype m_size = 0;
+    qsizetype m_exceptions = 0;
+};
+
+#endif // SELECTIONSET_H
@@ -0,0 +1,179 @@
+#include "trace.h"
+#include "czkawka_bridge/czkawka_bridge.h"
+#include <QDebug>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+
+#include <chrono>
+#include <pthread.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+std::atomic<bool> Trace::s_enabled(false);
+
+namespace {
+struct Event {
+    const char *name;
+    qint64 startNs;
+    qint64 durationNs;
+    pid_t thread;
+};
+
+// Guards everything below; only taken while a trace is recording
+QMutex s_mutex;
+QString s_path;
+qint64 s_originNs = 0;
+std::vector<Event> s_events;
+QHash<pid_t, QByteArray> s_threadNames;
+
+// Bridge spans still open on this thread, innermost last
+thread_local std::vector<std::pair<const char *, qint64>> t_bridgeSpans;
+
+void appendJsonString(QByteArray &out, const char *text)
+{
+    out += '"';
+    for (const char *c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out += '\\';
+            out += *c;
+        } else if (static_cast<unsigned char>(*c) < 0x20) {
+            out += "\\u00";
+            out += QByteArray::number(static_cast<unsigned char>(*c), 16).rightJustified(2, '0');
+        } else {
+            out += *c;
+        }
+    }
+    out += '"';
+}
+
+void bridgeSpan(const char *name, bool begin, void *)
+{
+    if (begin) {
+        t_bridgeSpans.emplace_back(name, Trace::now());
+        return;
+    }
+
+    // Spans opened before the trace was restarted are dropped with the ones inside them
+    for (auto it = t_bridgeSpans.end(); it != t_bridgeSpans.begin();) {
+        --it;
+        if (it->first == name) {
+            const qint64 startNs = it->second;
+            t_bridgeSpans.erase(it, t_bridgeSpans.end());
+            Trace::complete(name, startNs);
+            return;
+        }
+    }
+}
+}
+
+bool Trace::start(const QString &path)
+{
+    // Fails now rather than after the traced work
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    QMutexLocker locker(&s_mutex);
+    s_path = path;
+    s_originNs = now();
+    s_events.clear();
+    s_threadNames.clear();
+    s_enabled.store(true, std::memory_order_relaxed);
+    czkawka_set_trace_callback(bridgeSpan, nullptr);
+    return true;
+}
+
+bool Trace::stop(QString *error)
+{
+    czkawka_set_trace_callback(nullptr, nullptr);
+
+    QMutexLocker locker(&s_mutex);
+    if (!s_enabled.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    s_enabled.store(false, std::memory_order_relaxed);
+
+    const QByteArray pid = QByteArray::number(qint64(::getpid()));
+    QByteArray out;
+    out.reserve(qsizetype(s_events.size()) * 96 + s_threadNames.size() * 96 + 64);
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    bool first = true;
+    for (auto it = s_threadNames.cbegin(); it != s_threadNames.cend(); ++it) {
+        out += first ? "\n" : ",\n";
+        first = false;
+        out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + QByteArray::number(it.key())
+            + ",\"args\":{\"name\":";
+        appendJsonString(out, it.value().constData());
+        out += "}}";
+    }
+
+    // Microseconds, as the format expects, with the nanoseconds kept as decimals
+    for (const Event &event : s_events) {
+        out += first ? "\n" : ",\n";
+        first = false;
+        out += "{\"name\":";
+        appendJsonString(out, event.name);
+        out += ",\"ph\":\"X\",\"pid\":" + pid + ",\"tid\":" + QByteArray::number(event.thread)
+            + ",\"ts\":" + QByteArray::number((event.startNs - s_originNs) / 1000.0, 'f', 3)
+            + ",\"dur\":" + QByteArray::number(event.durationNs / 1000.0, 'f', 3) + '}';
+    }
+    out += "\n]}\n";
+
+    s_events.clear();
+    s_events.shrink_to_fit();
+    s_threadNames.clear();
+
+    QFile file(s_path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(out) != out.size() || !file.flush()) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
+
+void Trace::startFromEnvironment()
+{
+    const QString path = qEnvironmentVariable("DEDUPLIKATE_TRACE");
+    if (!path.isEmpty() && !start(path)) {
+        qWarning() << "Cannot write trace file" << path;
+    }
+}
+
+void Trace::finish()
+{
+    QString error;
+    if (isEnabled() && !stop(&error)) {
+        qWarning() << "Cannot write trace file" << s_path << error;
+    }
+}
+
+qint64 Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::complete(const char *name, qint64 startNs)
+{
+    const qint64 endNs = now();
+    const pid_t thread = ::gettid();
+
+    QMutexLocker locker(&s_mutex);
+    // Spans that end after stop(), or began before start(), belong to no trace
+    if (!s_enabled.load(std::memory_order_relaxed) || startNs < s_originNs) {
+        return;
+    }
+
+    if (!s_threadNames.contains(thread)) {
+        char threadName[16] = {};
+        ::pthread_getname_np(::pthread_self(), threadName, sizeof(threadName));
+        s_threadNames.insert(thread, QByteArray(threadName));
+    }
+    s_events.push_back({name, startNs, endNs - startNs, thread});
+}
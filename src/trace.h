@@ -0,0 +1,67 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+
+// Opt-in spans of the scan, the model and file operations, written as a
+// Chrome trace that Perfetto (ui.perfetto.dev) opens offline.
+//
+// While no trace is recording, a span costs one relaxed load and a branch.
+// Spans are recorded as complete events when they end, so a span cut short
+// by an early return is simply missing instead of unbalancing the others.
+// The bridge reports its own spans, and czkawka's stages, through a callback.
+class Trace
+{
+public:
+    // Starts recording to path, which is written by stop()
+    static bool start(const QString &path);
+    // Writes the events recorded so far and stops recording
+    static bool stop(QString *error = nullptr);
+
+    // For main(): opt-in through DEDUPLIKATE_TRACE=<file>, and written on
+    // exit; failures are only warned about
+    static void startFromEnvironment();
+    static void finish();
+
+    static bool isEnabled()
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    // Nanoseconds on the trace clock
+    static qint64 now();
+    // A span on the calling thread from startNs to now; name must outlive the
+    // trace, string literals are expected
+    static void complete(const char *name, qint64 startNs);
+
+    class Span
+    {
+    public:
+        explicit Span(const char *name)
+            : m_name(isEnabled() ? name : nullptr)
+            , m_startNs(m_name ? now() : 0)
+        {
+        }
+
+        ~Span()
+        {
+            if (m_name) {
+                complete(m_name, m_startNs);
+            }
+        }
+
+        Q_DISABLE_COPY(Span)
+
+    private:
+        const char *m_name;
+        qint64 m_startNs;
+    };
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+#endif // TRACE_H
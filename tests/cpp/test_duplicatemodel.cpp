@@ -1,6 +1,8 @@
 #include <QtTest/QtTest>
 #include "duplicatemodel.h"
 #include "duplicatefinder.h"
+#include "duplicateresults.h"
+#include "reductionplan.h"
 
 class TestDuplicateModel : public QObject
 {
@@ -25,6 +27,10 @@ private Q_SLOTS:
     void testInvertSelection();
     void testIndividualCheckboxToggle();
     void testGetSelectedFiles();
+    void testSelectionAggregates();
+    void testBulkSelectionNotifiesFiles();
+    void testAutoSelect();
+    void testReductionPlan();
     void testSelectionPersistence();
 
     // Data display tests
@@ -37,6 +43,16 @@ private Q_SLOTS:
 
     // Model operations tests
     void testSetResults();
+    void testAppendGroups();
+    void testResultsAreShared();
+    void testColumnarResults();
+    void testFetchMore();
+    void testAppendBeyondFirstPage();
+    void testSortGroups();
+    void testSortFiles();
+    void testSortKeepsPersistentIndexes();
+    void testUpdateFiles();
+    void testRemoveFiles();
     void testClear();
     void testRowCountTopLevel();
     void testRowCountChildren();
@@ -45,7 +61,7 @@ private Q_SLOTS:
 private:
     DuplicateModel *model;
 
-    QList<DuplicateFinder::DuplicateGroup> createTestData(int groups, int filesPerGroup);
+    DuplicateResultsPtr createTestData(int groups, int filesPerGroup);
 };
 
 void TestDuplicateModel::initTestCase()
@@ -71,7 +87,7 @@ void TestDuplicateModel::cleanup()
     model = nullptr;
 }
 
-QList<DuplicateFinder::DuplicateGroup> TestDuplicateModel::createTestData(int groups, int filesPerGroup)
+DuplicateResultsPtr TestDuplicateModel::createTestData(int groups, int filesPerGroup)
 {
     QList<DuplicateFinder::DuplicateGroup> result;
 
@@ -90,7 +106,7 @@ QList<DuplicateFinder::DuplicateGroup> TestDuplicateModel::createTestData(int gr
         result.append(group);
     }
 
-    return result;
+    return DuplicateResults::fromGroups(result);
 }
 
 // ==== Tree Structure Tests ====
@@ -266,6 +282,152 @@ void TestDuplicateModel::testGetSelectedFiles()
     }
 }
 
+void TestDuplicateModel::testSelectionAggregates()
+{
+    // Group g holds files of 1024 * (g + 1) bytes
+    model->setResults(createTestData(2, 3));
+    QCOMPARE(model->selectedCount(), 0);
+    QCOMPARE(model->selectedSize(), quint64(0));
+
+    QSignalSpy selectionSpy(model, &DuplicateModel::selectionChanged);
+
+    model->selectAll();
+    QCOMPARE(model->selectedCount(), 6);
+    QCOMPARE(model->selectedSize(), quint64(3 * 1024 + 3 * 2048));
+
+    QModelIndex group1 = model->index(1, 0);
+    model->setData(model->index(0, 0, group1), Qt::Unchecked, Qt::CheckStateRole);
+    QCOMPARE(model->selectedCount(), 5);
+    QCOMPARE(model->selectedSize(), quint64(3 * 1024 + 2 * 2048));
+
+    // Setting the same state again is not a change
+    model->setData(model->index(0, 0, group1), Qt::Unchecked, Qt::CheckStateRole);
+    QCOMPARE(model->selectedCount(), 5);
+
+    model->invertSelection();
+    QCOMPARE(model->selectedCount(), 1);
+    QCOMPARE(model->selectedSize(), quint64(2048));
+    QCOMPARE(model->getSelectedFiles().size(), 1);
+
+    // Appended files start unchecked, even after a select-all
+    model->selectAll();
+    model->appendGroups(createTestData(1, 2));
+    QCOMPARE(model->selectedCount(), 6);
+    QCOMPARE(model->getSelectedFiles().size(), 6);
+    QCOMPARE(model->data(model->index(0, 0, model->index(2, 0)), Qt::CheckStateRole).toInt(),
+             static_cast<int>(Qt::Unchecked));
+
+    model->selectNone();
+    QCOMPARE(model->selectedCount(), 0);
+    QCOMPARE(model->selectedSize(), quint64(0));
+
+    QCOMPARE(selectionSpy.count(), 5);
+}
+
+void TestDuplicateModel::testBulkSelectionNotifiesFiles()
+{
+    model->setResults(createTestData(3, 2));
+
+    QSignalSpy spy(model, &QAbstractItemModel::dataChanged);
+    model->selectAll();
+
+    // One notification per group, covering that group's file rows
+    QCOMPARE(spy.count(), 3);
+    for (int row = 0; row < 3; ++row) {
+        const QModelIndex topLeft = spy.at(row).at(0).value<QModelIndex>();
+        const QModelIndex bottomRight = spy.at(row).at(1).value<QModelIndex>();
+        QCOMPARE(topLeft.parent().row(), row);
+        QCOMPARE(topLeft.row(), 0);
+        QCOMPARE(bottomRight.row(), 1);
+    }
+}
+
+void TestDuplicateModel::testAutoSelect()
+{
+    DuplicateFinder::DuplicateGroup photos;
+    photos.entries.append({QStringLiteral("/home/user/backup/old/a.jpg"), 100, 1000, QStringLiteral("h1")});
+    photos.entries.append({QStringLiteral("/home/user/pics/a.jpg"), 100, 3000, QStringLiteral("h1")});
+    photos.entries.append({QStringLiteral("/home/user/a.jpg"), 100, 2000, QStringLiteral("h1")});
+
+    DuplicateFinder::DuplicateGroup docs;
+    docs.entries.append({QStringLiteral("/home/user/docs/b.txt"), 10, 500, QStringLiteral("h2")});
+    docs.entries.append({QStringLiteral("/home/user/backup/b.txt"), 10, 400, QStringLiteral("h2")});
+
+    model->setResults(DuplicateResults::fromGroups({photos, docs}));
+
+    auto selected = [this]() {
+        QStringList files = model->getSelectedFiles();
+        files.sort();
+        return files;
+    };
+
+    QVERIFY(model->autoSelect(DuplicateModel::KeepRule::Newest));
+    QCOMPARE(selected(), (QStringList{QStringLiteral("/home/user/a.jpg"),
+                                      QStringLiteral("/home/user/backup/b.txt"),
+                                      QStringLiteral("/home/user/backup/old/a.jpg")}));
+    QCOMPARE(model->selectedCount(), 3);
+    QCOMPARE(model->selectedSize(), quint64(210));
+
+    QVERIFY(model->autoSelect(DuplicateModel::KeepRule::Oldest));
+    QCOMPARE(selected(), (QStringList{QStringLiteral("/home/user/a.jpg"),
+                                      QStringLiteral("/home/user/docs/b.txt"),
+                                      QStringLiteral("/home/user/pics/a.jpg")}));
+
+    QVERIFY(model->autoSelect(DuplicateModel::KeepRule::ShortestPath));
+    QCOMPARE(selected(), (QStringList{QStringLiteral("/home/user/backup/b.txt"),
+                                      QStringLiteral("/home/user/backup/old/a.jpg"),
+                                      QStringLiteral("/home/user/pics/a.jpg")}));
+
+    // Subdirectories count as inside; groups without a match stay unchecked
+    QVERIFY(model->autoSelect(DuplicateModel::KeepRule::InDirectory, QStringLiteral("/home/user/backup/")));
+    QCOMPARE(selected(), (QStringList{QStringLiteral("/home/user/a.jpg"),
+                                      QStringLiteral("/home/user/docs/b.txt"),
+                                      QStringLiteral("/home/user/pics/a.jpg")}));
+
+    QVERIFY(model->autoSelect(DuplicateModel::KeepRule::MatchingPattern, QStringLiteral("/pics/")));
+    QCOMPARE(selected(), (QStringList{QStringLiteral("/home/user/a.jpg"),
+                                      QStringLiteral("/home/user/backup/old/a.jpg")}));
+    QCOMPARE(model->selectedSize(), quint64(200));
+
+    // Invalid arguments leave the selection alone
+    QVERIFY(!model->autoSelect(DuplicateModel::KeepRule::MatchingPattern, QStringLiteral("(")));
+    QVERIFY(!model->autoSelect(DuplicateModel::KeepRule::InDirectory, QString()));
+    QCOMPARE(model->selectedCount(), 2);
+}
+
+void TestDuplicateModel::testReductionPlan()
+{
+    // Group g holds files of 1024 * (g + 1) bytes
+    DuplicateResultsPtr data = createTestData(3, 3);
+    model->setResults(data);
+
+    // Group 0: one duplicate checked, the first unchecked file is kept
+    model->setData(model->index(1, 0, model->index(0, 0)), Qt::Checked, Qt::CheckStateRole);
+    // Group 1: every file checked, the first one is kept
+    for (int file = 0; file < 3; ++file) {
+        model->setData(model->index(file, 0, model->index(1, 0)), Qt::Checked, Qt::CheckStateRole);
+    }
+    // Group 2: nothing checked, nothing to replace
+
+    const ReductionPlan plan = ReductionPlan::fromModel(*model);
+    QCOMPARE(plan.replacements().size(), 3);
+    QCOMPARE(plan.reclaimableBytes(), quint64(1024 + 2 * 2048));
+
+    QCOMPARE(plan.replacements().at(0).duplicate, QStringLiteral("/tmp/test/group0/file1.txt"));
+    QCOMPARE(plan.replacements().at(0).original, QStringLiteral("/tmp/test/group0/file0.txt"));
+    QCOMPARE(plan.replacements().at(1).duplicate, QStringLiteral("/tmp/test/group1/file1.txt"));
+    QCOMPARE(plan.replacements().at(1).original, QStringLiteral("/tmp/test/group1/file0.txt"));
+    QCOMPARE(plan.replacements().at(2).duplicate, QStringLiteral("/tmp/test/group1/file2.txt"));
+
+    // Sorting the view does not change the plan
+    model->sort(2, Qt::DescendingOrder);
+    QCOMPARE(ReductionPlan::fromModel(*model).replacements().at(0).duplicate,
+             QStringLiteral("/tmp/test/group0/file1.txt"));
+
+    model->selectNone();
+    QVERIFY(ReductionPlan::fromModel(*model).isEmpty());
+}
+
 void TestDuplicateModel::testSelectionPersistence()
 {
     auto data = createTestData(1, 3);
@@ -406,6 +568,272 @@ void TestDuplicateModel::testSetResults()
     QCOMPARE(model->rowCount(group), 2);
 }
 
+void TestDuplicateModel::testAppendGroups()
+{
+    model->setResults(createTestData(2, 3));
+
+    QSignalSpy insertSpy(model, &QAbstractItemModel::rowsInserted);
+    QSignalSpy resetSpy(model, &QAbstractItemModel::modelReset);
+
+    model->appendGroups(createTestData(3, 2));
+
+    // Appending must insert rows, not reset the model
+    QCOMPARE(resetSpy.count(), 0);
+    QCOMPARE(insertSpy.count(), 1);
+    QCOMPARE(insertSpy.at(0).at(1).toInt(), 2);
+    QCOMPARE(insertSpy.at(0).at(2).toInt(), 4);
+
+    QCOMPARE(model->rowCount(), 5);
+    QCOMPARE(model->rowCount(model->index(0, 0)), 3);
+    QCOMPARE(model->rowCount(model->index(4, 0)), 2);
+
+    // Appended children resolve to their own group
+    QModelIndex child = model->index(1, 0, model->index(3, 0));
+    QCOMPARE(model->parent(child).row(), 3);
+
+    // Appending nothing is a no-op
+    model->appendGroups({});
+    QCOMPARE(insertSpy.count(), 1);
+}
+
+void TestDuplicateModel::testResultsAreShared()
+{
+    DuplicateResultsPtr data = createTestData(2, 3);
+    QWeakPointer<const DuplicateResults> weak = data;
+    model->setResults(data);
+    data.reset();
+
+    // The model keeps the shared batch alive instead of copying it
+    QVERIFY(!weak.isNull());
+    QCOMPARE(model->rowCount(), 2);
+    QCOMPARE(model->data(model->index(0, 1, model->index(1, 0)), Qt::ToolTipRole).toString(),
+             QStringLiteral("/tmp/test/group1/file0.txt"));
+
+    model->clear();
+    QVERIFY(weak.isNull());
+}
+
+void TestDuplicateModel::testColumnarResults()
+{
+    DuplicateFinder::DuplicateGroup group;
+    group.entries.append({QStringLiteral("/data/a/one.txt"), 10, 100, QStringLiteral("h")});
+    group.entries.append({QStringLiteral("/data/a/two.txt"), 10, 200, QStringLiteral("h")});
+    group.entries.append({QStringLiteral("/root.txt"), 10, 300, QStringLiteral("h")});
+
+    DuplicateResultsPtr results = DuplicateResults::fromGroups({group});
+
+    QCOMPARE(results->groupCount(), 1);
+    QCOMPARE(results->entryCount(), 3);
+    QCOMPARE(results->groupBegin(0), 0);
+    QCOMPARE(results->groupSize(0), 3);
+    QCOMPARE(results->groupHash(0), QStringLiteral("h"));
+
+    // Paths round-trip through the interned directory and name buffer
+    QCOMPARE(results->path(0), QStringLiteral("/data/a/one.txt"));
+    QCOMPARE(results->path(1), QStringLiteral("/data/a/two.txt"));
+    QCOMPARE(results->path(2), QStringLiteral("/root.txt"));
+    QCOMPARE(results->fileName(1), QStringLiteral("two.txt"));
+    QCOMPARE(results->fileNameView(2), QStringView(u"root.txt"));
+    QCOMPARE(results->directory(1), QStringLiteral("/data/a"));
+    QCOMPARE(results->directory(2), QStringLiteral("/"));
+    QCOMPARE(results->size(2), quint64(10));
+    QCOMPARE(results->modifiedDate(1), quint64(200));
+
+    // Files of one directory share a single interned string
+    QVERIFY(results->directory(0).constData() == results->directory(1).constData());
+}
+
+void TestDuplicateModel::testFetchMore()
+{
+    const int total = DuplicateModel::FetchBatchSize * 2 + 10;
+    model->setResults(createTestData(total, 2));
+
+    // Only the first page is exposed up front
+    QCOMPARE(model->groupCount(), total);
+    QCOMPARE(model->rowCount(), DuplicateModel::FetchBatchSize);
+    QVERIFY(model->canFetchMore(QModelIndex()));
+    QVERIFY(!model->canFetchMore(model->index(0, 0)));
+
+    QSignalSpy insertSpy(model, &QAbstractItemModel::rowsInserted);
+
+    model->fetchMore(QModelIndex());
+    QCOMPARE(model->rowCount(), DuplicateModel::FetchBatchSize * 2);
+    model->fetchMore(QModelIndex());
+    QCOMPARE(model->rowCount(), total);
+    QVERIFY(!model->canFetchMore(QModelIndex()));
+
+    QCOMPARE(insertSpy.count(), 2);
+    QCOMPARE(insertSpy.at(1).at(1).toInt(), DuplicateModel::FetchBatchSize * 2);
+    QCOMPARE(insertSpy.at(1).at(2).toInt(), total - 1);
+
+    // Groups report children without materialising them; files have none
+    QVERIFY(model->hasChildren(model->index(total - 1, 0)));
+    QVERIFY(!model->hasChildren(model->index(0, 0, model->index(total - 1, 0))));
+
+    // Selection covers groups that have not been fetched yet
+    model->clear();
+    model->setResults(createTestData(total, 2));
+    model->selectAll();
+    QCOMPARE(model->getSelectedFiles().size(), total * 2);
+}
+
+void TestDuplicateModel::testAppendBeyondFirstPage()
+{
+    model->setResults(createTestData(DuplicateModel::FetchBatchSize - 1, 2));
+
+    QSignalSpy insertSpy(model, &QAbstractItemModel::rowsInserted);
+
+    // Fills the first page, the rest waits for fetchMore()
+    model->appendGroups(createTestData(5, 2));
+    QCOMPARE(insertSpy.count(), 1);
+    QCOMPARE(insertSpy.at(0).at(1).toInt(), DuplicateModel::FetchBatchSize - 1);
+    QCOMPARE(insertSpy.at(0).at(2).toInt(), DuplicateModel::FetchBatchSize - 1);
+    QCOMPARE(model->rowCount(), DuplicateModel::FetchBatchSize);
+    QCOMPARE(model->groupCount(), DuplicateModel::FetchBatchSize + 4);
+
+    model->appendGroups(createTestData(3, 2));
+    QCOMPARE(insertSpy.count(), 1);
+
+    model->fetchMore(QModelIndex());
+    QCOMPARE(model->rowCount(), DuplicateModel::FetchBatchSize + 7);
+}
+
+void TestDuplicateModel::testSortGroups()
+{
+    model->setResults(createTestData(4, 2));
+
+    // Later groups have bigger files, so they waste the most space
+    model->sort(2, Qt::DescendingOrder);
+    QVERIFY(model->data(model->index(0, 1)).toString().contains(QLatin1String("Group 4")));
+    QVERIFY(model->data(model->index(3, 1)).toString().contains(QLatin1String("Group 1")));
+    QVERIFY(model->data(model->index(0, 2)).toString().contains(QLatin1String("4.00 KB")));
+
+    model->sort(4, Qt::AscendingOrder);
+    QCOMPARE(model->data(model->index(0, 4)).toString(), QStringLiteral("hash0"));
+    QCOMPARE(model->data(model->index(3, 4)).toString(), QStringLiteral("hash3"));
+
+    // Column 0 restores the scan order
+    model->sort(2, Qt::DescendingOrder);
+    model->sort(0, Qt::AscendingOrder);
+    QVERIFY(model->data(model->index(0, 1)).toString().contains(QLatin1String("Group 1")));
+
+    // The last sort is reapplied to new results
+    model->sort(2, Qt::DescendingOrder);
+    model->setResults(createTestData(3, 2));
+    QVERIFY(model->data(model->index(0, 1)).toString().contains(QLatin1String("Group 3")));
+}
+
+void TestDuplicateModel::testSortFiles()
+{
+    model->setResults(createTestData(2, 3));
+
+    model->sort(3, Qt::DescendingOrder);
+    QModelIndex group = model->index(1, 0);
+    QCOMPARE(model->data(model->index(0, 1, group)).toString(), QStringLiteral("file2.txt"));
+    QCOMPARE(model->data(model->index(2, 1, group)).toString(), QStringLiteral("file0.txt"));
+
+    // Check state follows the file, not the row
+    model->setData(model->index(0, 0, group), Qt::Checked, Qt::CheckStateRole);
+    QCOMPARE(model->getSelectedFiles(), QStringList{QStringLiteral("/tmp/test/group1/file2.txt")});
+
+    model->sort(1, Qt::AscendingOrder);
+    group = model->index(1, 0);
+    QCOMPARE(model->data(model->index(0, 1, group)).toString(), QStringLiteral("file0.txt"));
+    QCOMPARE(model->data(model->index(2, 0, group), Qt::CheckStateRole).toInt(), static_cast<int>(Qt::Checked));
+}
+
+void TestDuplicateModel::testSortKeepsPersistentIndexes()
+{
+    model->setResults(createTestData(3, 2));
+
+    QPersistentModelIndex group(model->index(0, 0));
+    QPersistentModelIndex file(model->index(1, 1, model->index(0, 0)));
+    const QString path = model->data(file, Qt::ToolTipRole).toString();
+
+    QSignalSpy layoutSpy(model, &QAbstractItemModel::layoutChanged);
+    model->sort(2, Qt::DescendingOrder);
+    QCOMPARE(layoutSpy.count(), 1);
+
+    QCOMPARE(group.row(), 2);
+    QCOMPARE(file.parent(), QModelIndex(group));
+    QCOMPARE(model->data(file, Qt::ToolTipRole).toString(), path);
+}
+
+void TestDuplicateModel::testUpdateFiles()
+{
+    model->setResults(createTestData(3, 2));
+    QVERIFY(model->setData(model->index(1, 0, model->index(0, 0)), Qt::Checked, Qt::CheckStateRole));
+
+    QPersistentModelIndex file(model->index(1, 0, model->index(2, 0)));
+    const QString path = model->data(file, Qt::ToolTipRole).toString();
+
+    // One file of group 1 is gone, a copy joins group 0 and two new files match each other
+    const QList<DuplicateFinder::DuplicateEntry> current = {
+        {QStringLiteral("/tmp/new/a.txt"), 1024, 1700000000, QStringLiteral("hash0")},
+        {QStringLiteral("/tmp/new/x.txt"), 7, 1700000000, QStringLiteral("hashN")},
+        {QStringLiteral("/tmp/new/y.txt"), 7, 1700000000, QStringLiteral("hashN")},
+    };
+    QSignalSpy selectionSpy(model, &DuplicateModel::selectionChanged);
+    model->updateFiles({QStringLiteral("/tmp/test/group1/file0.txt"), QStringLiteral("/tmp/new/a.txt"),
+                        QStringLiteral("/tmp/new/x.txt"), QStringLiteral("/tmp/new/y.txt")},
+                       current);
+    QCOMPARE(selectionSpy.count(), 1);
+
+    QCOMPARE(model->groupCount(), 3);
+    QCOMPARE(model->rowCount(), 3);
+    QCOMPARE(model->rowCount(model->index(0, 0)), 3);
+    QCOMPARE(model->rowCount(model->index(2, 0)), 2);
+    QCOMPARE(model->groupSizes(), QSet<quint64>({1024, 3072, 7}));
+    QCOMPARE(model->wastedSpace(), quint64(1024 * 2 + 3072 + 7));
+
+    // Check states and persistent indexes follow the files that stayed
+    QCOMPARE(model->selectedCount(), 1);
+    QCOMPARE(model->selectedSize(), quint64(1024));
+    QVERIFY(model->isChecked(0, 1));
+    QVERIFY(!model->isChecked(0, 2));
+    QCOMPARE(file.row(), 1);
+    QCOMPARE(file.parent().row(), 1);
+    QCOMPARE(model->data(file, Qt::ToolTipRole).toString(), path);
+
+    // A directory that left the tree takes its group along
+    model->updateFiles({QStringLiteral("/tmp/test/group2/")}, {});
+    QCOMPARE(model->groupCount(), 2);
+    QVERIFY(!file.isValid());
+
+    // Changes outside every group leave the model alone
+    selectionSpy.clear();
+    model->updateFiles({QStringLiteral("/tmp/elsewhere.txt")}, {});
+    QCOMPARE(selectionSpy.count(), 0);
+}
+
+void TestDuplicateModel::testRemoveFiles()
+{
+    model->setResults(createTestData(3, 3));
+    model->sort(1, Qt::DescendingOrder);
+    QVERIFY(model->setData(model->index(0, 0, model->index(2, 0)), Qt::Checked, Qt::CheckStateRole));
+    const QString checkedPath = model->data(model->index(0, 0, model->index(2, 0)), Qt::ToolTipRole).toString();
+    QVERIFY(model->setData(model->index(1, 0, model->index(2, 0)), Qt::Checked, Qt::CheckStateRole));
+    const QString removedPath = model->data(model->index(1, 0, model->index(2, 0)), Qt::ToolTipRole).toString();
+
+    QSignalSpy resetSpy(model, &QAbstractItemModel::modelReset);
+    model->removeFiles({removedPath,
+                        QStringLiteral("/tmp/test/group1/file0.txt"),
+                        QStringLiteral("/tmp/test/group1/file1.txt")});
+    QCOMPARE(resetSpy.count(), 0);
+
+    // Group 1 is down to one file and goes; the others keep their rows
+    QCOMPARE(model->groupCount(), 2);
+    QCOMPARE(model->rowCount(), 2);
+    QCOMPARE(model->rowCount(model->index(0, 0)), 3);
+    QCOMPARE(model->rowCount(model->index(1, 0)), 2);
+    QCOMPARE(model->wastedSpace(), quint64(1024 * 2 + 3072));
+
+    // The remaining check state stays with its file and files are still sorted
+    QCOMPARE(model->selectedCount(), 1);
+    QCOMPARE(model->getSelectedFiles(), QStringList({checkedPath}));
+    QCOMPARE(model->data(model->index(0, 0, model->index(1, 0)), Qt::ToolTipRole).toString(), checkedPath);
+}
+
 void TestDuplicateModel::testClear()
 {
     auto data = createTestData(5, 3);
@@ -0,0 +1,376 @@
+#include <QtTest/QtTest>
+#include <QAbstractItemModelTester>
+#include <QTreeView>
+#include "duplicatemodel.h"
+#include "duplicateresults.h"
+
+#include <memory>
+#include <utility>
+
+// Allocations are counted by interposing glibc's malloc family for the
+// calling thread only, so thread pool work elsewhere does not show up
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+}
+
+namespace {
+thread_local bool t_countAllocations = false;
+thread_local quint64 t_allocations = 0;
+}
+
+extern "C" void *malloc(size_t size) noexcept
+{
+    t_allocations += t_countAllocations;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) noexcept
+{
+    t_allocations += t_countAllocations;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size) noexcept
+{
+    t_allocations += t_countAllocations;
+    return __libc_realloc(pointer, size);
+}
+#endif
+
+// Per-call costs of the model paths a view hits on every repaint, at
+// 10k, 100k and 1M file rows. Groups hold FilesPerGroup files each.
+class TestDuplicateModelBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testModelConsistency_data();
+    void testModelConsistency();
+
+    void benchmarkSetResults_data();
+    void benchmarkSetResults();
+    void benchmarkIndex_data();
+    void benchmarkIndex();
+    void benchmarkParent_data();
+    void benchmarkParent();
+    void benchmarkData_data();
+    void benchmarkData();
+    void benchmarkInvertSelection_data();
+    void benchmarkInvertSelection();
+    void benchmarkTreeViewPaint_data();
+    void benchmarkTreeViewPaint();
+
+    void benchmarkDataAllocations_data();
+    void benchmarkDataAllocations();
+
+private:
+    static constexpr int FilesPerGroup = 4;
+    // Calls are spread over at most this many files to keep setup cheap
+    static constexpr int MaxSampledFiles = 65536;
+    // The model tester rechecks the model on every signal, which grows
+    // quadratic with the rows; larger models are not tested
+    static constexpr int MaxTestedRows = 10000;
+
+    static void addRowCounts();
+    DuplicateResultsPtr results(int rows);
+    static void fetchAll(DuplicateModel &model);
+    // A QAbstractItemModelTester on model, or none above MaxTestedRows
+    static std::unique_ptr<QAbstractItemModelTester> attachTester(DuplicateModel &model, int rows);
+    // File indexes spread evenly over the whole model
+    static QModelIndexList sampleFiles(const DuplicateModel &model, int column);
+
+    QHash<int, DuplicateResultsPtr> m_results;
+};
+
+void TestDuplicateModelBenchmark::addRowCounts()
+{
+    QTest::addColumn<int>("rows");
+    QTest::newRow("10k") << 10000;
+    QTest::newRow("100k") << 100000;
+    QTest::newRow("1M") << 1000000;
+}
+
+DuplicateResultsPtr TestDuplicateModelBenchmark::results(int rows)
+{
+    // Built once per size and shared by every benchmark
+    if (const auto it = m_results.constFind(rows); it != m_results.cend()) {
+        return it.value();
+    }
+
+    DuplicateResults::Builder builder;
+    const int groups = rows / FilesPerGroup;
+    builder.reserve(groups, rows);
+    for (int group = 0; group < groups; ++group) {
+        builder.beginGroup(QStringLiteral("%1").arg(group, 16, 16, QLatin1Char('0')));
+        for (int file = 0; file < FilesPerGroup; ++file) {
+            builder.addEntry(QStringLiteral("/data/dir%1/sub%2/file%3.bin").arg(group % 1000).arg(file).arg(group),
+                             quint64(4096 + group), quint64(1700000000 + group * FilesPerGroup + file));
+        }
+    }
+
+    const DuplicateResultsPtr built = builder.build();
+    m_results.insert(rows, built);
+    return built;
+}
+
+void TestDuplicateModelBenchmark::fetchAll(DuplicateModel &model)
+{
+    while (model.canFetchMore(QModelIndex())) {
+        model.fetchMore(QModelIndex());
+    }
+}
+
+std::unique_ptr<QAbstractItemModelTester> TestDuplicateModelBenchmark::attachTester(DuplicateModel &model, int rows)
+{
+    if (rows > MaxTestedRows) {
+        return nullptr;
+    }
+    return std::make_unique<QAbstractItemModelTester>(&model, QAbstractItemModelTester::FailureReportingMode::QtTest);
+}
+
+QModelIndexList TestDuplicateModelBenchmark::sampleFiles(const DuplicateModel &model, int column)
+{
+    const int groups = model.rowCount();
+    const int stride = qMax(1, groups * FilesPerGroup / MaxSampledFiles);
+
+    QModelIndexList files;
+    files.reserve(qMin(groups * FilesPerGroup, MaxSampledFiles + FilesPerGroup));
+    for (int row = 0; row < groups; row += stride) {
+        const QModelIndex group = model.index(row, 0);
+        for (int file = 0; file < model.rowCount(group); ++file) {
+            files.append(model.index(file, column, group));
+        }
+    }
+    return files;
+}
+
+void TestDuplicateModelBenchmark::testModelConsistency_data()
+{
+    addRowCounts();
+}
+
+void TestDuplicateModelBenchmark::testModelConsistency()
+{
+    QFETCH(int, rows);
+
+    // The tester checks every signal and index the model hands out
+    DuplicateModel model;
+    const auto tester = attachTester(model, rows);
+    model.setResults(results(rows));
+    fetchAll(model);
+    QCOMPARE(model.rowCount(), rows / FilesPerGroup);
+
+    model.sort(2, Qt::DescendingOrder);
+    model.invertSelection();
+    model.sort(0);
+    QCOMPARE(model.selectedCount(), qsizetype(rows));
+}
+
+void TestDuplicateModelBenchmark::benchmarkSetResults_data()
+{
+    addRowCounts();
+}
+
+void TestDuplicateModelBenchmark::benchmarkSetResults()
+{
+    QFETCH(int, rows);
+    const DuplicateResultsPtr data = results(rows);
+
+    DuplicateModel model;
+    QBENCHMARK {
+        model.setResults(data);
+    }
+}
+
+void TestDuplicateModelBenchmark::benchmarkIndex_data()
+{
+    addRowCounts();
+}
+
+void TestDuplicateModelBenchmark::benchmarkIndex()
+{
+    QFETCH(int, rows);
+
+    DuplicateModel model;
+    model.setResults(results(rows));
+    fetchAll(model);
+    const QModelIndexList files = sampleFiles(model, 0);
+    QVERIFY(!files.isEmpty());
+
+    QModelIndexList groups;
+    groups.reserve(files.size());
+    for (const QModelIndex &file : files) {
+        groups.append(file.parent());
+    }
+
+    // One call per iteration, so the result is the per-call cost
+    qsizetype next = 0;
+    QBENCHMARK {
+        QModelIndex index = model.index(files.at(next).row(), 1, groups.at(next));
+        next = (next + 1) % files.size();
+        Q_UNUSED(index);
+    }
+}
+
+void TestDuplicateModelBenchmark::benchmarkParent_data()
+{
+    addRowCounts();
+}
+
+void TestDuplicateModelBenchmark::benchmarkParent()
+{
+    QFETCH(int, rows);
+
+    DuplicateModel model;
+    model.setResults(results(rows));
+    fetchAll(model);
+    const QModelIndexList files = sampleFiles(model, 0);
+    QVERIFY(!files.isEmpty());
+
+    qsizetype next = 0;
+    QBENCHMARK {
+        QModelIndex parent = model.parent(files.at(next));
+        next = (next + 1) % files.size();
+        Q_UNUSED(parent);
+    }
+}
+
+void TestDuplicateModelBenchmark::benchmarkData_data()
+{
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<int>("column");
+    QTest::addColumn<int>("role");
+
+    const std::pair<const char *, std::pair<int, int>> roles[] = {
+        {"name", {1, Qt::DisplayRole}},
+        {"size", {2, Qt::DisplayRole}},
+        {"date", {3, Qt::DisplayRole}},
+        {"directory", {4, Qt::DisplayRole}},
+        {"check", {0, Qt::CheckStateRole}},
+    };
+    for (const int rows : {10000, 100000, 1000000}) {
+        for (const auto &[name, role] : roles) {
+            QTest::addRow("%d %s", rows, name) << rows << role.first << role.second;
+        }
+    }
+}
+
+void TestDuplicateModelBenchmark::benchmarkData()
+{
+    QFETCH(int, rows);
+    QFETCH(int, column);
+    QFETCH(int, role);
+
+    DuplicateModel model;
+    model.setResults(results(rows));
+    fetchAll(model);
+    const QModelIndexList files = sampleFiles(model, column);
+    QVERIFY(!files.isEmpty());
+
+    qsizetype next = 0;
+    QBENCHMARK {
+        QVariant value = model.data(files.at(next), role);
+        next = (next + 1) % files.size();
+        Q_UNUSED(value);
+    }
+}
+
+void TestDuplicateModelBenchmark::benchmarkInvertSelection_data()
+{
+    addRowCounts();
+}
+
+void TestDuplicateModelBenchmark::benchmarkInvertSelection()
+{
+    QFETCH(int, rows);
+
+    DuplicateModel model;
+    model.setResults(results(rows));
+    QBENCHMARK {
+        model.invertSelection();
+    }
+}
+
+void TestDuplicateModelBenchmark::benchmarkTreeViewPaint_data()
+{
+    addRowCounts();
+}
+
+void TestDuplicateModelBenchmark::benchmarkTreeViewPaint()
+{
+    QFETCH(int, rows);
+
+    DuplicateModel model;
+    const auto tester = attachTester(model, rows);
+    model.setResults(results(rows));
+
+    QTreeView view;
+    view.setModel(&model);
+    view.setUniformRowHeights(true);
+    view.resize(1200, 800);
+    view.expandAll();
+    view.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&view));
+
+    // Halfway down the fetched rows, where a user scrolling through would be
+    view.scrollTo(model.index(model.rowCount() / 2, 0), QAbstractItemView::PositionAtCenter);
+    QBENCHMARK {
+        view.viewport()->repaint();
+    }
+}
+
+void TestDuplicateModelBenchmark::benchmarkDataAllocations_data()
+{
+    QTest::addColumn<int>("column");
+    QTest::addColumn<int>("role");
+    QTest::addColumn<bool>("allocationFree");
+
+    QTest::newRow("checkbox") << 0 << int(Qt::DisplayRole) << true;
+    QTest::newRow("name") << 1 << int(Qt::DisplayRole) << false;
+    QTest::newRow("size") << 2 << int(Qt::DisplayRole) << false;
+    QTest::newRow("date") << 3 << int(Qt::DisplayRole) << false;
+    QTest::newRow("directory") << 4 << int(Qt::DisplayRole) << true;
+    QTest::newRow("tooltip") << 0 << int(Qt::ToolTipRole) << false;
+    QTest::newRow("check") << 0 << int(Qt::CheckStateRole) << true;
+}
+
+void TestDuplicateModelBenchmark::benchmarkDataAllocations()
+{
+#if defined(__GLIBC__)
+    QFETCH(int, column);
+    QFETCH(int, role);
+    QFETCH(bool, allocationFree);
+
+    DuplicateModel model;
+    model.setResults(results(100000));
+    fetchAll(model);
+    const QModelIndexList files = sampleFiles(model, column);
+    QVERIFY(!files.isEmpty());
+
+    // The returned values are destroyed inside the counted region, so
+    // allocations the caller would keep alive are counted too
+    t_allocations = 0;
+    t_countAllocations = true;
+    for (const QModelIndex &file : files) {
+        QVariant value = model.data(file, role);
+        Q_UNUSED(value);
+    }
+    t_countAllocations = false;
+
+    const qreal perCall = qreal(t_allocations) / files.size();
+    QTest::setBenchmarkResult(perCall, QTest::Events);
+
+    // Check states and interned directories fit into the QVariant as they are
+    if (allocationFree) {
+        QCOMPARE(t_allocations, quint64(0));
+    }
+#else
+    QSKIP("Allocation counting needs glibc");
+#endif
+}
+
+QTEST_MAIN(TestDuplicateModelBenchmark)
+#include "test_duplicatemodel_benchmark.moc"
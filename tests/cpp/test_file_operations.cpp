@@ -0,0 +1,326 @@
+#include <QtTest/QtTest>
+#include "fileoperationengine.h"
+#include "testtree.h"
+
+#include <sys/stat.h>
+
+class TestFileOperations : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testDelete();
+    void testDeleteMissingFile();
+    void testHardlink();
+    void testHardlinkAlreadyLinked();
+    void testHardlinkAcrossDirectories();
+    void testSymlink();
+    void testReflink();
+    void testLinkToMissingTarget();
+    void testVerifySkipsChangedFiles();
+    void testVerifyWithoutReference();
+    void testEmptyOperation();
+    void testBatchesAndProgress();
+    void testCancel();
+
+private:
+    QString createFile(const QString &name, const QByteArray &content = QByteArrayLiteral("duplicate"));
+    // A task carrying the file's current size and mtime, as a scan would record them
+    FileOperationEngine::Task scannedTask(const QString &path, const QString &target, const QString &reference);
+    FileOperationEngine::Report run(FileOperationEngine::Operation operation,
+                                    const QList<FileOperationEngine::Task> &tasks);
+
+    TestTree *m_dir;
+    FileOperationEngine *m_engine;
+};
+
+void TestFileOperations::init()
+{
+    m_dir = new TestTree();
+    QVERIFY(m_dir->isValid());
+    m_engine = new FileOperationEngine();
+}
+
+void TestFileOperations::cleanup()
+{
+    delete m_engine;
+    m_engine = nullptr;
+    delete m_dir;
+    m_dir = nullptr;
+}
+
+QString TestFileOperations::createFile(const QString &name, const QByteArray &content)
+{
+    return m_dir->createFile(name, content);
+}
+
+FileOperationEngine::Task TestFileOperations::scannedTask(const QString &path, const QString &target,
+                                                         const QString &reference)
+{
+    struct stat fileStat;
+    if (::stat(QFile::encodeName(path).constData(), &fileStat) != 0) {
+        return {path, target, reference};
+    }
+    return {path, target, reference, quint64(fileStat.st_size), quint64(fileStat.st_mtime)};
+}
+
+FileOperationEngine::Report TestFileOperations::run(FileOperationEngine::Operation operation,
+                                                    const QList<FileOperationEngine::Task> &tasks)
+{
+    QSignalSpy finishedSpy(m_engine, &FileOperationEngine::finished);
+    m_engine->start(operation, tasks);
+    if (finishedSpy.isEmpty() && !finishedSpy.wait(10000)) {
+        return FileOperationEngine::Report();
+    }
+    return finishedSpy.at(0).at(0).value<FileOperationEngine::Report>();
+}
+
+void TestFileOperations::testDelete()
+{
+    const QString a = createFile(QStringLiteral("a"));
+    const QString b = createFile(QStringLiteral("b"));
+
+    const auto report = run(FileOperationEngine::Operation::Delete, {{a, QString()}, {b, QString()}});
+
+    QCOMPARE(report.files.size(), 2);
+    QCOMPARE(report.count(FileOperationEngine::Outcome::Done), 2);
+    QVERIFY(!report.cancelled);
+    QVERIFY(!QFile::exists(a));
+    QVERIFY(!QFile::exists(b));
+}
+
+void TestFileOperations::testDeleteMissingFile()
+{
+    const QString a = createFile(QStringLiteral("a"));
+    const QString missing = m_dir->filePath(QStringLiteral("missing"));
+
+    const auto report = run(FileOperationEngine::Operation::Delete, {{missing, QString()}, {a, QString()}});
+
+    // Results stay in task order
+    QCOMPARE(report.files.at(0).path, missing);
+    QCOMPARE(report.files.at(0).outcome, FileOperationEngine::Outcome::Missing);
+    QCOMPARE(report.files.at(1).outcome, FileOperationEngine::Outcome::Done);
+}
+
+void TestFileOperations::testHardlink()
+{
+    const QString original = createFile(QStringLiteral("original"));
+    const QString copy = createFile(QStringLiteral("copy"));
+
+    const auto report = run(FileOperationEngine::Operation::Hardlink, {{copy, original}});
+    QCOMPARE(report.count(FileOperationEngine::Outcome::Done), 1);
+
+    struct stat originalStat;
+    struct stat copyStat;
+    QCOMPARE(::stat(QFile::encodeName(original).constData(), &originalStat), 0);
+    QCOMPARE(::stat(QFile::encodeName(copy).constData(), &copyStat), 0);
+    QCOMPARE(copyStat.st_ino, originalStat.st_ino);
+    QCOMPARE(int(originalStat.st_nlink), 2);
+
+    // The temporary link was renamed over the duplicate, nothing is left behind
+    QCOMPARE(QDir(m_dir->path()).entryList(QDir::Files | QDir::Hidden | QDir::System).size(), 2);
+}
+
+void TestFileOperations::testHardlinkAlreadyLinked()
+{
+    const QString original = createFile(QStringLiteral("original"));
+    const QString copy = m_dir->filePath(QStringLiteral("copy"));
+    QCOMPARE(::link(QFile::encodeName(original).constData(), QFile::encodeName(copy).constData()), 0);
+
+    const auto report = run(FileOperationEngine::Operation::Hardlink, {{copy, original}});
+    QCOMPARE(report.count(FileOperationEngine::Outcome::Done), 1);
+    QVERIFY(QFile::exists(copy));
+}
+
+void TestFileOperations::testHardlinkAcrossDirectories()
+{
+    const QString original = createFile(QStringLiteral("original"));
+
+    // Several directories with more files than one batch, processed in parallel
+    QList<FileOperationEngine::Task> tasks;
+    for (int dir = 0; dir < 4; ++dir) {
+        QVERIFY(QDir(m_dir->path()).mkdir(QStringLiteral("dir%1").arg(dir)));
+        for (int i = 0; i < FileOperationEngine::BatchSize + 10; ++i) {
+            tasks.append({createFile(QStringLiteral("dir%1/copy%2").arg(dir).arg(i)), original});
+        }
+    }
+
+    const auto report = run(FileOperationEngine::Operation::Hardlink, tasks);
+    QCOMPARE(report.files.size(), tasks.size());
+    QCOMPARE(report.count(FileOperationEngine::Outcome::Done), tasks.size());
+    for (int i = 0; i < tasks.size(); ++i) {
+        QCOMPARE(report.files.at(i).path, tasks.at(i).path);
+    }
+
+    struct stat originalStat;
+    QCOMPARE(::stat(QFile::encodeName(original).constData(), &originalStat), 0);
+    QCOMPARE(qsizetype(originalStat.st_nlink), tasks.size() + 1);
+}
+
+void TestFileOperations::testSymlink()
+{
+    const QString original = createFile(QStringLiteral("original"));
+    const QString copy = createFile(QStringLiteral("copy"));
+
+    const auto report = run(FileOperationEngine::Operation::Symlink, {{copy, original}});
+    QCOMPARE(report.count(FileOperationEngine::Outcome::Done), 1);
+
+    QFileInfo info(copy);
+    QVERIFY(info.isSymLink());
+    QCOMPARE(info.symLinkTarget(), original);
+}
+
+void TestFileOperations::testReflink()
+{
+    const QString original = createFile(QStringLiteral("original"), QByteArrayLiteral("shared contents"));
+    const QString copy = createFile(QStringLiteral("copy"), QByteArrayLiteral("shared contents"));
+
+    const auto report = run(FileOperationEngine::Operation::Reflink, {{copy, original}});
+    if (report.files.at(0).outcome == FileOperationEngine::Outcome::Failed) {
+        // The duplicate must be untouched when the filesystem cannot share extents
+        QFile file(copy);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(file.readAll(), QByteArrayLiteral("shared contents"));
+        QCOMPARE(QDir(m_dir->path()).entryList(QDir::Files | QDir::Hidden | QDir::System).size(), 2);
+        QSKIP("Filesystem does not support reflinks");
+    }
+
+    QCOMPARE(report.files.at(0).outcome, FileOperationEngine::Outcome::Done);
+
+    // A clone is a separate inode with the same contents
+    struct stat originalStat;
+    struct stat copyStat;
+    QCOMPARE(::stat(QFile::encodeName(original).constData(), &originalStat), 0);
+    QCOMPARE(::stat(QFile::encodeName(copy).constData(), &copyStat), 0);
+    QVERIFY(copyStat.st_ino != originalStat.st_ino);
+
+    QFile file(copy);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), QByteArrayLiteral("shared contents"));
+}
+
+void TestFileOperations::testLinkToMissingTarget()
+{
+    const QString copy = createFile(QStringLiteral("copy"));
+
+    const auto report = run(FileOperationEngine::Operation::Hardlink,
+                            {{copy, m_dir->filePath(QStringLiteral("gone"))}});
+
+    // The duplicate must survive when there is nothing to link it to
+    QCOMPARE(report.files.at(0).outcome, FileOperationEngine::Outcome::Failed);
+    QVERIFY(!report.files.at(0).error.isEmpty());
+    QVERIFY(QFile::exists(copy));
+}
+
+void TestFileOperations::testVerifySkipsChangedFiles()
+{
+    const QString original = createFile(QStringLiteral("original"), QByteArrayLiteral("same bytes"));
+    const QString same = createFile(QStringLiteral("same"), QByteArrayLiteral("same bytes"));
+    const QString different = createFile(QStringLiteral("different"), QByteArrayLiteral("same bytez"));
+    const QString touched = createFile(QStringLiteral("touched"), QByteArrayLiteral("same bytes"));
+
+    FileOperationEngine::Task touchedTask = scannedTask(touched, original, original);
+    touchedTask.modifiedDate -= 10;
+
+    QSignalSpy stageSpy(m_engine, &FileOperationEngine::stageChanged);
+    m_engine->setVerifyContents(true);
+    const auto report = run(FileOperationEngine::Operation::Hardlink,
+                            {scannedTask(same, original, original),
+                             scannedTask(different, original, original),
+                             touchedTask});
+
+    QCOMPARE(report.files.at(0).outcome, FileOperationEngine::Outcome::Done);
+    QCOMPARE(report.files.at(1).outcome, FileOperationEngine::Outcome::Changed);
+    QCOMPARE(report.files.at(2).outcome, FileOperationEngine::Outcome::Changed);
+    QVERIFY(!report.files.at(1).error.isEmpty());
+
+    QCOMPARE(stageSpy.count(), 2);
+    QCOMPARE(stageSpy.at(0).at(0).value<FileOperationEngine::Stage>(), FileOperationEngine::Stage::Verifying);
+    QCOMPARE(stageSpy.at(1).at(0).value<FileOperationEngine::Stage>(), FileOperationEngine::Stage::Applying);
+
+    // Skipped files keep their own inode
+    struct stat originalStat;
+    QCOMPARE(::stat(QFile::encodeName(original).constData(), &originalStat), 0);
+    QCOMPARE(int(originalStat.st_nlink), 2);
+    QFile file(different);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), QByteArrayLiteral("same bytez"));
+}
+
+void TestFileOperations::testVerifyWithoutReference()
+{
+    const QString a = createFile(QStringLiteral("a"));
+    const QString b = createFile(QStringLiteral("b"));
+
+    FileOperationEngine::Task changedTask = scannedTask(b, QString(), QString());
+    changedTask.size += 1;
+
+    // Without a reference only size and mtime are compared
+    m_engine->setVerifyContents(true);
+    const auto report = run(FileOperationEngine::Operation::Delete,
+                            {scannedTask(a, QString(), QString()), changedTask});
+
+    QCOMPARE(report.files.at(0).outcome, FileOperationEngine::Outcome::Done);
+    QCOMPARE(report.files.at(1).outcome, FileOperationEngine::Outcome::Changed);
+    QVERIFY(!QFile::exists(a));
+    QVERIFY(QFile::exists(b));
+}
+
+void TestFileOperations::testEmptyOperation()
+{
+    QSignalSpy finishedSpy(m_engine, &FileOperationEngine::finished);
+    m_engine->start(FileOperationEngine::Operation::Delete, {});
+
+    // Finishes asynchronously, like any other operation
+    QCOMPARE(finishedSpy.count(), 0);
+    QVERIFY(finishedSpy.wait(1000));
+    QVERIFY(!m_engine->isRunning());
+}
+
+void TestFileOperations::testBatchesAndProgress()
+{
+    const int count = FileOperationEngine::BatchSize * 3 + 7;
+    QList<FileOperationEngine::Task> tasks;
+    for (int i = 0; i < count; ++i) {
+        tasks.append({createFile(QStringLiteral("file%1").arg(i)), QString()});
+    }
+
+    QSignalSpy progressSpy(m_engine, &FileOperationEngine::progress);
+    const auto report = run(FileOperationEngine::Operation::Delete, tasks);
+
+    QCOMPARE(report.count(FileOperationEngine::Outcome::Done), count);
+    QVERIFY(!progressSpy.isEmpty());
+    QCOMPARE(progressSpy.last().at(0).toInt(), count);
+    QCOMPARE(progressSpy.last().at(1).toInt(), count);
+    QVERIFY(QDir(m_dir->path()).isEmpty());
+}
+
+void TestFileOperations::testCancel()
+{
+    const int count = FileOperationEngine::BatchSize * 8;
+    QList<FileOperationEngine::Task> tasks;
+    for (int i = 0; i < count; ++i) {
+        tasks.append({createFile(QStringLiteral("file%1").arg(i)), QString()});
+    }
+
+    QSignalSpy finishedSpy(m_engine, &FileOperationEngine::finished);
+    m_engine->start(FileOperationEngine::Operation::Delete, tasks);
+    m_engine->cancel();
+    QVERIFY(finishedSpy.wait(10000));
+
+    const auto report = finishedSpy.at(0).at(0).value<FileOperationEngine::Report>();
+    QVERIFY(report.cancelled);
+    QCOMPARE(report.files.size(), count);
+
+    // Every file is accounted for, and only cancelled ones are left on disk
+    const int done = report.count(FileOperationEngine::Outcome::Done);
+    const int cancelled = report.count(FileOperationEngine::Outcome::Cancelled);
+    QCOMPARE(done + cancelled, count);
+    QCOMPARE(int(QDir(m_dir->path()).entryList(QDir::Files).size()), cancelled);
+}
+
+QTEST_MAIN(TestFileOperations)
+#include "test_file_operations.moc"
@@ -0,0 +1,89 @@
+#include <QtTest/QtTest>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include "duplicateresults.h"
+#include "headlessrunner.h"
+
+class TestHeadless : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testJsonLines();
+    void testJsonEscaping();
+    void testCsv();
+    void testGroupNumbering();
+
+private:
+    DuplicateResultsPtr makeResults(const QStringList &paths);
+};
+
+DuplicateResultsPtr TestHeadless::makeResults(const QStringList &paths)
+{
+    DuplicateFinder::DuplicateGroup group;
+    for (const QString &path : paths) {
+        group.entries.append({path, 42, 1700000000, QStringLiteral("abc123")});
+    }
+    return DuplicateResults::fromGroups({group});
+}
+
+void TestHeadless::testJsonLines()
+{
+    const DuplicateResultsPtr results = makeResults({QStringLiteral("/a/one"), QStringLiteral("/b/two")});
+    const QList<QByteArray> lines = HeadlessRunner::formatBatch(*results, 0, HeadlessRunner::Format::JsonLines)
+                                        .split('\n');
+
+    // Two records and the empty remainder after the final newline
+    QCOMPARE(lines.size(), 3);
+    QVERIFY(lines.last().isEmpty());
+
+    QJsonParseError error;
+    const QJsonObject record = QJsonDocument::fromJson(lines.at(1), &error).object();
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(record.value(QStringLiteral("group")).toInt(), 0);
+    QCOMPARE(record.value(QStringLiteral("hash")).toString(), QStringLiteral("abc123"));
+    QCOMPARE(record.value(QStringLiteral("path")).toString(), QStringLiteral("/b/two"));
+    QCOMPARE(record.value(QStringLiteral("size")).toInteger(), 42);
+    QCOMPARE(record.value(QStringLiteral("modified")).toInteger(), 1700000000);
+}
+
+void TestHeadless::testJsonEscaping()
+{
+    const QString path = QStringLiteral("/odd/\"quoted\" back\\slash\ttab\x01 ünïcode");
+    const DuplicateResultsPtr results = makeResults({path, QStringLiteral("/plain")});
+    const QByteArray firstLine = HeadlessRunner::formatBatch(*results, 0, HeadlessRunner::Format::JsonLines)
+                                     .split('\n').first();
+
+    QJsonParseError error;
+    const QJsonObject record = QJsonDocument::fromJson(firstLine, &error).object();
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(record.value(QStringLiteral("path")).toString(), path);
+}
+
+void TestHeadless::testCsv()
+{
+    const DuplicateResultsPtr results = makeResults({QStringLiteral("/a/with,comma"), QStringLiteral("/a/\"quoted\"")});
+    const QByteArray csv = HeadlessRunner::formatBatch(*results, 3, HeadlessRunner::Format::Csv);
+
+    QCOMPARE(HeadlessRunner::csvHeader(), QByteArrayLiteral("group,hash,path,size,modified\n"));
+    QCOMPARE(csv, QByteArrayLiteral("3,abc123,\"/a/with,comma\",42,1700000000\n"
+                                    "3,abc123,\"/a/\"\"quoted\"\"\",42,1700000000\n"));
+}
+
+void TestHeadless::testGroupNumbering()
+{
+    DuplicateFinder::DuplicateGroup first;
+    first.entries.append({QStringLiteral("/x/1"), 1, 0, QStringLiteral("h1")});
+    first.entries.append({QStringLiteral("/y/1"), 1, 0, QStringLiteral("h1")});
+    DuplicateFinder::DuplicateGroup second;
+    second.entries.append({QStringLiteral("/x/2"), 2, 0, QStringLiteral("h2")});
+    second.entries.append({QStringLiteral("/y/2"), 2, 0, QStringLiteral("h2")});
+
+    // Batches are numbered on from the groups already written
+    const DuplicateResultsPtr results = DuplicateResults::fromGroups({first, second});
+    const QByteArray csv = HeadlessRunner::formatBatch(*results, 10, HeadlessRunner::Format::Csv);
+    QCOMPARE(csv, QByteArrayLiteral("10,h1,/x/1,1,0\n10,h1,/y/1,1,0\n11,h2,/x/2,2,0\n11,h2,/y/2,2,0\n"));
+}
+
+QTEST_MAIN(TestHeadless)
+#include "test_headless.moc"
@@ -0,0 +1,321 @@
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include "duplicatefinder.h"
+#include "duplicateresults.h"
+#include "fileindex.h"
+#include "testtree.h"
+#include "czkawka_bridge/czkawka_bridge.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+class TestIncremental : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testIndexRoundTrip();
+    void testRescanHashesOnlyChangedFiles();
+    void testRescanMatchesFullScan();
+    void testDeletedFilesLeaveGroups();
+    void testStatistics();
+    void testPrehashSkipsUniqueFiles();
+    void testIndexIgnoresCacheThreshold();
+    void testBackgroundScan();
+
+private:
+    DuplicateFinder::ScanParameters parameters(const QString &indexDirectory) const;
+    // Every group as "hash path path...", in scan order
+    QStringList scan(const QString &indexDirectory, DuplicateFinder::CacheStats *stats = nullptr,
+                     DuplicateFinder::ScanStatistics *statistics = nullptr);
+    QStringList scan(const DuplicateFinder::ScanParameters &params, DuplicateFinder::CacheStats *stats = nullptr,
+                     DuplicateFinder::ScanStatistics *statistics = nullptr);
+
+    TestTree *m_tree;
+    QTemporaryDir *m_index;
+};
+
+void TestIncremental::init()
+{
+    m_tree = new TestTree();
+    m_index = new QTemporaryDir();
+    QVERIFY(m_tree->isValid());
+    QVERIFY(m_index->isValid());
+}
+
+void TestIncremental::cleanup()
+{
+    delete m_tree;
+    m_tree = nullptr;
+    delete m_index;
+    m_index = nullptr;
+}
+
+DuplicateFinder::ScanParameters TestIncremental::parameters(const QString &indexDirectory) const
+{
+    DuplicateFinder::ScanParameters params;
+    params.checkMethod = 0;
+    params.hashType = 0;
+    params.recursive = true;
+    params.ignoreHardLinks = true;
+    params.useCache = false;
+    params.minSize = 0;
+    params.maxSize = 0;
+    params.includePaths = {m_tree->path()};
+    params.incremental = true;
+    params.indexDirectory = indexDirectory;
+    return params;
+}
+
+QStringList TestIncremental::scan(const QString &indexDirectory, DuplicateFinder::CacheStats *stats,
+                                  DuplicateFinder::ScanStatistics *statistics)
+{
+    return scan(parameters(indexDirectory), stats, statistics);
+}
+
+QStringList TestIncremental::scan(const DuplicateFinder::ScanParameters &params, DuplicateFinder::CacheStats *stats,
+                                  DuplicateFinder::ScanStatistics *statistics)
+{
+    DuplicateFinder finder;
+    QSignalSpy readySpy(&finder, &DuplicateFinder::resultsReady);
+    finder.startScan(params);
+    if (!readySpy.wait(10000)) {
+        return {QStringLiteral("timeout")};
+    }
+
+    if (stats) {
+        *stats = finder.getCacheStats();
+    }
+    if (statistics) {
+        *statistics = finder.getScanStatistics();
+    }
+
+    QStringList groups;
+    for (const DuplicateResultsPtr &batch : finder.getResults()) {
+        for (int group = 0; group < batch->groupCount(); ++group) {
+            QStringList fields = {batch->groupHash(group)};
+            for (int entry = batch->groupBegin(group); entry < batch->groupBegin(group) + batch->groupSize(group); ++entry) {
+                fields.append(batch->path(entry));
+            }
+            groups.append(fields.join(QLatin1Char(' ')));
+        }
+    }
+    return groups;
+}
+
+void TestIncremental::testIndexRoundTrip()
+{
+    FileIndex index(QStringLiteral("/data"), 0);
+    index.insert(QStringLiteral("/data/a"), {7, 100, 1700000000, QStringLiteral("abc")});
+    QVERIFY(index.save(m_index->path()));
+
+    FileIndex loaded(QStringLiteral("/data"), 0);
+    QVERIFY(loaded.load(m_index->path()));
+    QCOMPARE(loaded.size(), 1);
+    QCOMPARE(loaded.hashFor(QStringLiteral("/data/a"), {7, 100, 1700000000, QString()}), QStringLiteral("abc"));
+
+    // A new inode, size or mtime means the content may have changed
+    QVERIFY(loaded.hashFor(QStringLiteral("/data/a"), {8, 100, 1700000000, QString()}).isEmpty());
+    QVERIFY(loaded.hashFor(QStringLiteral("/data/a"), {7, 101, 1700000000, QString()}).isEmpty());
+    QVERIFY(loaded.hashFor(QStringLiteral("/data/a"), {7, 100, 1700000001, QString()}).isEmpty());
+
+    // Hashes of another type are never mixed in
+    FileIndex otherType(QStringLiteral("/data"), 2);
+    QVERIFY(!otherType.load(m_index->path()));
+    QCOMPARE(otherType.size(), 0);
+}
+
+void TestIncremental::testRescanHashesOnlyChangedFiles()
+{
+    m_tree->createFile(QStringLiteral("a/one"), QByteArrayLiteral("duplicate"));
+    m_tree->createFile(QStringLiteral("b/one"), QByteArrayLiteral("duplicate"));
+    const QString changed = m_tree->createFile(QStringLiteral("c/one"), QByteArrayLiteral("different"));
+    m_tree->createFile(QStringLiteral("unique"), QByteArrayLiteral("no other file has this size"));
+
+    DuplicateFinder::CacheStats stats;
+    QCOMPARE(scan(m_index->path(), &stats).size(), 1);
+    QCOMPARE(stats.candidates, quint64(3));
+    QCOMPARE(stats.misses, quint64(3));
+    QCOMPARE(stats.hits, quint64(0));
+
+    // Same size; a later mtime makes sure the change is seen within one second
+    QFile file(changed);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(QByteArrayLiteral("duplicate"));
+    QVERIFY(file.flush());
+    QVERIFY(file.setFileTime(QDateTime::currentDateTime().addSecs(60), QFileDevice::FileModificationTime));
+    file.close();
+
+    const QStringList groups = scan(m_index->path(), &stats);
+    QCOMPARE(groups.size(), 1);
+    QCOMPARE(groups.first().split(QLatin1Char(' ')).size(), 4);
+    QCOMPARE(stats.misses, quint64(1));
+    QCOMPARE(stats.hits, quint64(2));
+    QCOMPARE(stats.bytesHashed, quint64(9));
+}
+
+void TestIncremental::testRescanMatchesFullScan()
+{
+    m_tree->createFile(QStringLiteral("x/1"), QByteArrayLiteral("first"));
+    m_tree->createFile(QStringLiteral("y/1"), QByteArrayLiteral("first"));
+    m_tree->createFile(QStringLiteral("y/2"), QByteArrayLiteral("other"));
+    m_tree->createFile(QStringLiteral("z/2"), QByteArrayLiteral("other"));
+    m_tree->createFile(QStringLiteral("z/3"), QByteArrayLiteral("third file"));
+    m_tree->createFile(QStringLiteral("x/3"), QByteArrayLiteral("third file"));
+
+    const QStringList first = scan(m_index->path());
+    QCOMPARE(first.size(), 3);
+
+    DuplicateFinder::CacheStats stats;
+    const QStringList rescan = scan(m_index->path(), &stats);
+    QCOMPARE(stats.misses, quint64(0));
+    QCOMPARE(rescan, first);
+
+    // A scan that starts from an empty index sees the same groups
+    QTemporaryDir freshIndex;
+    QCOMPARE(scan(freshIndex.path(), &stats), first);
+    QCOMPARE(stats.misses, quint64(6));
+}
+
+void TestIncremental::testDeletedFilesLeaveGroups()
+{
+    m_tree->createFile(QStringLiteral("a"), QByteArrayLiteral("duplicate"));
+    const QString removed = m_tree->createFile(QStringLiteral("b"), QByteArrayLiteral("duplicate"));
+    QCOMPARE(scan(m_index->path()).size(), 1);
+
+    QVERIFY(QFile::remove(removed));
+
+    DuplicateFinder::CacheStats stats;
+    QVERIFY(scan(m_index->path(), &stats).isEmpty());
+    QCOMPARE(stats.candidates, quint64(0));
+
+    FileIndex index(m_tree->path(), 0);
+    QVERIFY(index.load(m_index->path()));
+    QCOMPARE(index.size(), 1);
+}
+
+void TestIncremental::testStatistics()
+{
+    m_tree->createFile(QStringLiteral("a/one"), QByteArrayLiteral("duplicate"));
+    m_tree->createFile(QStringLiteral("b/one"), QByteArrayLiteral("duplicate"));
+    m_tree->createFile(QStringLiteral("c/one"), QByteArrayLiteral("different"));
+    m_tree->createFile(QStringLiteral("unique"), QByteArrayLiteral("no other file has this size"));
+
+    DuplicateFinder::ScanStatistics statistics;
+    QCOMPARE(scan(m_index->path(), nullptr, &statistics).size(), 1);
+
+    QCOMPARE(statistics.stages.size(), 3);
+    const DuplicateFinder::StageStatistics &walk = statistics.stages.at(0);
+    QCOMPARE(walk.stage, DuplicateFinder::ScanStage::CollectingFiles);
+    QCOMPARE(walk.files, quint64(4));
+    QCOMPARE(walk.bytes, quint64(9 * 3 + 27));
+
+    // Only the three files sharing a size are read
+    const DuplicateFinder::StageStatistics &hashing = statistics.stages.at(1);
+    QCOMPARE(hashing.stage, DuplicateFinder::ScanStage::FullHashing);
+    QCOMPARE(hashing.files, statistics.cache.misses);
+    QCOMPARE(hashing.bytes, quint64(9 * 3));
+
+    const DuplicateFinder::StageStatistics &fetch = statistics.stages.at(2);
+    QCOMPARE(fetch.stage, DuplicateFinder::ScanStage::FetchingResults);
+    QCOMPARE(fetch.files, quint64(2));
+
+    QCOMPARE(statistics.groupCount, 1);
+    QCOMPARE(statistics.wastedSpace, quint64(9));
+    QVERIFY(statistics.totalTimeUs > 0);
+    QVERIFY(statistics.totalTimeUs >= walk.wallTimeUs + hashing.wallTimeUs);
+}
+
+void TestIncremental::testPrehashSkipsUniqueFiles()
+{
+    const QByteArray content(CZKAWKA_PREHASH_SIZE + 4000, 'x');
+    m_tree->createFile(QStringLiteral("a/big"), content);
+    m_tree->createFile(QStringLiteral("b/big"), content);
+    m_tree->createFile(QStringLiteral("c/big"), QByteArray(content).replace(0, 1, "y"));
+
+    DuplicateFinder::ScanStatistics statistics;
+    QCOMPARE(scan(m_index->path(), nullptr, &statistics).size(), 1);
+
+    // All three are prehashed, only the two sharing their first bytes are read whole
+    QCOMPARE(statistics.stages.size(), 4);
+    const DuplicateFinder::StageStatistics &prehashing = statistics.stages.at(1);
+    QCOMPARE(prehashing.stage, DuplicateFinder::ScanStage::PreHashing);
+    QCOMPARE(prehashing.files, quint64(3));
+    QCOMPARE(prehashing.bytes, quint64(3 * CZKAWKA_PREHASH_SIZE));
+    const DuplicateFinder::StageStatistics &hashing = statistics.stages.at(2);
+    QCOMPARE(hashing.stage, DuplicateFinder::ScanStage::FullHashing);
+    QCOMPARE(hashing.files, quint64(2));
+    QCOMPARE(hashing.bytes, quint64(2 * content.size()));
+    QCOMPARE(statistics.cache.misses, quint64(3));
+
+    // The unique file has no full hash to remember, and the index holds its
+    // companions, so the rescan reads it whole
+    DuplicateFinder::CacheStats stats;
+    QCOMPARE(scan(m_index->path(), &stats).size(), 1);
+    QCOMPARE(stats.hits, quint64(2));
+    QCOMPARE(stats.misses, quint64(1));
+    QCOMPARE(stats.bytesHashed, quint64(content.size()));
+}
+
+void TestIncremental::testIndexIgnoresCacheThreshold()
+{
+    m_tree->createFile(QStringLiteral("a/one"), QByteArrayLiteral("duplicate"));
+    m_tree->createFile(QStringLiteral("b/one"), QByteArrayLiteral("duplicate"));
+
+    // Far below the cache threshold, still remembered
+    DuplicateFinder::ScanParameters params = parameters(m_index->path());
+    params.useCache = true;
+    params.minimalCacheFileSize = 1024 * 1024;
+    QCOMPARE(scan(params).size(), 1);
+
+    DuplicateFinder::CacheStats stats;
+    QCOMPARE(scan(params, &stats).size(), 1);
+    QCOMPARE(stats.hits, quint64(2));
+    QCOMPARE(stats.misses, quint64(0));
+}
+
+void TestIncremental::testBackgroundScan()
+{
+    // Priorities are per thread on Linux, so the test thread keeps its own
+    const int ownNiceValue = ::getpriority(PRIO_PROCESS, ::gettid());
+    int niceValue = 0;
+    QThread *thread = QThread::create([&niceValue]() {
+        czkawka_set_background_priority();
+        niceValue = ::getpriority(PRIO_PROCESS, ::gettid());
+    });
+    thread->start();
+    QVERIFY(thread->wait(5000));
+    delete thread;
+    QCOMPARE(niceValue, 19);
+    QCOMPARE(::getpriority(PRIO_PROCESS, ::gettid()), ownNiceValue);
+
+    m_tree->createFile(QStringLiteral("a/one"), QByteArrayLiteral("duplicate"));
+    m_tree->createFile(QStringLiteral("b/one"), QByteArrayLiteral("duplicate"));
+    m_tree->createFile(QStringLiteral("c/one"), QByteArrayLiteral("different"));
+
+    // Limits and priority change how fast a scan runs, never what it finds
+    DuplicateFinder::ScanParameters params = parameters(m_index->path());
+    params.cpuThreads = 1;
+    params.ioThreads = 1;
+    params.background = true;
+    const QStringList limited = scan(params);
+    QCOMPARE(limited.size(), 1);
+
+    QTemporaryDir otherIndex;
+    QCOMPARE(scan(otherIndex.path()), limited);
+
+    // More workers than files read at once
+    QTemporaryDir readLimitedIndex;
+    params.indexDirectory = readLimitedIndex.path();
+    params.cpuThreads = 4;
+    params.background = false;
+    DuplicateFinder::CacheStats stats;
+    QCOMPARE(scan(params, &stats), limited);
+    QCOMPARE(stats.misses, quint64(3));
+}
+
+QTEST_MAIN(TestIncremental)
+#include "test_incremental.moc"
@@ -0,0 +1,268 @@
+#include <QtTest/QtTest>
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include "duplicatefinder.h"
+#include "duplicatemodel.h"
+#include "duplicateresults.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+// End-to-end benchmark over a synthetic tree, written as JSON for charting.
+//
+// The tree is generated from a seed, so runs with the same settings scan
+// identical files. Settings come from the environment:
+//   DEDUPLIKATE_BENCH_FILES            number of files (default 1000)
+//   DEDUPLIKATE_BENCH_DUPLICATE_RATIO  share of files that copy an earlier one (default 0.3)
+//   DEDUPLIKATE_BENCH_SIZES            size:weight list (default 512:60,8192:30,131072:10)
+//   DEDUPLIKATE_BENCH_SEED             generator seed (default 1)
+//   DEDUPLIKATE_BENCH_HASH             0=Blake3, 1=Crc32, 2=Xxh3 (default 0)
+//   DEDUPLIKATE_BENCH_OUTPUT           JSON file (default none, the report is only logged)
+class TestPerformance : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void benchmarkScanPipeline();
+
+private:
+    // Below the benchmark's CTest timeout, so a hung scan fails here first
+    static constexpr int ScanTimeoutMs = 25 * 60 * 1000;
+
+    struct SizeClass {
+        quint64 size;
+        int weight;
+    };
+
+    void generateTree();
+    static QByteArray content(quint64 seed, int contentId, quint64 size);
+    void record(const QString &phase, const QElapsedTimer &timer);
+
+    int m_fileCount = 1000;
+    double m_duplicateRatio = 0.3;
+    QList<SizeClass> m_sizes;
+    quint64 m_seed = 1;
+    int m_hashType = 0;
+    QString m_output;
+
+    QTemporaryDir *m_tree = nullptr;
+    int m_expectedGroups = 0;
+    quint64 m_totalBytes = 0;
+    QJsonObject m_timings; // Phase -> milliseconds
+};
+
+void TestPerformance::initTestCase()
+{
+    if (qEnvironmentVariableIsSet("DEDUPLIKATE_BENCH_FILES")) {
+        m_fileCount = qEnvironmentVariableIntValue("DEDUPLIKATE_BENCH_FILES");
+    }
+    if (qEnvironmentVariableIsSet("DEDUPLIKATE_BENCH_DUPLICATE_RATIO")) {
+        m_duplicateRatio = qEnvironmentVariable("DEDUPLIKATE_BENCH_DUPLICATE_RATIO").toDouble();
+    }
+    if (qEnvironmentVariableIsSet("DEDUPLIKATE_BENCH_SEED")) {
+        m_seed = qEnvironmentVariable("DEDUPLIKATE_BENCH_SEED").toULongLong();
+    }
+    if (qEnvironmentVariableIsSet("DEDUPLIKATE_BENCH_HASH")) {
+        m_hashType = qEnvironmentVariableIntValue("DEDUPLIKATE_BENCH_HASH");
+    }
+    m_output = qEnvironmentVariable("DEDUPLIKATE_BENCH_OUTPUT");
+
+    const QString sizes = qEnvironmentVariable("DEDUPLIKATE_BENCH_SIZES", QStringLiteral("512:60,8192:30,131072:10"));
+    for (const QString &sizeClass : sizes.split(QLatin1Char(','), Qt::SkipEmptyParts)) {
+        const QStringList fields = sizeClass.split(QLatin1Char(':'));
+        bool sizeOk = false;
+        bool weightOk = true;
+        const quint64 size = fields.first().toULongLong(&sizeOk);
+        const int weight = fields.size() > 1 ? fields.at(1).toInt(&weightOk) : 1;
+        QVERIFY2(sizeOk && weightOk && size > 0 && weight > 0, qPrintable(sizeClass));
+        m_sizes.append({size, weight});
+    }
+    QVERIFY(!m_sizes.isEmpty());
+    QVERIFY(m_fileCount > 0);
+    QVERIFY(m_duplicateRatio >= 0.0 && m_duplicateRatio < 1.0);
+
+    m_tree = new QTemporaryDir();
+    QVERIFY(m_tree->isValid());
+
+    QElapsedTimer timer;
+    timer.start();
+    generateTree();
+    record(QStringLiteral("generate"), timer);
+}
+
+void TestPerformance::cleanupTestCase()
+{
+    delete m_tree;
+    m_tree = nullptr;
+}
+
+QByteArray TestPerformance::content(quint64 seed, int contentId, quint64 size)
+{
+    // Random bytes, with the id up front so equal sizes never hash alike by chance
+    QRandomGenerator generator(seed * 1000003 + quint64(contentId));
+    QByteArray data(qsizetype(size), Qt::Uninitialized);
+    for (qsizetype i = 0; i < data.size(); i += 4) {
+        const quint32 word = generator.generate();
+        memcpy(data.data() + i, &word, size_t(qMin<qsizetype>(4, data.size() - i)));
+    }
+    memcpy(data.data(), &contentId, size_t(qMin<qsizetype>(sizeof(contentId), data.size())));
+    return data;
+}
+
+void TestPerformance::generateTree()
+{
+    int totalWeight = 0;
+    for (const SizeClass &sizeClass : std::as_const(m_sizes)) {
+        totalWeight += sizeClass.weight;
+    }
+
+    QRandomGenerator generator(m_seed);
+    QList<quint64> originalSizes; // Content id -> size
+    QList<int> copies;            // Content id -> number of copies
+
+    for (int file = 0; file < m_fileCount; ++file) {
+        int contentId;
+        if (!originalSizes.isEmpty() && generator.generateDouble() < m_duplicateRatio) {
+            contentId = int(generator.bounded(quint32(originalSizes.size())));
+            ++copies[contentId];
+        } else {
+            int pick = int(generator.bounded(quint32(totalWeight)));
+            quint64 size = m_sizes.last().size;
+            for (const SizeClass &sizeClass : std::as_const(m_sizes)) {
+                if (pick < sizeClass.weight) {
+                    size = sizeClass.size;
+                    break;
+                }
+                pick -= sizeClass.weight;
+            }
+            contentId = originalSizes.size();
+            originalSizes.append(size);
+            copies.append(0);
+        }
+
+        // Two levels of 16 directories each, so copies mostly land elsewhere
+        const QString directory = m_tree->filePath(QStringLiteral("d%1/d%2").arg(file % 16).arg((file / 16) % 16));
+        QDir().mkpath(directory);
+        QFile out(directory + QStringLiteral("/f%1.bin").arg(file));
+        QVERIFY(out.open(QIODevice::WriteOnly));
+        const quint64 size = originalSizes[contentId];
+        QCOMPARE(out.write(content(m_seed, contentId, size)), qint64(size));
+        m_totalBytes += size;
+    }
+
+    m_expectedGroups = int(std::count_if(copies.cbegin(), copies.cend(), [](int count) { return count > 0; }));
+}
+
+void TestPerformance::record(const QString &phase, const QElapsedTimer &timer)
+{
+    m_timings.insert(phase, double(timer.nsecsElapsed()) / 1e6);
+}
+
+void TestPerformance::benchmarkScanPipeline()
+{
+    DuplicateFinder::ScanParameters params;
+    params.checkMethod = 0;
+    params.hashType = m_hashType;
+    params.recursive = true;
+    params.ignoreHardLinks = true;
+    params.useCache = false; // Every run reads every candidate
+    params.minSize = 0;
+    params.maxSize = 0;
+    params.includePaths = {m_tree->path()};
+
+    DuplicateFinder finder;
+    QSignalSpy readySpy(&finder, &DuplicateFinder::resultsReady);
+    QElapsedTimer scanTimer;
+    scanTimer.start();
+    finder.startScan(params);
+    QVERIFY(readySpy.wait(ScanTimeoutMs));
+    record(QStringLiteral("scan_total"), scanTimer);
+
+    // Stage timings come from the scan itself, which sees every progress report
+    const DuplicateFinder::ScanStatistics statistics = finder.getScanStatistics();
+    for (const DuplicateFinder::StageStatistics &stage : statistics.stages) {
+        m_timings.insert(QStringLiteral("scan_") + DuplicateFinder::stageName(stage.stage), stage.wallTimeUs / 1000.0);
+    }
+    m_timings.insert(QStringLiteral("scan_receivers"), statistics.receiverTimeUs / 1000.0);
+    QCOMPARE(finder.getGroupCount(), m_expectedGroups);
+
+    // Model phases
+    DuplicateModel model;
+    QElapsedTimer timer;
+    timer.start();
+    const QList<DuplicateResultsPtr> &batches = finder.getResults();
+    model.setResults(batches.isEmpty() ? DuplicateResultsPtr() : batches.first());
+    for (qsizetype i = 1; i < batches.size(); ++i) {
+        model.appendGroups(batches.at(i));
+    }
+    record(QStringLiteral("model_load"), timer);
+    QCOMPARE(model.groupCount(), m_expectedGroups);
+
+    timer.start();
+    model.selectAll();
+    record(QStringLiteral("select_all"), timer);
+
+    timer.start();
+    model.invertSelection();
+    record(QStringLiteral("select_invert"), timer);
+
+    timer.start();
+    QVERIFY(model.autoSelect(DuplicateModel::KeepRule::Newest));
+    record(QStringLiteral("select_auto_newest"), timer);
+
+    timer.start();
+    const qsizetype selected = model.getSelectedFiles().size();
+    record(QStringLiteral("selected_files"), timer);
+    QCOMPARE(selected, model.selectedCount());
+
+    const std::pair<int, const char *> sorts[] = {
+        {1, "sort_count_name"}, {2, "sort_wasted_size"}, {3, "sort_date"}, {4, "sort_hash_path"}, {0, "sort_scan_order"},
+    };
+    for (const auto &[column, phase] : sorts) {
+        timer.start();
+        model.sort(column, Qt::DescendingOrder);
+        record(QString::fromLatin1(phase), timer);
+    }
+
+    const QJsonObject config{
+        {QStringLiteral("files"), m_fileCount},
+        {QStringLiteral("duplicate_ratio"), m_duplicateRatio},
+        {QStringLiteral("sizes"), qEnvironmentVariable("DEDUPLIKATE_BENCH_SIZES", QStringLiteral("512:60,8192:30,131072:10"))},
+        {QStringLiteral("seed"), QString::number(m_seed)},
+        {QStringLiteral("hash_type"), m_hashType},
+    };
+    const QJsonObject results{
+        {QStringLiteral("bytes"), double(m_totalBytes)},
+        {QStringLiteral("groups"), finder.getGroupCount()},
+        {QStringLiteral("wasted_bytes"), double(finder.getWastedSpace())},
+        {QStringLiteral("selected_files"), double(selected)},
+    };
+    const QJsonObject report{
+        {QStringLiteral("benchmark"), QStringLiteral("scan_pipeline")},
+        {QStringLiteral("timestamp"), QDateTime::currentDateTimeUtc().toString(Qt::ISODate)},
+        {QStringLiteral("config"), config},
+        {QStringLiteral("results"), results},
+        {QStringLiteral("timings_ms"), m_timings},
+    };
+
+    if (m_output.isEmpty()) {
+        qInfo().noquote() << QJsonDocument(report).toJson(QJsonDocument::Compact);
+        return;
+    }
+
+    const QByteArray json = QJsonDocument(report).toJson();
+    QFile out(m_output);
+    QVERIFY2(out.open(QIODevice::WriteOnly | QIODevice::Truncate), qPrintable(out.errorString()));
+    QVERIFY2(out.write(json) == json.size() && out.flush(), qPrintable(out.errorString()));
+    qInfo().noquote() << "Benchmark written to" << QFileInfo(out).absoluteFilePath();
+}
+
+QTEST_MAIN(TestPerformance)
+#include "test_performance.moc"
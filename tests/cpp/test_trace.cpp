@@ -0,0 +1,137 @@
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include "czkawka_bridge/czkawka_bridge.h"
+#include "trace.h"
+
+class TestTrace : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void cleanup();
+
+    void testDisabledByDefault();
+    void testUnwritablePath();
+    void testChromeTraceFile();
+
+private:
+    // Complete events by name
+    static QHash<QString, QJsonObject> readEvents(const QString &path, QJsonArray *all = nullptr);
+};
+
+void TestTrace::cleanup()
+{
+    Trace::stop();
+}
+
+QHash<QString, QJsonObject> TestTrace::readEvents(const QString &path, QJsonArray *all)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    const QJsonArray events = QJsonDocument::fromJson(file.readAll()).object().value(QStringLiteral("traceEvents")).toArray();
+    if (all) {
+        *all = events;
+    }
+
+    QHash<QString, QJsonObject> spans;
+    for (const QJsonValue &value : events) {
+        const QJsonObject event = value.toObject();
+        if (event.value(QStringLiteral("ph")).toString() == QLatin1String("X")) {
+            spans.insert(event.value(QStringLiteral("name")).toString(), event);
+        }
+    }
+    return spans;
+}
+
+void TestTrace::testDisabledByDefault()
+{
+    QVERIFY(!Trace::isEnabled());
+    {
+        Trace::Span span("not recorded");
+    }
+    QVERIFY(Trace::stop());
+}
+
+void TestTrace::testUnwritablePath()
+{
+    QVERIFY(!Trace::start(QStringLiteral("/nonexistent/directory/trace.json")));
+    QVERIFY(!Trace::isEnabled());
+}
+
+void TestTrace::testChromeTraceFile()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("trace.json"));
+
+    QFile input(dir.filePath(QStringLiteral("input")));
+    QVERIFY(input.open(QIODevice::WriteOnly));
+    input.write(QByteArrayLiteral("content to hash"));
+    input.close();
+
+    {
+        Trace::Span stale("started before the trace");
+        QVERIFY(Trace::start(path));
+        QVERIFY(Trace::isEnabled());
+
+        Trace::Span outer("outer");
+        {
+            Trace::Span inner("inner");
+        }
+
+        // The bridge reports its spans through the callback Trace installs
+        char hash[CZKAWKA_HASH_MAX_LEN + 1];
+        QVERIFY(czkawka_hash_file(QFile::encodeName(input.fileName()).constData(), Blake3, nullptr,
+                                  hash, sizeof(hash)) > 0);
+
+        QThread *worker = QThread::create([]() {
+            Trace::Span span("worker");
+        });
+        worker->setObjectName(QStringLiteral("TraceWorker"));
+        worker->start();
+        QVERIFY(worker->wait(5000));
+        delete worker;
+    }
+    QVERIFY(Trace::stop());
+    QVERIFY(!Trace::isEnabled());
+
+    QJsonArray all;
+    const QHash<QString, QJsonObject> spans = readEvents(path, &all);
+    QVERIFY(!spans.contains(QStringLiteral("started before the trace")));
+    QVERIFY(spans.contains(QStringLiteral("outer")));
+    QVERIFY(spans.contains(QStringLiteral("inner")));
+    QVERIFY(spans.contains(QStringLiteral("czkawka_hash_file")));
+    QVERIFY(spans.contains(QStringLiteral("worker")));
+
+    // Nesting is read from the times of complete events on one thread
+    const QJsonObject outer = spans.value(QStringLiteral("outer"));
+    const QJsonObject inner = spans.value(QStringLiteral("inner"));
+    const double outerBegin = outer.value(QStringLiteral("ts")).toDouble();
+    const double innerBegin = inner.value(QStringLiteral("ts")).toDouble();
+    QVERIFY(innerBegin >= outerBegin);
+    QVERIFY(innerBegin + inner.value(QStringLiteral("dur")).toDouble()
+            <= outerBegin + outer.value(QStringLiteral("dur")).toDouble());
+    QCOMPARE(inner.value(QStringLiteral("tid")), outer.value(QStringLiteral("tid")));
+
+    const QJsonValue workerThread = spans.value(QStringLiteral("worker")).value(QStringLiteral("tid"));
+    QVERIFY(workerThread != outer.value(QStringLiteral("tid")));
+    const bool workerNamed = std::any_of(all.cbegin(), all.cend(), [&workerThread](const QJsonValue &value) {
+        const QJsonObject event = value.toObject();
+        return event.value(QStringLiteral("ph")).toString() == QLatin1String("M")
+            && event.value(QStringLiteral("tid")) == workerThread
+            && event.value(QStringLiteral("args")).toObject().value(QStringLiteral("name")).toString()
+                == QLatin1String("TraceWorker");
+    });
+    QVERIFY(workerNamed);
+
+    // Nothing is recorded once stopped
+    {
+        Trace::Span span("after stop");
+    }
+    QVERIFY(!readEvents(path).contains(QStringLiteral("after stop")));
+}
+
+QTEST_MAIN(TestTrace)
+#include "test_trace.moc"
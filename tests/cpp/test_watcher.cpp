@@ -0,0 +1,142 @@
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include "duplicatemodel.h"
+#include "duplicatewatcher.h"
+#include "testtree.h"
+
+#include <unistd.h>
+
+class TestWatcher : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testNewCopyIsHashed();
+    void testBurstIsCoalesced();
+    void testRemovedDirectory();
+    void testHardLinkedCopiesStayOut();
+
+private:
+    bool startWatcher();
+
+    TestTree *m_tree;
+    DuplicateWatcher *m_watcher;
+};
+
+void TestWatcher::init()
+{
+    m_tree = new TestTree();
+    QVERIFY(m_tree->isValid());
+    m_watcher = new DuplicateWatcher();
+}
+
+void TestWatcher::cleanup()
+{
+    delete m_watcher;
+    m_watcher = nullptr;
+    delete m_tree;
+    m_tree = nullptr;
+}
+
+bool TestWatcher::startWatcher()
+{
+    DuplicateFinder::ScanParameters params;
+    params.checkMethod = 0;
+    params.hashType = 0;
+    params.recursive = true;
+    params.ignoreHardLinks = true;
+    params.useCache = false;
+    params.minSize = 0;
+    params.maxSize = 0;
+    params.includePaths = {m_tree->path()};
+    return m_watcher->start(params);
+}
+
+void TestWatcher::testNewCopyIsHashed()
+{
+    QDir().mkpath(m_tree->filePath(QStringLiteral("sub")));
+    QVERIFY(startWatcher());
+    m_watcher->setGroupSizes({9});
+
+    QSignalSpy changedSpy(m_watcher, &DuplicateWatcher::filesChanged);
+    const QString copy = m_tree->createFile(QStringLiteral("sub/copy"), QByteArrayLiteral("duplicate"));
+    m_tree->createFile(QStringLiteral("sub/other"), QByteArrayLiteral("no group has this size"));
+    QVERIFY(changedSpy.wait(5000));
+
+    const QStringList changedPaths = changedSpy.first().at(0).toStringList();
+    const auto current = changedSpy.first().at(1).value<QList<DuplicateFinder::DuplicateEntry>>();
+    QCOMPARE(changedPaths.size(), 2);
+
+    // Only the file that can match a group is read
+    QCOMPARE(current.size(), 1);
+    QCOMPARE(current.first().path, copy);
+    QCOMPARE(current.first().size, quint64(9));
+    QVERIFY(!current.first().hash.isEmpty());
+}
+
+void TestWatcher::testBurstIsCoalesced()
+{
+    QVERIFY(startWatcher());
+
+    QSignalSpy changedSpy(m_watcher, &DuplicateWatcher::filesChanged);
+    for (int i = 0; i < 20; ++i) {
+        m_tree->createFile(QStringLiteral("burst"), QByteArray::number(i));
+    }
+    QVERIFY(changedSpy.wait(5000));
+    QTest::qWait(DuplicateWatcher::QuietPeriodMs * 2);
+
+    QCOMPARE(changedSpy.count(), 1);
+    QCOMPARE(changedSpy.first().at(0).toStringList(), QStringList({m_tree->filePath(QStringLiteral("burst"))}));
+}
+
+void TestWatcher::testRemovedDirectory()
+{
+    m_tree->createFile(QStringLiteral("old/file"), QByteArrayLiteral("content"));
+    QVERIFY(startWatcher());
+
+    QSignalSpy changedSpy(m_watcher, &DuplicateWatcher::filesChanged);
+    QTemporaryDir outside;
+    QVERIFY(QDir().rename(m_tree->filePath(QStringLiteral("old")), outside.filePath(QStringLiteral("old"))));
+    QVERIFY(changedSpy.wait(5000));
+
+    QCOMPARE(changedSpy.first().at(0).toStringList(), QStringList({m_tree->filePath(QStringLiteral("old")) + QLatin1Char('/')}));
+    QVERIFY(changedSpy.first().at(1).value<QList<DuplicateFinder::DuplicateEntry>>().isEmpty());
+}
+
+void TestWatcher::testHardLinkedCopiesStayOut()
+{
+    QVERIFY(startWatcher());
+    m_watcher->setGroupSizes({9});
+
+    DuplicateModel model;
+    connect(m_watcher, &DuplicateWatcher::filesChanged, &model,
+            [this, &model](const QStringList &changedPaths, const QList<DuplicateFinder::DuplicateEntry> &current) {
+        model.updateFiles(changedPaths, current, true);
+        m_watcher->setGroupSizes(model.groupSizes());
+    });
+
+    const QString original = m_tree->createFile(QStringLiteral("original"), QByteArrayLiteral("duplicate"));
+    const QStringList copies = {m_tree->createFile(QStringLiteral("copy1"), QByteArrayLiteral("duplicate")),
+                                m_tree->createFile(QStringLiteral("copy2"), QByteArrayLiteral("duplicate"))};
+    QTRY_COMPARE(model.rowCount(model.index(0, 0)), 3);
+
+    // Replace the copies with links to the original the way a hard link
+    // operation does, through a temporary link renamed over each copy
+    const QString temporary = m_tree->filePath(QStringLiteral("link.tmp"));
+    for (const QString &copy : copies) {
+        QCOMPARE(::link(QFile::encodeName(original).constData(), QFile::encodeName(temporary).constData()), 0);
+        QCOMPARE(::rename(QFile::encodeName(temporary).constData(), QFile::encodeName(copy).constData()), 0);
+    }
+
+    // Three paths to one inode are no duplicates
+    QTRY_COMPARE(model.groupCount(), 0);
+    QTest::qWait(DuplicateWatcher::QuietPeriodMs * 2);
+    QCOMPARE(model.groupCount(), 0);
+    QCOMPARE(model.wastedSpace(), quint64(0));
+}
+
+QTEST_MAIN(TestWatcher)
+#include "test_watcher.moc"
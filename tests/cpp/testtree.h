@@ -0,0 +1,32 @@
+#ifndef TESTTREE_H
+#define TESTTREE_H
+
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+
+// A temporary directory for tests that work on real files, removed with it
+class TestTree : public QTemporaryDir
+{
+public:
+    // Writes content to name below the tree, creating parent directories, and
+    // returns its path. A file that cannot be written in full fails the
+    // current test and gives an empty path.
+    QString createFile(const QString &name, const QByteArray &content) const
+    {
+        const QString path = filePath(name);
+        if (!QDir().mkpath(QFileInfo(path).absolutePath())) {
+            QTest::qFail(qPrintable(QStringLiteral("Cannot create the directory of %1").arg(path)), __FILE__, __LINE__);
+            return QString();
+        }
+
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly) || file.write(content) != content.size() || !file.flush()) {
+            QTest::qFail(qPrintable(QStringLiteral("Cannot write %1: %2").arg(path, file.errorString())),
+                         __FILE__, __LINE__);
+            return QString();
+        }
+        return path;
+    }
+};
+
+#endif // TESTTREE_H